@@ -0,0 +1,113 @@
+// Microbenchmarks a single Book side on the map ladder and the flat array
+// ladder through the single writer paths, so only the book is measured.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../src/book.hpp"
+
+char usage[] = "./book_bench [operations] [depth in ticks]\n\t example: ./book_bench 1000000 500";
+
+struct Step
+{
+    enum
+    {
+        Rest,
+        Cross,
+        Cancel
+    } kind;
+    Order * order;
+    order_id_t order_id;
+};
+
+/**
+ * Builds a flow of passive bids around a drifting mid price, sell orders
+ * crossing the top levels, and cancels of previously rested bids.
+*/
+static std::vector<Step> GenerateFlow(size_t operations, price_t depth)
+{
+    std::mt19937 rng(42);
+    std::vector<Step> flow;
+    std::vector<order_id_t> rested;
+    price_t mid = 100000;
+    order_id_t id = 1;
+    for (size_t i = 0; i < operations; i++)
+    {
+        unsigned roll = rng() % 10;
+        mid += rng() % 3 - 1;
+        if (roll < 6)
+        {
+            Order * order = Order::from(id++, PackSymbol("BENCH"), mid - rng() % depth, 1 + rng() % 10, Side::BUY);
+            rested.push_back(order->GetOrderId());
+            flow.push_back({Step::Rest, order, 0});
+        }
+        else if (roll < 8)
+            flow.push_back({Step::Cross, Order::from(id++, PackSymbol("BENCH"), mid - rng() % 4, 1 + rng() % 20, Side::SELL), 0});
+        else if (!rested.empty())
+        {
+            size_t pick = rng() % rested.size();
+            flow.push_back({Step::Cancel, nullptr, rested[pick]});
+            rested[pick] = rested.back();
+            rested.pop_back();
+        }
+    }
+    return flow;
+}
+
+template <typename Levels>
+static double Run(const std::vector<Step> & flow)
+{
+    Book<std::greater<price_t>, Levels> bids;
+    auto start = std::chrono::steady_clock::now();
+    for (const Step & step : flow)
+    {
+        switch (step.kind)
+        {
+            case Step::Rest:
+                bids.RestExclusive(*step.order);
+                break;
+            case Step::Cross:
+                // Only the bids are modelled, so the remainder is dropped.
+                bids.CrossSpreadExclusive(*step.order);
+                Order::Destroy(step.order);
+                break;
+            case Step::Cancel:
+                bids.CancelExclusive(step.order_id);
+                break;
+        }
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / flow.size();
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "--help") == 0)
+    {
+        std::cerr << usage << std::endl;
+        return EXIT_SUCCESS;
+    }
+    size_t operations = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    price_t depth = argc > 2 ? std::stoul(argv[2]) : 500;
+
+    // Events still go through the output journal, written to /dev/null.
+    FILE * report = fdopen(dup(STDOUT_FILENO), "w");
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+
+    // Books take ownership of the orders, so both ladders get their own copy of the flow.
+    std::vector<Step> map_flow = GenerateFlow(operations, depth);
+    std::vector<Step> array_flow = GenerateFlow(operations, depth);
+
+    fprintf(report, "%zu operations, bids spread over %u ticks\n", operations, depth);
+    fprintf(report, "map ladder:   %8.1f ns/op\n", Run<MapLadder<std::greater<price_t>>>(map_flow));
+    fprintf(report, "array ladder: %8.1f ns/op\n", Run<ArrayLadder<std::greater<price_t>>>(array_flow));
+    fclose(report);
+    return EXIT_SUCCESS;
+}
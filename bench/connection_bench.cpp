@@ -0,0 +1,101 @@
+// Compares the thread-per-connection model against the pooled epoll model,
+// with lock based and sharded matching, by replaying the same order flow of
+// the workload model through each.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "replay.hpp"
+
+char usage[] = "./connection_bench [clients] [orders per client] [instruments]\n\t example: ./connection_bench 256 2000 16";
+
+static double Run(const EngineOptions & options, const Flows & flows)
+{
+    Engine engine(options);
+    std::vector<int> client_fds;
+    for (size_t i = 0; i < flows.size(); i++)
+    {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        {
+            perror("socketpair");
+            exit(EXIT_FAILURE);
+        }
+        client_fds.push_back(fds[0]);
+        engine.accept(ClientConnection(fds[1]));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (size_t i = 0; i < flows.size(); i++)
+        clients.emplace_back(
+            [&, i]()
+            {
+                const char * data = reinterpret_cast<const char *>(flows[i].data());
+                size_t left = flows[i].size() * sizeof(ClientCommand);
+                while (left > 0)
+                {
+                    ssize_t n = write(client_fds[i], data, left);
+                    if (n <= 0)
+                        return;
+                    data += n;
+                    left -= n;
+                }
+                shutdown(client_fds[i], SHUT_WR);
+            });
+    for (auto & client : clients)
+        client.join();
+    engine.WaitForConnections();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (int fd : client_fds)
+        close(fd);
+    return elapsed;
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "--help") == 0)
+    {
+        std::cerr << usage << std::endl;
+        return EXIT_SUCCESS;
+    }
+    size_t clients = argc > 1 ? std::stoul(argv[1]) : 256;
+    size_t orders = argc > 2 ? std::stoul(argv[2]) : 2000;
+    size_t instruments = argc > 3 ? std::stoul(argv[3]) : 16;
+
+    WorkloadConfig workload;
+    workload.instruments = int(instruments);
+    Flows flows = GenerateFlows(clients, orders, workload);
+    // The engine reports events on stdout and errors on stderr, keep the results apart.
+    FILE * report = DetachReport(true);
+
+    EngineOptions per_connection;
+    per_connection.threading = Threading::PerConnection;
+    EngineOptions pooled;
+    EngineOptions sharded;
+    sharded.matching = Matching::Sharded;
+    ParseOptions(0, nullptr, per_connection);
+    ParseOptions(0, nullptr, pooled);
+    ParseOptions(0, nullptr, sharded);
+
+    double total = 0;
+    for (const auto & flow : flows)
+        total += flow.size();
+    fprintf(report, "%zu clients x %zu commands over %zu instruments\n", clients, orders, instruments);
+    double t = Run(per_connection, flows);
+    fprintf(report, "per-connection: %8.3f s %12.0f commands/s\n", t, total / t);
+    t = Run(pooled, flows);
+    fprintf(report, "pooled (%zu io, %zu matching): %8.3f s %12.0f commands/s\n", pooled.io_threads, pooled.matching_threads, t, total / t);
+    t = Run(sharded, flows);
+    fprintf(report, "pooled + sharded (%zu shards): %8.3f s %12.0f commands/s\n", sharded.shards, t, total / t);
+    fclose(report);
+    return EXIT_SUCCESS;
+}
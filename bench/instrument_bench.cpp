@@ -0,0 +1,209 @@
+// Measures the instrument registry: threads create every symbol concurrently,
+// then look symbols up with a skewed popularity, as the engine does on each
+// command. The lock-free AtomicMap under the InstrumentDirectory is compared
+// with a std::map behind a shared_mutex and a std::unordered_map behind a
+// mutex.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <latch>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../src/atomic_map.hpp"
+#include "../src/symbol.hpp"
+
+char usage[] = "./instrument_bench [symbols] [threads] [lookups per thread]\n\t example: ./instrument_bench 100000 4 2000000";
+
+// Stands in for the OrderBook the registry hands out.
+struct Entry
+{
+    symbol_t symbol;
+};
+
+/**
+ * Same scheme as the InstrumentDirectory: lookups never lock, the rare
+ * creation takes a mutex so each symbol gets a single entry.
+*/
+class LockFreeRegistry
+{
+public:
+    Entry * Get(symbol_t symbol)
+    {
+        if (Entry ** entry = map.Find(symbol))
+            return *entry;
+        std::unique_lock<std::mutex> l(mutex);
+        if (Entry ** entry = map.Find(symbol))
+            return *entry;
+        entries.push_back(std::make_unique<Entry>(Entry{symbol}));
+        return *map.Insert(symbol, entries.back().get()).first;
+    }
+
+private:
+    AtomicMap<symbol_t, Entry *> map;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Entry>> entries;
+};
+
+class SharedMutexRegistry
+{
+public:
+    Entry * Get(symbol_t symbol)
+    {
+        {
+            std::shared_lock<std::shared_mutex> l(mutex);
+            if (auto it = map.find(symbol); it != map.end())
+                return it->second.get();
+        }
+        std::unique_lock<std::shared_mutex> l(mutex);
+        auto & entry = map[symbol];
+        if (!entry)
+            entry = std::make_unique<Entry>(Entry{symbol});
+        return entry.get();
+    }
+
+private:
+    std::shared_mutex mutex;
+    std::map<symbol_t, std::unique_ptr<Entry>> map;
+};
+
+class MutexRegistry
+{
+public:
+    Entry * Get(symbol_t symbol)
+    {
+        std::unique_lock<std::mutex> l(mutex);
+        auto & entry = map[symbol];
+        if (!entry)
+            entry = std::make_unique<Entry>(Entry{symbol});
+        return entry.get();
+    }
+
+private:
+    std::mutex mutex;
+    std::unordered_map<symbol_t, std::unique_ptr<Entry>> map;
+};
+
+struct Result
+{
+    double create_ns;
+    double lookup_ns;
+};
+
+/**
+ * Runs fn(thread) on every thread at once, returning the wall time in ns.
+*/
+template <typename Fn>
+static double Parallel(size_t threads, Fn fn)
+{
+    std::latch ready(threads + 1);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++)
+        workers.emplace_back(
+            [&, t]()
+            {
+                ready.arrive_and_wait();
+                fn(t);
+            });
+    // Timed from before the release, the workers may run to completion before this thread is scheduled again.
+    auto start = std::chrono::steady_clock::now();
+    ready.arrive_and_wait();
+    for (auto & worker : workers)
+        worker.join();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename Registry>
+static Result Run(const std::vector<symbol_t> & symbols, const std::vector<std::vector<uint32_t>> & lookups)
+{
+    Registry registry;
+    size_t threads = lookups.size();
+    std::atomic<size_t> wrong{0};
+
+    // Every thread walks all the symbols from its own offset, so creations race.
+    double create = Parallel(threads,
+        [&](size_t t)
+        {
+            for (size_t n = 0; n < symbols.size(); n++)
+            {
+                symbol_t symbol = symbols[(n + t * symbols.size() / threads) % symbols.size()];
+                if (registry.Get(symbol)->symbol != symbol)
+                    wrong.fetch_add(1);
+            }
+        });
+    double lookup = Parallel(threads,
+        [&](size_t t)
+        {
+            size_t bad = 0;
+            for (uint32_t i : lookups[t])
+                bad += registry.Get(symbols[i])->symbol != symbols[i];
+            wrong.fetch_add(bad);
+        });
+
+    if (wrong.load() != 0)
+    {
+        fprintf(stderr, "registry returned %zu wrong entries\n", wrong.load());
+        exit(EXIT_FAILURE);
+    }
+    // Creation is reported per symbol, lookups per call on one thread.
+    return {create / symbols.size(), lookup / lookups[0].size()};
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "--help") == 0)
+    {
+        std::cerr << usage << std::endl;
+        return EXIT_SUCCESS;
+    }
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 100000;
+    size_t threads = argc > 2 ? std::max(1ul, std::stoul(argv[2])) : 4;
+    size_t per_thread = argc > 3 ? std::stoul(argv[3]) : 2000000;
+
+    std::vector<symbol_t> symbols;
+    for (size_t i = 0; i < count; i++)
+    {
+        char name[24];
+        snprintf(name, sizeof(name), "I%zu", i);
+        symbols.push_back(PackSymbol(name));
+    }
+
+    // Lookups follow a zipf popularity like real flow, so a few symbols stay hot.
+    std::vector<double> popularity;
+    double total = 0;
+    for (size_t k = 1; k <= count; k++)
+        popularity.push_back(total += 1.0 / k);
+    std::vector<std::vector<uint32_t>> lookups(threads);
+    for (size_t t = 0; t < threads; t++)
+    {
+        std::mt19937_64 rng(t);
+        std::uniform_real_distribution<double> at(0, total);
+        for (size_t i = 0; i < per_thread; i++)
+        {
+            size_t k = std::upper_bound(popularity.begin(), popularity.end(), at(rng)) - popularity.begin();
+            lookups[t].push_back(std::min(k, count - 1));
+        }
+    }
+
+    printf("%zu symbols, %zu threads, %zu lookups each\n", count, threads, per_thread);
+    printf("%-22s %12s %12s\n", "", "create ns", "lookup ns");
+    Result result = Run<LockFreeRegistry>(symbols, lookups);
+    printf("%-22s %12.1f %12.1f\n", "AtomicMap", result.create_ns, result.lookup_ns);
+    result = Run<SharedMutexRegistry>(symbols, lookups);
+    printf("%-22s %12.1f %12.1f\n", "map + shared_mutex", result.create_ns, result.lookup_ns);
+    result = Run<MutexRegistry>(symbols, lookups);
+    printf("%-22s %12.1f %12.1f\n", "unordered_map + mutex", result.create_ns, result.lookup_ns);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,109 @@
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include <barrier>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../src/engine.hpp"
+#include "workload.hpp"
+
+// Commands of each session, in the order it sends them.
+typedef std::vector<std::vector<ClientCommand>> Flows;
+
+/**
+ * Produces a Workload with one client per session and gives each session
+ * the commands of its client, about commands of them, so a cancel is sent
+ * by the session that placed the order.
+*/
+inline Flows GenerateFlows(size_t sessions, size_t commands, WorkloadConfig config)
+{
+    config.clients = int(sessions);
+    Workload workload(config, config.seed);
+    Flows flows(sessions);
+    for (size_t i = 0; i < sessions * commands; i++)
+    {
+        ClientCommand cmd;
+        int client;
+        workload.Next(cmd, client);
+        flows[client].push_back(cmd);
+    }
+    return flows;
+}
+
+/**
+ * Sends what the engine reports on stdout, and on stderr when asked, to
+ * /dev/null, so the results of a bench stand apart.
+ * 
+ * @return a stream to the original stdout, for the results.
+*/
+inline FILE * DetachReport(bool stderr_too = false)
+{
+    FILE * report = fdopen(dup(STDOUT_FILENO), "w");
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    if (stderr_too)
+        dup2(devnull, STDERR_FILENO);
+    close(devnull);
+    return report;
+}
+
+/**
+ * Replays each flow from a thread of its own, as session i of the engine,
+ * straight into Engine::HandleCommand without sockets, then waits for the
+ * engine to drain.
+ * 
+ * @param handle Called as handle(i, session, command) on the thread of
+ *               session i, and expected to hand the command to the engine.
+ * @param started Called on the last thread to arrive, just before they are
+ *                all released.
+ * @return the seconds from the release of the threads until the engine
+ *         drained.
+*/
+template <typename Handle, typename Started>
+double ReplaySessions(Engine & engine, std::span<const std::vector<ClientCommand>> flows, Handle && handle, Started && started)
+{
+    std::vector<std::unique_ptr<Session>> sessions;
+    for (size_t i = 0; i < flows.size(); i++)
+        // The session never reads its connection.
+        sessions.push_back(std::make_unique<Session>(ClientConnection(-1), i));
+
+    std::chrono::steady_clock::time_point start;
+    std::barrier ready(flows.size() + 1,
+        [&]() noexcept
+        {
+            started();
+            start = std::chrono::steady_clock::now();
+        });
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < flows.size(); i++)
+        threads.emplace_back(
+            [&, i]()
+            {
+                ready.arrive_and_wait();
+                for (const ClientCommand & cmd : flows[i])
+                    handle(i, *sessions[i], cmd);
+            });
+
+    ready.arrive_and_wait();
+    for (auto & thread : threads)
+        thread.join();
+    // Drains the shards and the output, so the time covers every command.
+    engine.WaitForConnections();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline double ReplaySessions(Engine & engine, std::span<const std::vector<ClientCommand>> flows)
+{
+    return ReplaySessions(
+        engine, flows, [&](size_t, Session & session, const ClientCommand & cmd) { engine.HandleCommand(session, cmd); },
+        []() noexcept { });
+}
+
+#endif
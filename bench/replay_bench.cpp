@@ -0,0 +1,242 @@
+// Replays a command stream held in memory straight into the Engine from a
+// number of threads, one session each, without sockets. Reports throughput,
+// per command latency percentiles and heap allocations per order. With risk
+// limits given, a run without them comes first and the cost of the checks
+// per command is reported.
+//
+// Commands are generated by the workload model of workload.hpp, one client
+// per thread, or loaded from a file of raw ClientCommand records as a client
+// sends them. A recorded stream is split between the threads by order id, so
+// cancels are replayed by the session that placed the order.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "replay.hpp"
+
+char usage[] = "./replay_bench [--threads=N] [--commands=N] [workload options] [--input=PATH] [engine options]\n"
+               "\t--commands per thread and the options of test_generator, such as --instruments or --zipf, shape the\n"
+               "\tgenerated stream, --input replays a recorded one\n"
+               "\t example: ./replay_bench --threads=4 --commands=250000 --matching=sharded\n"
+               "\t example: ./replay_bench --max-order-size=1000 --max-position=5000";
+
+// Every heap allocation of the process, replaced below so the matching
+// core's allocations per order can be counted.
+static std::atomic<size_t> allocations{0};
+
+void * operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void * p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void * operator new(size_t size, std::align_val_t align)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    size_t alignment = static_cast<size_t>(align);
+    if (void * p = aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void * p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete(void * p, std::align_val_t) noexcept
+{
+    free(p);
+}
+
+void operator delete(void * p, size_t, std::align_val_t) noexcept
+{
+    free(p);
+}
+
+static Flows LoadFlows(const char * path, size_t threads)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) != 0)
+    {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<ClientCommand> recorded(st.st_size / sizeof(ClientCommand));
+    char * data = reinterpret_cast<char *>(recorded.data());
+    size_t left = recorded.size() * sizeof(ClientCommand);
+    while (left > 0)
+    {
+        ssize_t n = read(fd, data, left);
+        if (n <= 0)
+        {
+            perror(path);
+            exit(EXIT_FAILURE);
+        }
+        data += n;
+        left -= n;
+    }
+    close(fd);
+
+    Flows flows(threads);
+    for (const ClientCommand & cmd : recorded)
+        flows[cmd.order_id % threads].push_back(cmd);
+    return flows;
+}
+
+struct Result
+{
+    double seconds;
+    size_t orders;
+    size_t allocations;
+    // Nanoseconds spent in each HandleCommand call, sorted.
+    std::vector<uint64_t> latencies;
+};
+
+static Result Run(const EngineOptions & options, const Flows & flows)
+{
+    Engine engine(options);
+    std::vector<std::vector<uint64_t>> latencies(flows.size());
+    size_t orders = 0;
+    for (size_t i = 0; i < flows.size(); i++)
+    {
+        latencies[i].reserve(flows[i].size());
+        for (const ClientCommand & cmd : flows[i])
+            orders += cmd.type != input_cancel;
+    }
+
+    size_t allocated = 0;
+    double seconds = ReplaySessions(
+        engine, flows,
+        [&](size_t i, Session & session, const ClientCommand & cmd)
+        {
+            auto start = std::chrono::steady_clock::now();
+            engine.HandleCommand(session, cmd);
+            latencies[i].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        },
+        [&]() noexcept { allocated = allocations.load(); });
+    allocated = allocations.load() - allocated;
+
+    Result result{seconds, orders, allocated, {}};
+    for (auto & thread_latencies : latencies)
+        result.latencies.insert(result.latencies.end(), thread_latencies.begin(), thread_latencies.end());
+    std::sort(result.latencies.begin(), result.latencies.end());
+    return result;
+}
+
+static uint64_t Percentile(const std::vector<uint64_t> & sorted, double fraction)
+{
+    if (sorted.empty())
+        return 0;
+    return sorted[std::min(sorted.size() - 1, size_t(fraction * sorted.size()))];
+}
+
+static double Mean(const std::vector<uint64_t> & latencies)
+{
+    uint64_t sum = 0;
+    for (uint64_t latency : latencies)
+        sum += latency;
+    return latencies.empty() ? 0.0 : double(sum) / latencies.size();
+}
+
+static void PrintResult(FILE * report, const char * label, const Result & result)
+{
+    size_t total = result.latencies.size();
+    fprintf(report, "%s: %8.3f s %12.0f commands/s\n", label, result.seconds, total / result.seconds);
+    // Sharded commands are only queued by HandleCommand, so their latency is the submission cost.
+    fprintf(report, "latency ns: p50 %6" PRIu64 "  p99 %6" PRIu64 "  p99.9 %6" PRIu64 "  max %8" PRIu64 "  mean %8.1f\n",
+        Percentile(result.latencies, 0.5), Percentile(result.latencies, 0.99), Percentile(result.latencies, 0.999),
+        result.latencies.empty() ? uint64_t(0) : result.latencies.back(), Mean(result.latencies));
+    fprintf(report, "allocations: %.3f per order (%zu over %zu orders)\n",
+        result.orders ? double(result.allocations) / result.orders : 0.0, result.allocations, result.orders);
+}
+
+int main(int argc, char * argv[])
+{
+    size_t threads = 4;
+    size_t commands = 250000;
+    WorkloadConfig workload;
+    workload.instruments = 16;
+    const char * input = nullptr;
+    std::vector<char *> engine_args;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--help") == 0)
+        {
+            std::cerr << usage << std::endl;
+            return EXIT_SUCCESS;
+        }
+        if (strncmp(argv[i], "--threads=", 10) == 0)
+            threads = std::max(1ul, std::stoul(argv[i] + 10));
+        else if (strncmp(argv[i], "--commands=", 11) == 0)
+            commands = std::stoul(argv[i] + 11);
+        else if (ParseWorkloadOption(argv[i], workload))
+            continue;
+        else if (strncmp(argv[i], "--input=", 8) == 0)
+            input = argv[i] + 8;
+        else
+            engine_args.push_back(argv[i]);
+    }
+
+    // Sessions are driven by the bench threads, so no connection threads are needed.
+    EngineOptions options;
+    options.threading = Threading::PerConnection;
+    if (!ParseOptions(engine_args.size(), engine_args.data(), options))
+    {
+        PrintOptionsUsage();
+        return EXIT_FAILURE;
+    }
+
+    Flows flows = input != nullptr ? LoadFlows(input, threads) : GenerateFlows(threads, commands, workload);
+    FILE * report = DetachReport();
+
+    const char * matching = options.matching == Matching::Sharded ? "sharded matching" : "locked matching";
+    size_t total = 0;
+    for (auto & flow : flows)
+        total += flow.size();
+    if (input != nullptr)
+        fprintf(report, "%zu threads replaying %zu commands from %s\n", threads, total, input);
+    else
+        fprintf(report, "%zu threads x %zu commands over %d instruments\n", threads, commands, workload.instruments);
+
+    if (!options.risk.Enabled())
+    {
+        PrintResult(report, matching, Run(options, flows));
+        fclose(report);
+        return EXIT_SUCCESS;
+    }
+
+    // The same flow with and without the checks, the difference is their cost.
+    EngineOptions unchecked = options;
+    unchecked.risk = RiskLimits{};
+    Result baseline = Run(unchecked, flows);
+    Result checked = Run(options, flows);
+    PrintResult(report, (std::string(matching) + ", no risk checks").c_str(), baseline);
+    PrintResult(report, (std::string(matching) + ", risk checks").c_str(), checked);
+    fprintf(report, "risk checks: %+.1f ns per command mean, %+" PRId64 " ns p50, %+.1f ns per command in throughput\n",
+        Mean(checked.latencies) - Mean(baseline.latencies),
+        int64_t(Percentile(checked.latencies, 0.5)) - int64_t(Percentile(baseline.latencies, 0.5)),
+        (checked.seconds - baseline.seconds) * 1e9 / total);
+    fclose(report);
+    return EXIT_SUCCESS;
+}
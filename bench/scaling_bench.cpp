@@ -0,0 +1,119 @@
+// Measures how sharded matching scales across cores and instruments. For
+// every instrument count the engine runs with each number of shards, fed by
+// as many sessions each replaying the same number of commands of the
+// workload model, and the throughput is reported with its speedup over the
+// run on the fewest cores.
+//
+// Engine options apply to every run, so `--pin=core` against the default
+// shows what placing shards, their books and their orders on NUMA nodes is
+// worth on the machine.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "replay.hpp"
+
+char usage[] = "./scaling_bench [--cores=LIST] [--instruments=LIST] [--commands=N] [workload options] [engine options]\n"
+               "\t--cores are the shard counts to run, --commands the commands of each session, other options of\n"
+               "\ttest_generator, such as --zipf, shape the flow\n"
+               "\t example: ./scaling_bench --cores=1,2,4,8 --instruments=1,64,5000 --pin=core";
+
+/**
+ * Replays the flows of the first sessions into an engine of as many shards.
+ * 
+ * @return commands handled per second, the shards drained.
+*/
+static double Run(EngineOptions options, size_t cores, const Flows & flows)
+{
+    options.shards = cores;
+    Engine engine(options);
+    std::span<const std::vector<ClientCommand>> used(flows.data(), cores);
+    size_t total = 0;
+    for (const auto & flow : used)
+        total += flow.size();
+    return total / ReplaySessions(engine, used);
+}
+
+static std::vector<int> DefaultCores()
+{
+    std::vector<int> cores;
+    int available = std::max(1u, std::thread::hardware_concurrency());
+    for (int n = 1; n < available; n *= 2)
+        cores.push_back(n);
+    cores.push_back(available);
+    return cores;
+}
+
+int main(int argc, char * argv[])
+{
+    std::vector<int> cores = DefaultCores();
+    std::vector<int> instruments = {1, 16, 256, 4096};
+    size_t commands = 100000;
+    WorkloadConfig workload;
+    std::vector<char *> engine_args;
+    for (int i = 1; i < argc; i++)
+    {
+        bool ok = true;
+        if (strcmp(argv[i], "--help") == 0)
+        {
+            std::cerr << usage << std::endl;
+            return EXIT_SUCCESS;
+        }
+        if (strncmp(argv[i], "--cores=", 8) == 0)
+            ok = ParseCpuList(argv[i] + 8, cores) && !cores.empty() && *std::min_element(cores.begin(), cores.end()) > 0;
+        else if (strncmp(argv[i], "--instruments=", 14) == 0)
+            ok = ParseCpuList(argv[i] + 14, instruments) && !instruments.empty()
+                && *std::min_element(instruments.begin(), instruments.end()) > 0;
+        else if (strncmp(argv[i], "--commands=", 11) == 0)
+            commands = std::max(1ul, std::stoul(argv[i] + 11));
+        else if (ParseWorkloadOption(argv[i], workload))
+            continue;
+        else
+            engine_args.push_back(argv[i]);
+        if (!ok)
+        {
+            std::cerr << "Invalid option: " << argv[i] << "\n" << usage << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Sessions are driven by the bench threads, so no connection threads are needed.
+    EngineOptions options;
+    options.threading = Threading::PerConnection;
+    options.matching = Matching::Sharded;
+    if (!ParseOptions(engine_args.size(), engine_args.data(), options))
+    {
+        PrintOptionsUsage();
+        return EXIT_FAILURE;
+    }
+
+    FILE * report = DetachReport();
+
+    const char * pinning = options.pinning == Pinning::Core ? "core" : options.pinning == Pinning::Node ? "node" : "none";
+    fprintf(report, "%zu NUMA nodes, shards pinned: %s, %zu commands per session\n",
+        NumaTopology::Instance().Nodes().size(), pinning, commands);
+    fprintf(report, "%12s %6s %14s %9s %14s\n", "instruments", "cores", "commands/s", "speedup", "per core");
+    for (int count : instruments)
+    {
+        workload.instruments = count;
+        Flows flows = GenerateFlows(*std::max_element(cores.begin(), cores.end()), commands, workload);
+
+        double base = 0;
+        for (int n : cores)
+        {
+            double throughput = Run(options, n, flows);
+            if (base == 0)
+                base = throughput;
+            fprintf(report, "%12d %6d %14.0f %8.2fx %14.0f\n", count, n, throughput, throughput / base, throughput / n);
+            fflush(report);
+        }
+    }
+    fclose(report);
+    return EXIT_SUCCESS;
+}
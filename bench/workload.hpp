@@ -0,0 +1,189 @@
+#ifndef WORKLOAD_HPP
+#define WORKLOAD_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/io.hpp"
+
+/**
+ * Shape of the order flow a Workload produces.
+*/
+struct WorkloadConfig
+{
+    int instruments = 100;
+    int clients = 200;
+    // Exponent of the instrument popularity, 0 for uniform.
+    double zipf = 1.0;
+    // Commands cancelling an order the client placed earlier.
+    double cancel_ratio = 0.3;
+    // Orders priced to cross the spread rather than rest.
+    double aggressive_ratio = 0.2;
+    // Ticks from the mid passive orders spread over.
+    int depth = 50;
+    // Chance the mid moves one tick with every order.
+    double volatility = 0.1;
+    // Chance a command starts a burst from one client on one instrument.
+    double burst = 0.01;
+    int burst_length = 20;
+    int mean_quantity = 20;
+    unsigned seed = 1;
+};
+
+/**
+ * Applies a --key=value argument naming a field of WorkloadConfig.
+ * 
+ * @return false if the argument is not one of them.
+*/
+inline bool ParseWorkloadOption(const char * arg, WorkloadConfig & config)
+{
+    const char * eq = strchr(arg, '=');
+    if (strncmp(arg, "--", 2) != 0 || eq == nullptr)
+        return false;
+    std::string key(arg + 2, eq - arg - 2);
+    const char * value = eq + 1;
+    if (key == "instruments")
+        config.instruments = std::max(1, atoi(value));
+    else if (key == "clients")
+        config.clients = std::max(1, atoi(value));
+    else if (key == "zipf")
+        config.zipf = atof(value);
+    else if (key == "cancel-ratio")
+        config.cancel_ratio = atof(value);
+    else if (key == "aggressive-ratio")
+        config.aggressive_ratio = atof(value);
+    else if (key == "depth")
+        config.depth = std::max(1, atoi(value));
+    else if (key == "volatility")
+        config.volatility = atof(value);
+    else if (key == "burst")
+        config.burst = atof(value);
+    else if (key == "burst-length")
+        config.burst_length = std::max(1, atoi(value));
+    else if (key == "mean-quantity")
+        config.mean_quantity = std::max(1, atoi(value));
+    else if (key == "seed")
+        config.seed = atoi(value);
+    else
+        return false;
+    return true;
+}
+
+/**
+ * Ticker of the instrument, four or more capital letters.
+*/
+inline std::string Ticker(int instrument)
+{
+    std::string name;
+    for (int n = instrument; name.size() < 4 || n > 0; n /= 26)
+        name.insert(name.begin(), 'A' + n % 26);
+    return name;
+}
+
+/**
+ * Produces an order flow command by command: instruments picked by a Zipf
+ * popularity, prices around a mid that random walks, passive orders
+ * thinning out away from the touch, a share of orders crossing it, cancels
+ * of the client's own open orders, and bursts from one client on one
+ * instrument.
+*/
+class Workload
+{
+public:
+    Workload(const WorkloadConfig & config, unsigned seed) : config(config), rng(seed), live(config.clients)
+    {
+        // Cumulative popularity, instrument k being picked with weight 1 / k^zipf.
+        double total = 0;
+        for (int k = 1; k <= config.instruments; k++)
+        {
+            total += 1.0 / std::pow(k, config.zipf);
+            popularity.push_back(total);
+        }
+        std::uniform_int_distribution<int> start(500, 5000);
+        for (int k = 0; k < config.instruments; k++)
+        {
+            tickers.push_back(Ticker(k));
+            mids.push_back(start(rng));
+        }
+    }
+
+    /**
+     * Fills the next command and the client sending it.
+    */
+    void Next(ClientCommand & cmd, int & client)
+    {
+        if (burst_left > 0)
+            burst_left--;
+        else
+        {
+            burst_client = Uniform(config.clients);
+            burst_instrument = PickInstrument();
+            if (Chance(config.burst))
+                burst_left = std::geometric_distribution<int>(1.0 / config.burst_length)(rng);
+        }
+        client = burst_client;
+        cmd = ClientCommand{};
+
+        std::vector<uint32_t> & placed = live[client];
+        if (!placed.empty() && Chance(config.cancel_ratio))
+        {
+            size_t pick = Uniform(placed.size());
+            cmd.type = input_cancel;
+            cmd.order_id = placed[pick];
+            placed[pick] = placed.back();
+            placed.pop_back();
+            return;
+        }
+
+        // Orders of a burst hit the instrument it started on.
+        int instrument = burst_left > 0 ? burst_instrument : PickInstrument();
+        int & mid = mids[instrument];
+        if (Chance(config.volatility))
+            mid = std::max(config.depth + 2, mid + (Chance(0.5) ? 1 : -1));
+
+        bool buy = Chance(0.5);
+        int offset;
+        if (Chance(config.aggressive_ratio))
+            // Through the touch by a few ticks, sweeping the top levels.
+            offset = -1 - int(std::exponential_distribution<double>(0.5)(rng));
+        else
+            // Mostly near the touch, thinning out towards the depth.
+            offset = std::min(config.depth, int(std::exponential_distribution<double>(4.0 / config.depth)(rng)));
+
+        cmd.type = buy ? input_buy : input_sell;
+        cmd.order_id = next_id++;
+        cmd.price = std::max(1, buy ? mid - offset : mid + 1 + offset);
+        cmd.count = 1 + std::geometric_distribution<int>(1.0 / config.mean_quantity)(rng);
+        strncpy(cmd.instrument, tickers[instrument].c_str(), sizeof(cmd.instrument) - 1);
+        placed.push_back(cmd.order_id);
+    }
+
+private:
+    bool Chance(double p) { return std::uniform_real_distribution<double>(0, 1)(rng) < p; }
+    size_t Uniform(size_t n) { return std::uniform_int_distribution<size_t>(0, n - 1)(rng); }
+
+    int PickInstrument()
+    {
+        double at = std::uniform_real_distribution<double>(0, popularity.back())(rng);
+        return std::min<int>(std::upper_bound(popularity.begin(), popularity.end(), at) - popularity.begin(), config.instruments - 1);
+    }
+
+    const WorkloadConfig & config;
+    std::mt19937_64 rng;
+    std::vector<double> popularity;
+    std::vector<std::string> tickers;
+    std::vector<int> mids;
+    // Orders each client placed and has not cancelled yet.
+    std::vector<std::vector<uint32_t>> live;
+    uint32_t next_id = 1;
+    int burst_left = 0;
+    int burst_client = 0;
+    int burst_instrument = 0;
+};
+
+#endif
@@ -1,67 +1,293 @@
 #ifndef ATOMIC_MAP_HPP
 #define ATOMIC_MAP_HPP
 
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <mutex>
-#include "io.hpp"
+#include <utility>
 
-template <typename T>
-struct WrapperValue
+#include "epoch_reclaimer.hpp"
+
+/**
+ * Concurrent hash map with lock-free lookups and inserts.
+ * 
+ * Entries are nodes allocated once and never moved, so a value keeps its
+ * address for as long as its key is in the map. Slots of an open
+ * addressing table hold node pointers and only change from empty to a node
+ * and from a node to a tombstone, so probing never needs a lock.
+ * 
+ * Once half the slots are used, one thread under a mutex grows the table:
+ * it links a larger table behind the old one, then freezes every slot of
+ * the old table by tagging it and copies the live nodes over. Lookups and
+ * inserts reaching a frozen empty slot continue in the next table, so no
+ * insert racing with the copy is lost. Erases, which are rare, take the
+ * same mutex. The old table and erased nodes are retired through the
+ * EpochReclaimer, and lookups and inserts hold a guard while they touch
+ * the tables.
+ * 
+ * @tparam Hash Only needs to tell keys apart, the map mixes the bits.
+*/
+template <typename K, typename V, typename Hash = std::hash<K>>
+class AtomicMap
 {
-    std::mutex lock;
-    bool initialised;
-    T val;
-    WrapperValue() = default;
-    WrapperValue(const WrapperValue & v) : initialised(v.initialised), val(v.val) { }
-    WrapperValue & operator=(const WrapperValue & v)
+public:
+    explicit AtomicMap(size_t capacity = 16) : current(new Table(RoundUp(capacity))) { }
+
+    /**
+     * Frees everything; no other thread may still use the map.
+    */
+    ~AtomicMap()
     {
-        this->initialised = v.initialised;
-        this->val = v.val;
-        return *this;
+        Table * table = current.load();
+        for (size_t i = 0; i <= table->mask; i++)
+            if (Node * node = Untag(table->slots[i].load()); node != nullptr && node != TOMBSTONE)
+                delete node;
+        delete table;
     }
-    T & Get()
+
+    AtomicMap(const AtomicMap &) = delete;
+    AtomicMap & operator=(const AtomicMap &) = delete;
+
+    /**
+     * @return the value of key, or null. It stays valid until key is erased.
+    */
+    V * Find(const K & key) const
     {
-        std::unique_lock<std::mutex> l(lock);
-        return val;
+        EpochReclaimer::Guard guard;
+        size_t hash = Hash()(key);
+        for (Table * table = current.load(); table != nullptr;)
+        {
+            Node * node = Probe(*table, key, hash, table);
+            if (node != nullptr)
+                return &node->value;
+        }
+        return nullptr;
     }
-};
 
-template <typename K, typename V, typename Comparator = std::less<K>>
-class AtomicMap
-{
-public:
-    AtomicMap() = default;
-    AtomicMap(const AtomicMap & map) : map(map.map) { }
-    AtomicMap(const Comparator & comp) : map(comp) { }
+    /**
+     * Returns the value of key, inserting a default constructed one first
+     * if there is none.
+    */
+    V & Get(const K & key)
+    {
+        if (V * value = Find(key))
+            return *value;
+        return *Insert(key, V()).first;
+    }
 
-    V & Get(K key)
+    /**
+     * Inserts value for key unless the key is present.
+     * 
+     * @return the value in the map and whether it was inserted.
+    */
+    std::pair<V *, bool> Insert(const K & key, V value)
     {
-        if (map.find(key) != map.end())
-            return map[key];
+        EpochReclaimer::Guard guard;
+        size_t hash = Hash()(key);
+        Node * node = new Node{key, std::move(value)};
+        Table * table = current.load();
+        while (true)
+        {
+            size_t i = Home(hash, *table);
+            while (true)
+            {
+                Node * slot = table->slots[i].load();
+                Node * existing = Untag(slot);
+                if (slot == nullptr)
+                {
+                    if (!table->slots[i].compare_exchange_strong(slot, node))
+                        continue;
+                    size.fetch_add(1);
+                    if (table->used.fetch_add(1) + 1 > (table->mask + 1) / 2)
+                        Grow(table);
+                    return {&node->value, true};
+                }
+                // Frozen or not, a node found here is the one in the map.
+                if (existing != nullptr && existing != TOMBSTONE && existing->key == key)
+                {
+                    delete node;
+                    return {&existing->value, false};
+                }
+                if (existing == nullptr)
+                    break;
+                i = (i + 1) & table->mask;
+            }
+            // The table is being copied and the key is not in it, so it
+            // goes straight to the next one.
+            table = NextTable(*table);
+        }
+    }
 
-        return Create(key);
+    /**
+     * @return the number of values erased, 0 or 1.
+    */
+    size_t Erase(const K & key)
+    {
+        // Erases are rare enough to wait out a growth rather than chase the
+        // node into the next table while it is copied.
+        std::unique_lock<std::mutex> l(grow_mutex);
+        Table * table = current.load();
+        for (size_t i = Home(Hash()(key), *table);; i = (i + 1) & table->mask)
+        {
+            Node * slot = table->slots[i].load();
+            if (slot == nullptr)
+                return 0;
+            if (slot != TOMBSTONE && slot->key == key)
+            {
+                // Only another erase would change the slot, and they are serialised.
+                table->slots[i].store(TOMBSTONE);
+                size.fetch_sub(1);
+                EpochReclaimer::Instance().Retire(slot, [](void * p) { delete static_cast<Node *>(p); });
+                return 1;
+            }
+        }
     }
 
-    size_t Size() const { return map.size(); }
+    size_t Size() const { return size.load(); }
 
-    std::map<K, V, Comparator>::iterator begin() { return map.begin(); }
+    /**
+     * Visits every entry, in no particular order. Entries inserted or
+     * erased meanwhile may or may not be visited.
+    */
+    template <typename Visitor>
+    void ForEach(Visitor && visit)
+    {
+        // Holding off growth keeps the current table complete.
+        std::unique_lock<std::mutex> l(grow_mutex);
+        EpochReclaimer::Guard guard;
+        Table * table = current.load();
+        for (size_t i = 0; i <= table->mask; i++)
+            if (Node * node = table->slots[i].load(); node != nullptr && node != TOMBSTONE)
+                visit(node->key, node->value);
+    }
 
-    std::map<K, V, Comparator>::iterator end() { return map.end(); }
+private:
+    struct alignas(8) Node
+    {
+        const K key;
+        V value;
+    };
 
-    size_t Erase(const K & key) { return map.erase(key); }
+    struct Table
+    {
+        explicit Table(size_t capacity)
+            : mask(capacity - 1), shift(64 - std::countr_zero(capacity)), slots(new std::atomic<Node *>[capacity]())
+        {
+        }
 
-private:
-    V & Create(K key)
+        const size_t mask;
+        const int shift;
+        std::unique_ptr<std::atomic<Node *>[]> slots;
+        // Slots holding a node or a tombstone.
+        std::atomic<size_t> used{0};
+        // Set before the first slot is frozen.
+        std::atomic<Table *> next{nullptr};
+    };
+
+    // Low bit of a slot marking it frozen by a copy to the next table.
+    static constexpr uintptr_t FROZEN = 1;
+    static inline Node * const TOMBSTONE = reinterpret_cast<Node *>(2);
+
+    static bool IsFrozen(Node * slot) { return reinterpret_cast<uintptr_t>(slot) & FROZEN; }
+    static Node * Untag(Node * slot) { return reinterpret_cast<Node *>(reinterpret_cast<uintptr_t>(slot) & ~FROZEN); }
+
+    static size_t RoundUp(size_t capacity)
+    {
+        size_t size = 16;
+        while (size < capacity)
+            size <<= 1;
+        return size;
+    }
+
+    static size_t Home(size_t hash, const Table & table)
     {
-        std::unique_lock<std::mutex> lock(mutex);
-        if (map.find(key) == map.end())
-            map[key] = V();
+        // Fibonacci hashing keeps the well mixed high bits.
+        return (uint64_t(hash) * 0x9E3779B97F4A7C15ull) >> table.shift;
+    }
+
+    static Table * NextTable(const Table & table)
+    {
+        // The next table is linked before any slot is frozen.
+        return table.next.load();
+    }
 
-        return map[key];
+    /**
+     * Looks key up in table, setting next to the table to continue in when
+     * it reaches a frozen empty slot, null otherwise.
+    */
+    static Node * Probe(const Table & table, const K & key, size_t hash, Table *& next)
+    {
+        for (size_t i = Home(hash, table);; i = (i + 1) & table.mask)
+        {
+            Node * slot = table.slots[i].load();
+            Node * node = Untag(slot);
+            if (node == nullptr)
+            {
+                next = IsFrozen(slot) ? NextTable(table) : nullptr;
+                return nullptr;
+            }
+            if (node != TOMBSTONE && node->key == key)
+            {
+                next = nullptr;
+                return node;
+            }
+        }
+    }
+
+    /**
+     * Copies the live nodes of table into a larger one and makes it current.
+    */
+    void Grow(Table * table)
+    {
+        std::unique_lock<std::mutex> l(grow_mutex);
+        if (table->next.load() != nullptr)
+            return;
+
+        Table * grown = new Table(RoundUp(std::max(size.load(), size_t(1)) * 4));
+        table->next.store(grown);
+        for (size_t i = 0; i <= table->mask; i++)
+        {
+            Node * slot = table->slots[i].load();
+            while (!table->slots[i].compare_exchange_weak(slot, reinterpret_cast<Node *>(reinterpret_cast<uintptr_t>(slot) | FROZEN)))
+                ;
+            if (slot != nullptr && slot != TOMBSTONE)
+                Place(*grown, slot);
+        }
+
+        current.store(grown);
+        EpochReclaimer::Instance().Retire(table, [](void * p) { delete static_cast<Table *>(p); });
+        // Inserts racing with the copy may have filled the new table already.
+        if (grown->used.load() > (grown->mask + 1) / 2)
+        {
+            l.unlock();
+            Grow(grown);
+        }
+    }
+
+    /**
+     * Adds a node copied from the previous table. Its key cannot have been
+     * inserted in the new table, which only takes keys absent from the old.
+    */
+    static void Place(Table & table, Node * node)
+    {
+        for (size_t i = Home(Hash()(node->key), table);; i = (i + 1) & table.mask)
+        {
+            Node * expected = nullptr;
+            if (table.slots[i].compare_exchange_strong(expected, node))
+            {
+                table.used.fetch_add(1);
+                return;
+            }
+        }
     }
 
-    std::mutex mutex;
-    std::map<K, V, Comparator> map;
+    std::atomic<Table *> current;
+    std::atomic<size_t> size{0};
+    std::mutex grow_mutex;
 };
 
-#endif
\ No newline at end of file
+#endif
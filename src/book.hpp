@@ -1,58 +1,125 @@
 #ifndef BOOK_HPP
 #define BOOK_HPP
 
-#include <deque>
-#include <map>
-#include <memory>
+#include <limits>
 #include <mutex>
+#include <thread>
+#include <assert.h>
 
+#include "latency_stats.hpp"
 #include "order.hpp"
+#include "order_index.hpp"
+#include "price_ladder.hpp"
+#include "trace.hpp"
 
 inline std::chrono::microseconds::rep getCurrentTimestamp() noexcept
 {
     return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
-inline void MatchOrders(std::shared_ptr<Order> incoming, std::shared_ptr<Order> resting)
+/**
+ * @return the quantity traded.
+*/
+inline unsigned int MatchOrders(Order & incoming, Order & resting)
 {
-    unsigned int qty = std::min(incoming->GetCount(), resting->GetCount());
-    incoming->Fill(qty);
-    resting->Fill(qty);
+    unsigned int qty = std::min(incoming.GetCount(), resting.GetCount());
+    incoming.Fill(qty);
+    resting.Fill(qty);
     Output::OrderExecuted(
-        resting->GetOrderId(), incoming->GetOrderId(), resting->GetExecutionId(), resting->GetPrice(), qty, getCurrentTimestamp());
+        resting.GetOrderId(), incoming.GetOrderId(), resting.GetExecutionId(), resting.GetPrice(), qty, getCurrentTimestamp());
+    return qty;
 }
 
-typedef std::deque<std::shared_ptr<Order>> Price;
+// Building with -DPRICE_LADDER switches every Book to the array ladder.
+#ifdef PRICE_LADDER
 template <typename T>
-using BookT = std::map<price_t, std::shared_ptr<Price>, T>;
+using DefaultLadder = ArrayLadder<T>;
+#else
+template <typename T>
+using DefaultLadder = MapLadder<T>;
+#endif
+
+/**
+ * Totals of the visible orders at one price, as returned by depth queries.
+*/
+struct DepthLevel
+{
+    price_t price;
+    uint64_t quantity;
+    uint32_t orders;
+};
+
+/**
+ * Totals of the visible orders of one side of a book.
+*/
+struct BookTotals
+{
+    uint64_t quantity = 0;
+    uint64_t orders = 0;
+};
 
 /**
  * Base class of Book.
  * 
- * Defines the interface of the Book class.
+ * Defines the interface of the Book class. A book owns the orders resting
+ * in it and destroys them once they are filled or cancelled.
 */
 class BaseBook
 {
 public:
-    virtual void Add(std::shared_ptr<Order> order) = 0;
-    virtual void Cancel(std::shared_ptr<Order> order) = 0;
-    virtual void AfterExecute(std::shared_ptr<Order> order, bool filled) = 0;
-    virtual bool CrossSpread(std::shared_ptr<Order> order) = 0;
+    virtual void Add(Order & order) = 0;
+    virtual void Cancel(order_id_t order_id) = 0;
+    virtual void AfterExecute(Order & order, bool filled) = 0;
+    virtual void Rest(Order & order) = 0;
+    virtual bool CrossSpread(Order & order) = 0;
+    virtual Order * Amend(order_id_t order_id, price_t price, unsigned int count, int64_t timestamp) = 0;
+
+    // Variants for a book owned by a single thread, see OrderBook::HandleExclusive.
+    virtual bool CrossSpreadExclusive(Order & order) = 0;
+    virtual void RestExclusive(Order & order) = 0;
+    virtual void CancelExclusive(order_id_t order_id) = 0;
+    virtual Order * AmendExclusive(order_id_t order_id, price_t price, unsigned int count) = 0;
+
+    // Depth queries, see OrderBook::Best.
+    virtual bool Best(DepthLevel & level) = 0;
+    virtual size_t Depth(DepthLevel * levels, size_t count) = 0;
+    virtual uint64_t QuantityUpTo(price_t price) = 0;
+    virtual BookTotals Totals() = 0;
     virtual ~BaseBook() = default;
+
+    /**
+     * Where to store the price of every trade against this book.
+    */
+    void TrackLastTrade(std::atomic<price_t> * last) { last_trade = last; }
+
+    /**
+     * Best price holding any node, dummy nodes included, or the worst price
+     * of the side when it is empty. Read without the lock, see
+     * OrderBook::TryRest.
+    */
+    price_t BestHint() const { return best_hint.load(std::memory_order_acquire); }
+
+protected:
+    std::atomic<price_t> * last_trade = nullptr;
+    std::atomic<price_t> best_hint{0};
 };
 
 /**
  * Represents a particular Side of the OrderBook (Buy or Sell side).
+ * 
+ * @tparam T Comparator ordering prices from best to worst.
+ * @tparam Levels Price ladder storing the levels, see price_ladder.hpp.
 */
-template <typename T>
+template <typename T, typename Levels = DefaultLadder<T>>
 class Book : public BaseBook
 {
 public:
-    virtual void Add(std::shared_ptr<Order> order) override
+    Book() { UpdateBestHint(); }
+
+    virtual void Add(Order & order) override
     {
-        std::unique_lock<std::mutex> l(mutex);
-        std::shared_ptr<Price> p = GetOrAssign(order->GetPrice());
-        p->push_back(order);
+        std::unique_lock<BookMutex> l = LatencyStats::Lock(mutex, Stage::BookLock);
+        Insert(order);
     }
 
     /**
@@ -62,119 +129,560 @@ public:
      * @param order Order to be matched with the current book.
      * @return the successful matching of the entire order.
     */
-    virtual bool CrossSpread(std::shared_ptr<Order> order) override
+    virtual bool CrossSpread(Order & order) override
+    {
+        std::unique_lock<BookMutex> l = LatencyStats::Lock(mutex, Stage::BookLock);
+        return Match(order, &l);
+    }
+
+    virtual bool CrossSpreadExclusive(Order & order) override { return Match(order, nullptr); }
+
+    /**
+     * Rests an order that cannot cross, in a single critical section, so it
+     * is never seen as a dummy node and no one waits for it.
+    */
+    virtual void Rest(Order & order) override
+    {
+        std::unique_lock<BookMutex> l = LatencyStats::Lock(mutex, Stage::BookLock);
+        RestExclusive(order);
+    }
+
+    /**
+     * Adds the unfilled remainder of an order matched by the owning thread.
+    */
+    virtual void RestExclusive(Order & order) override
+    {
+        Insert(order);
+        Show(order);
+        Report(order);
+        Activate(order);
+    }
+
+    virtual void Cancel(order_id_t order_id) override
+    {
+        std::unique_lock<BookMutex> l = LatencyStats::Lock(mutex, Stage::BookLock);
+        Order * order = index.Find(order_id);
+        while (order != nullptr && !order->GetActivated())
+        {
+            TRACE(TRACE_DEBUG, CancelWaiting, order_id);
+            int64_t waiting = LatencyStats::Start();
+            WaitForActivation(l);
+            LatencyStats::Record(Stage::Activation, waiting);
+            order = index.Find(order_id);
+        }
+
+        Remove(order, order_id);
+    }
+
+    virtual void CancelExclusive(order_id_t order_id) override { Remove(index.Find(order_id), order_id); }
+
+    /**
+     * Amends a resting order.
+     * 
+     * A smaller quantity at the same price is applied in place, so the order
+     * keeps its priority. Otherwise the order leaves its level and is put
+     * back at the new price as a dummy node with the new timestamp, in the
+     * same critical section, for the caller to match like a new order.
+     * 
+     * @return the order to match, null when the amend is complete.
+    */
+    virtual Order * Amend(order_id_t order_id, price_t price, unsigned int count, int64_t timestamp) override
+    {
+        std::unique_lock<BookMutex> l = LatencyStats::Lock(mutex, Stage::BookLock);
+        Order * order = index.Find(order_id);
+        while (order != nullptr && !order->GetActivated())
+        {
+            TRACE(TRACE_DEBUG, AmendWaiting, order_id);
+            int64_t waiting = LatencyStats::Start();
+            WaitForActivation(l);
+            LatencyStats::Record(Stage::Activation, waiting);
+            order = index.Find(order_id);
+        }
+
+        order = Reshape(order, order_id, price, count);
+        if (order != nullptr)
+        {
+            order->SetTimestamp(timestamp);
+            order->Deactivate();
+            Insert(*order);
+        }
+        return order;
+    }
+
+    /**
+     * Single writer Amend, returning the order to match out of the book.
+    */
+    virtual Order * AmendExclusive(order_id_t order_id, price_t price, unsigned int count) override
+    {
+        return Reshape(index.Find(order_id), order_id, price, count);
+    }
+
+    /**
+     * Calls visit on every resting order, best price first and in time
+     * priority within a level. Only for a book owned by the calling thread.
+    */
+    template <typename Visitor>
+    void ForEachResting(Visitor && visit)
+    {
+        price_t price;
+        for (Price * priceQueue = levels.First(price); priceQueue != nullptr; priceQueue = levels.Next(price))
+            for (Order * order = priceQueue->front(); order != nullptr; order = order->next)
+                visit(*order);
+    }
+
+    /**
+     * Best level holding visible orders, false if there is none.
+    */
+    virtual bool Best(DepthLevel & level) override { return Depth(&level, 1) == 1; }
+
+    /**
+     * Writes up to count levels holding visible orders, best first.
+     * 
+     * @return the number of levels written.
+    */
+    virtual size_t Depth(DepthLevel * out, size_t count) override
+    {
+        std::unique_lock<BookMutex> l = ProfiledLock(mutex);
+        size_t written = 0;
+        price_t price;
+        for (Price * priceQueue = levels.First(price); priceQueue != nullptr && written < count; priceQueue = levels.Next(price))
+        {
+            // Levels only holding dummy nodes are not part of the book yet.
+            if (priceQueue->orders() > 0)
+                out[written++] = DepthLevel{price, priceQueue->quantity(), priceQueue->orders()};
+        }
+        return written;
+    }
+
+    /**
+     * Visible quantity at price or better.
+    */
+    virtual uint64_t QuantityUpTo(price_t price) override
+    {
+        std::unique_lock<BookMutex> l = ProfiledLock(mutex);
+        return Accumulate(price, UINT64_MAX);
+    }
+
+    virtual BookTotals Totals() override
+    {
+        std::unique_lock<BookMutex> l = ProfiledLock(mutex);
+        return totals;
+    }
+
+    /**
+     * Names the lock of this side in the lock profile.
+    */
+    void LabelLock(const char * name, symbol_t symbol) { ::LabelLock(mutex, name, symbol); }
+
+    /**
+     * Puts back an order that was resting when a snapshot was taken, behind
+     * the orders already restored at its price, without printing anything.
+    */
+    void Restore(Order & order)
+    {
+        Insert(order);
+        Show(order);
+        Activate(order);
+    }
+
+    /**
+     * Handles the remaining unfilled quantity of the order.
+     * 
+     * Adds the remaining order to the heap if any, otherwise takes the
+     * filled dummy node out and destroys the order.
+     * 
+     * @param order The order to be added into the current book.
+     * @param filled Whether the order has been fully filled.
+    */
+    virtual void AfterExecute(Order & order, bool filled) override
+    {
+        std::unique_lock<BookMutex> l = LatencyStats::Lock(mutex, Stage::BookLock);
+
+        if (!filled)
+            Show(order);
+        if (!filled || order.GetAmended())
+            Report(order);
+        // Add
+        Activate(order);
+
+        // Waiters were notified above and look the level up again once they
+        // wake, so they never touch the destroyed order.
+        if (filled)
+        {
+            Unlink(order);
+            Order::Destroy(&order);
+        }
+    }
+    virtual ~Book()
+    {
+        price_t price;
+        for (Price * priceQueue = levels.First(price); priceQueue != nullptr; priceQueue = levels.Next(price))
+            while (!priceQueue->empty())
+            {
+                Order * order = priceQueue->front();
+                priceQueue->pop_front();
+                Order::Destroy(order);
+            }
+    }
+
+private:
+    static constexpr int ACTIVATION_SPINS = 64;
+
+    /**
+     * Activates an order of this side, under the lock, and wakes the
+     * threads waiting for an activation if there are any.
+    */
+    void Activate(Order & order)
+    {
+        order.Activate();
+        activations.fetch_add(1, std::memory_order_release);
+        if (activation_waiters.load(std::memory_order_relaxed) > 0)
+            activations.notify_all();
+    }
+
+    /**
+     * Releases the lock until the next activation of an order of this side,
+     * spinning briefly before parking on the sequence, then locks it again.
+     * Any activation wakes every waiter, and each checks again whether its
+     * own order is activated, or gone.
+    */
+    void WaitForActivation(std::unique_lock<BookMutex> & l)
+    {
+        // Read and registered under the lock, so an activation cannot slip
+        // in between unnoticed.
+        uint32_t seen = activations.load(std::memory_order_relaxed);
+        activation_waiters.fetch_add(1, std::memory_order_relaxed);
+        l.unlock();
+        for (int i = 0; i < ACTIVATION_SPINS && activations.load(std::memory_order_acquire) == seen; i++)
+            std::this_thread::yield();
+        activations.wait(seen, std::memory_order_acquire);
+        activation_waiters.fetch_sub(1, std::memory_order_relaxed);
+        l.lock();
+    }
+
+    void Insert(Order & order)
+    {
+        levels.GetOrAssign(order.GetPrice()).push_back(order);
+        UpdateBestHint();
+        index.Insert(order.GetOrderId(), &order);
+    }
+
+    /**
+     * Counts a resting order in the totals of its level once it is activated.
+    */
+    void Show(Order & order)
+    {
+        Price * priceQueue = levels.Find(order.GetPrice());
+        Show(*priceQueue, order);
+        Publish(order.GetSymbol(), order.GetPrice(), priceQueue);
+    }
+
+    // Keep the totals of the book in step with those of its levels.
+    void Show(Price & priceQueue, const Order & order)
+    {
+        priceQueue.Show(order);
+        totals.quantity += order.GetCount();
+        totals.orders++;
+    }
+    void Trade(Price & priceQueue, unsigned int qty)
+    {
+        priceQueue.Trade(qty);
+        totals.quantity -= qty;
+    }
+    void Hide(Price & priceQueue, const Order & order)
+    {
+        priceQueue.Hide(order);
+        totals.quantity -= order.GetCount();
+        totals.orders--;
+    }
+
+    void UpdateBestHint()
+    {
+        price_t price;
+        best_hint.store(levels.First(price) != nullptr ? price : EMPTY, std::memory_order_release);
+    }
+
+    /**
+     * Sums the visible quantity of the levels at limit or better, from the
+     * totals of each level, stopping once it reaches needed.
+    */
+    uint64_t Accumulate(price_t limit, uint64_t needed)
+    {
+        uint64_t available = 0;
+        price_t price;
+        for (Price * priceQueue = levels.First(price); priceQueue != nullptr && !T()(limit, price) && available < needed;
+             priceQueue = levels.Next(price))
+            available += priceQueue->quantity();
+        return available;
+    }
+
+    /**
+     * Reports an order left resting after matching on arrival. An amended
+     * order reports its amend instead, with the quantity left, even when
+     * that is nothing.
+    */
+    static void Report(const Order & order)
+    {
+        if (order.GetAmended())
+            Output::OrderAmended(order.GetOrderId(), order.GetPrice(), order.GetCount(), true, getCurrentTimestamp());
+        else
+            Output::OrderAdded(
+                order.GetOrderId(),
+                SymbolText(order.GetSymbol()).c_str(),
+                order.GetPrice(),
+                order.GetCount(),
+                order.GetSide() == Side::SELL,
+                getCurrentTimestamp());
+    }
+
+    /**
+     * Reports the totals of a level to the market data feed, null when the
+     * level is gone.
+    */
+    static void Publish(symbol_t symbol, price_t price, const Price * priceQueue)
+    {
+        if (Output::MarketDataEnabled())
+            Output::LevelChanged(
+                symbol, SELL_SIDE, price, priceQueue ? priceQueue->quantity() : 0, priceQueue ? priceQueue->orders() : 0);
+    }
+
+    /**
+     * Takes the order out of its level, reclaiming the level once empty.
+    */
+    void Unlink(Order & order)
+    {
+        Price * priceQueue = levels.Find(order.GetPrice());
+        priceQueue->erase(order);
+        if (priceQueue->empty())
+        {
+            levels.Erase(order.GetPrice());
+            UpdateBestHint();
+        }
+        index.Erase(order.GetOrderId());
+    }
+
+    /**
+     * Matching loop shared by CrossSpread and CrossSpreadExclusive.
+     * 
+     * @param l Lock held on the book, released while waiting for resting
+     *          orders to be activated. Null for a single writer book.
+    */
+    bool Match(Order & order, std::unique_lock<BookMutex> * l)
     {
-        std::unique_lock<std::mutex> l(mutex);
-        if (map.size() == 0)
+        // Exact as long as no resting order is still being activated, which
+        // Engine::Submit ensures by holding both side locks for FOK orders.
+        if (order.GetTimeInForce() == TimeInForce::FOK && Fillable(order) < order.GetCount())
             return false;
 
-        for (auto & [price, priceQueue] : map)
+        price_t price;
+        for (Price * priceQueue = levels.First(price); priceQueue != nullptr; priceQueue = levels.Next(price))
         {
-            if (!order->CanMatch(price))
-                return order->GetCount() == 0;
+            if (!order.CanMatch(price))
+                break;
 
+            bool traded = false;
+            bool prevented = false;
             // Iteratively match with all orders in this price queue.
-            while (order->GetCount() > 0 && priceQueue->size())
+            while (order.GetCount() > 0 && !priceQueue->empty())
             {
-                std::shared_ptr<Order> oppOrder = priceQueue->front();
+                Order & oppOrder = *priceQueue->front();
                 // Check if first order's timestamp comes before the current buy
-                if (oppOrder->GetTimestamp() > order->GetTimestamp())
+                if (oppOrder.GetTimestamp() > order.GetTimestamp())
                     break;
 
                 // Check if sell order is activated
-                while (!oppOrder->GetActivated())
+                if (!oppOrder.GetActivated())
                 {
-                    SyncInfo() << "[EXECUTE] Order: " << order->GetOrderId() << " going to sleep" << std::endl;
-                    oppOrder->cv.wait(l);
-                }
+                    assert(l != nullptr && "single writer books only hold activated orders");
+                    TRACE(TRACE_DEBUG, MatchWaiting, order.GetOrderId(), oppOrder.GetOrderId(), price);
+                    int64_t waiting = LatencyStats::Start();
+                    WaitForActivation(*l);
+                    LatencyStats::Record(Stage::Activation, waiting);
 
-                if (oppOrder->GetCompleted())
+                    // The order may be gone and its level reclaimed while unlocked.
+                    priceQueue = levels.Find(price);
+                    if (priceQueue == nullptr)
+                        break;
                     continue;
+                }
 
-                // Check if dummy order has already been filled
-                if (oppOrder->GetCount() > 0)
+                if (order.SelfTrades(oppOrder))
                 {
-                    oppOrder->IncrementExecutionId();
-                    MatchOrders(order, oppOrder);
+                    PreventSelfTrade(*priceQueue, order, oppOrder);
+                    prevented = true;
+                    continue;
                 }
-                if (oppOrder->GetCount() == 0)
+
+                oppOrder.IncrementExecutionId();
+                Trade(*priceQueue, MatchOrders(order, oppOrder));
+                traded = true;
+                if (oppOrder.GetCount() == 0)
                 {
-                    oppOrder->SetCompleted();
+                    Hide(*priceQueue, oppOrder);
                     priceQueue->pop_front();
+                    index.Erase(oppOrder.GetOrderId());
+                    Order::Destroy(&oppOrder);
                 }
             }
+
+            if (priceQueue != nullptr && priceQueue->empty())
+            {
+                levels.Erase(price);
+                UpdateBestHint();
+                priceQueue = nullptr;
+            }
+            // One update per level crossed, with the totals it was left with.
+            if (traded || prevented)
+                Publish(order.GetSymbol(), price, priceQueue);
+            if (traded && last_trade != nullptr)
+                last_trade->store(price, std::memory_order_relaxed);
+            if (order.GetCount() == 0)
+                break;
         }
-        return order->GetCount() == 0;
+        return order.GetCount() == 0;
     }
 
-    virtual void Cancel(std::shared_ptr<Order> order) override
+    /**
+     * Quantity a FOK order can take up to its limit price. Resting orders of
+     * its own client do not count when self-trade prevention would cancel
+     * them, and end the count when it would cancel the order itself, so the
+     * orders of the levels are walked only then.
+    */
+    uint64_t Fillable(const Order & order)
     {
-        std::unique_lock<std::mutex> l(mutex);
-        while (!order->GetActivated())
-            order->cv.wait(l);
+        SelfTrade mode = order.GetSelfTrade();
+        if (mode == SelfTrade::Allow || mode == SelfTrade::Decrement || order.GetClient() == Order::NO_CLIENT)
+            return Accumulate(order.GetPrice(), order.GetCount());
 
-        std::shared_ptr<Price> priceQueue = GetOrAssign(order->GetPrice());
-        Price::iterator start;
-        for (start = priceQueue->begin(); start != priceQueue->end(); start++)
-            if ((*start)->GetOrderId() == order->GetOrderId())
-                break;
+        uint64_t available = 0;
+        price_t price;
+        for (Price * priceQueue = levels.First(price); priceQueue != nullptr && !T()(order.GetPrice(), price); priceQueue = levels.Next(price))
+            for (Order * resting = priceQueue->front(); resting != nullptr; resting = resting->next)
+            {
+                if (available >= order.GetCount())
+                    return available;
+                // Dummy nodes are not in the level totals either.
+                if (!resting->GetActivated())
+                    continue;
+                if (order.SelfTrades(*resting))
+                {
+                    if (mode != SelfTrade::CancelOldest)
+                        return available;
+                    continue;
+                }
+                available += resting->GetCount();
+            }
+        return available;
+    }
 
-        // No order found
-        if (start == priceQueue->end())
+    /**
+     * Keeps the incoming order from trading with the resting order of the
+     * same client at the front of its level. Orders cancelled are reported
+     * deleted. A resting order decremented without being cancelled keeps
+     * its place and is reported amended; the incoming order just carries on
+     * with less.
+    */
+    void PreventSelfTrade(Price & priceQueue, Order & order, Order & oppOrder)
+    {
+        SelfTrade mode = order.GetSelfTrade();
+        TRACE(TRACE_DEBUG, SelfTradePrevented, order.GetOrderId(), oppOrder.GetOrderId(), uint8_t(mode));
+        unsigned int taken = mode == SelfTrade::Decrement ? std::min(order.GetCount(), oppOrder.GetCount()) : 0;
+        bool cancelResting = mode == SelfTrade::CancelOldest || mode == SelfTrade::CancelBoth || taken == oppOrder.GetCount();
+        bool cancelIncoming = mode == SelfTrade::CancelNewest || mode == SelfTrade::CancelBoth || taken == order.GetCount();
+
+        Hide(priceQueue, oppOrder);
+        if (cancelResting)
         {
-            Output::OrderDeleted(order->GetOrderId(), false, getCurrentTimestamp());
-            return;
+            order_id_t restingId = oppOrder.GetOrderId();
+            priceQueue.pop_front();
+            index.Erase(restingId);
+            Order::Destroy(&oppOrder);
+            Output::OrderDeleted(restingId, true, getCurrentTimestamp());
         }
-
-        std::shared_ptr<Order> o = *start;
-        if (o->GetCompleted())
+        else
         {
-            Output::OrderDeleted(order->GetOrderId(), false, getCurrentTimestamp());
-            return;
+            oppOrder.Resize(oppOrder.GetCount() - taken);
+            Show(priceQueue, oppOrder);
+            if (taken > 0)
+                Output::OrderAmended(oppOrder.GetOrderId(), oppOrder.GetPrice(), oppOrder.GetCount(), true, getCurrentTimestamp());
         }
-        int cnt = o->GetCount();
-        o->SetCompleted();
-        priceQueue->erase(start);
 
-        Output::OrderDeleted(order->GetOrderId(), cnt > 0, getCurrentTimestamp());
+        if (cancelIncoming)
+        {
+            order.Resize(0);
+            Output::OrderDeleted(order.GetOrderId(), true, getCurrentTimestamp());
+        }
+        else
+            order.Resize(order.GetCount() - taken);
     }
 
     /**
-     * Handles the remaining unfilled quantity of the order.
-     * 
-     * Adds the remaining order to the heap if any.
+     * Applies an amend in place when it keeps the price and does not add
+     * quantity, else takes the order out of its level with the new price
+     * and quantity. Amends of missing orders, or to nothing, are rejected.
      * 
-     * @param order The order to be added into the current book.
-     * @param filled Whether the order has been fully filled.
+     * @return the order taken out, null when the amend is complete.
     */
-    virtual void AfterExecute(std::shared_ptr<Order> order, bool filled) override
+    Order * Reshape(Order * order, order_id_t order_id, price_t price, unsigned int count)
     {
-        std::unique_lock<std::mutex> l(mutex);
+        if (order == nullptr || count == 0)
+        {
+            Output::OrderAmended(order_id, price, count, false, getCurrentTimestamp());
+            return nullptr;
+        }
 
-        if (!filled)
-            Output::OrderAdded(
-                order->GetOrderId(),
-                order->GetInstrumentId().c_str(),
-                order->GetPrice(),
-                order->GetCount(),
-                order->GetSide() == Side::SELL,
-                getCurrentTimestamp());
-        // Add
-        order->Activate();
+        price_t oldPrice = order->GetPrice();
+        Price * priceQueue = levels.Find(oldPrice);
+        Hide(*priceQueue, *order);
+        if (price == oldPrice && count <= order->GetCount())
+        {
+            order->Resize(count);
+            Show(*priceQueue, *order);
+            Publish(order->GetSymbol(), price, priceQueue);
+            Output::OrderAmended(order_id, price, count, true, getCurrentTimestamp());
+            return nullptr;
+        }
+
+        Unlink(*order);
+        Publish(order->GetSymbol(), oldPrice, levels.Find(oldPrice));
+        order->Amend(price, count);
+        return order;
     }
-    virtual ~Book() = default;
 
-private:
-    std::shared_ptr<Price> GetOrAssign(price_t price)
+    void Remove(Order * order, order_id_t order_id)
     {
-        if (!map.contains(price))
-            map[price] = std::make_shared<Price>();
-        return map[price];
+        // No order found, it was either filled or never rested here.
+        if (order == nullptr)
+        {
+            Output::OrderDeleted(order_id, false, getCurrentTimestamp());
+            return;
+        }
+
+        unsigned int cnt = order->GetCount();
+        symbol_t symbol = order->GetSymbol();
+        price_t price = order->GetPrice();
+        Hide(*levels.Find(price), *order);
+        Unlink(*order);
+        Publish(symbol, price, levels.Find(price));
+        Order::Destroy(order);
+
+        Output::OrderDeleted(order_id, cnt > 0, getCurrentTimestamp());
     }
 
 private:
-    BookT<T> map;
-    std::mutex mutex;
+    // Whether this is the ask side, i.e. prices are ordered from low to high.
+    static constexpr bool SELL_SIDE = T()(0, 1);
+    // Best hint of an empty side, which only an order at the limit price crosses.
+    static constexpr price_t EMPTY = SELL_SIDE ? std::numeric_limits<price_t>::max() : 0;
+
+    Levels levels;
+    BookTotals totals;
+    // Resting orders by id, so a cancel goes straight to its node.
+    OrderIndex index;
+    BookMutex mutex;
+    // Bumped by every activation; threads waiting for one park on it.
+    std::atomic<uint32_t> activations{0};
+    std::atomic<uint32_t> activation_waiters{0};
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,141 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "book_snapshot.hpp"
+#include "io.hpp"
+
+static uint32_t Fnv1a(uint32_t hash, const void * data, size_t length)
+{
+    const unsigned char * bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+static uint32_t Checksum(std::span<const SnapshotBook> books, std::span<const SnapshotOrder> orders)
+{
+    uint32_t hash = Fnv1a(2166136261u, books.data(), books.size_bytes());
+    return Fnv1a(hash, orders.data(), orders.size_bytes());
+}
+
+static bool WriteAll(int fd, const void * data, size_t length)
+{
+    const char * bytes = static_cast<const char *>(data);
+    for (size_t offset = 0; offset < length;)
+    {
+        ssize_t n = write(fd, bytes + offset, length - offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return false;
+        offset += n;
+    }
+    return true;
+}
+
+void BookSnapshot::Capture(OrderBook & book)
+{
+    SnapshotBook entry{book.symbol, 0, 0};
+    book.ForEachResting([&](Order & order) {
+        orders.push_back(SnapshotOrder{order.GetOrderId(), order.GetPrice(), order.GetCount(), order.GetExecutionId(), order.GetClient()});
+        if (order.GetSide() == Side::BUY)
+            entry.bids++;
+        else
+            entry.asks++;
+    });
+    books.push_back(entry);
+}
+
+bool BookSnapshot::Write(const std::string & path) const
+{
+    SnapshotHeader header{};
+    header.magic = SnapshotHeader::MAGIC;
+    header.version = SnapshotHeader::VERSION;
+    header.checksum = Checksum(books, orders);
+    header.journal_sequence = journal_sequence;
+    header.books = books.size();
+    header.orders = orders.size();
+
+    std::string staging = path + ".tmp";
+    int fd = open(staging.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+    {
+        SyncCerr{} << "Failed to open snapshot " << staging << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    bool ok = WriteAll(fd, &header, sizeof(header)) && WriteAll(fd, books.data(), books.size() * sizeof(SnapshotBook)) &&
+        WriteAll(fd, orders.data(), orders.size() * sizeof(SnapshotOrder)) && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(staging.c_str(), path.c_str()) != 0)
+    {
+        SyncCerr{} << "Failed to write snapshot " << path << ": " << strerror(errno) << std::endl;
+        unlink(staging.c_str());
+        return false;
+    }
+
+    // Make the rename itself durable.
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int dir = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dir != -1)
+    {
+        fsync(dir);
+        close(dir);
+    }
+    return true;
+}
+
+SnapshotReader::SnapshotReader(const std::string & path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        if (errno == ENOENT)
+            return;
+        throw std::runtime_error("Failed to open snapshot " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(SnapshotHeader))
+    {
+        mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Failed to map snapshot " + path);
+        }
+        length = st.st_size;
+    }
+    close(fd);
+    if (mapped == nullptr)
+        return;
+
+    const SnapshotHeader * candidate = static_cast<const SnapshotHeader *>(mapped);
+    if (candidate->magic != SnapshotHeader::MAGIC || candidate->version != SnapshotHeader::VERSION ||
+        length != sizeof(SnapshotHeader) + candidate->books * sizeof(SnapshotBook) + candidate->orders * sizeof(SnapshotOrder))
+        return;
+
+    const char * bytes = static_cast<const char *>(mapped);
+    std::span<const SnapshotBook> mapped_books(
+        reinterpret_cast<const SnapshotBook *>(bytes + sizeof(SnapshotHeader)), candidate->books);
+    std::span<const SnapshotOrder> mapped_orders(
+        reinterpret_cast<const SnapshotOrder *>(bytes + sizeof(SnapshotHeader) + mapped_books.size_bytes()), candidate->orders);
+    if (Checksum(mapped_books, mapped_orders) != candidate->checksum)
+        return;
+
+    header = candidate;
+    books = mapped_books;
+    orders = mapped_orders;
+}
+
+SnapshotReader::~SnapshotReader()
+{
+    if (mapped != nullptr)
+        munmap(mapped, length);
+}
@@ -0,0 +1,112 @@
+#ifndef BOOK_SNAPSHOT_HPP
+#define BOOK_SNAPSHOT_HPP
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "order.hpp"
+#include "order_book.hpp"
+#include "symbol.hpp"
+
+/*
+ * A snapshot file is laid out flat so it can be used straight from a
+ * mapping:
+ * 
+ *   SnapshotHeader
+ *   SnapshotBook[header.books]    one per instrument, in order of creation
+ *   SnapshotOrder[header.orders]  resting orders of every book, in the order
+ *                                 of the books, bids then asks, each in
+ *                                 priority order
+*/
+
+struct SnapshotHeader
+{
+    static constexpr uint64_t MAGIC = 0x50414e53424d4345ull; // "ECMBSNAP"
+    static constexpr uint32_t VERSION = 2;
+
+    uint64_t magic;
+    uint32_t version;
+    // FNV-1a of everything following the header.
+    uint32_t checksum;
+    // Journal records covered by the snapshot; replay resumes after them.
+    uint64_t journal_sequence;
+    uint64_t books;
+    uint64_t orders;
+};
+
+struct SnapshotBook
+{
+    symbol_t symbol;
+    uint32_t bids;
+    uint32_t asks;
+};
+
+struct SnapshotOrder
+{
+    order_id_t order_id;
+    price_t price;
+    uint32_t count;
+    execution_id_t execution_id;
+    client_id_t client;
+};
+
+/**
+ * Point-in-time copy of the books, captured in memory while the books are
+ * quiescent and written out afterwards.
+*/
+struct BookSnapshot
+{
+    /**
+     * Copies the resting orders of the book. Only valid while no thread
+     * is matching on it.
+    */
+    void Capture(OrderBook & book);
+
+    /**
+     * Writes the snapshot next to path and renames it over path once it is
+     * on disk, so a crash leaves either the old or the new snapshot.
+     *
+     * @return false if the file could not be written.
+    */
+    bool Write(const std::string & path) const;
+
+    uint64_t journal_sequence = 0;
+    std::vector<SnapshotBook> books;
+    std::vector<SnapshotOrder> orders;
+};
+
+/**
+ * Maps a snapshot file for reading.
+*/
+class SnapshotReader
+{
+public:
+    /**
+     * Maps the file; a missing file reads as no snapshot.
+    */
+    explicit SnapshotReader(const std::string & path);
+    ~SnapshotReader();
+
+    SnapshotReader(const SnapshotReader &) = delete;
+    SnapshotReader & operator=(const SnapshotReader &) = delete;
+
+    /**
+     * Whether a complete snapshot with a matching checksum was found.
+    */
+    bool Valid() const { return header != nullptr; }
+
+    uint64_t JournalSequence() const { return header->journal_sequence; }
+    std::span<const SnapshotBook> Books() const { return books; }
+    std::span<const SnapshotOrder> Orders() const { return orders; }
+
+private:
+    void * mapped = nullptr;
+    size_t length = 0;
+    const SnapshotHeader * header = nullptr;
+    std::span<const SnapshotBook> books;
+    std::span<const SnapshotOrder> orders;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+/**
+ * Fixed capacity FIFO shared between producer and consumer threads.
+ * 
+ * Push blocks while the queue is full and Pop blocks while it is empty,
+ * which gives the producers backpressure instead of unbounded growth.
+*/
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : slots(capacity), head(0), size(0) { }
+
+    void Push(T value)
+    {
+        std::unique_lock<std::mutex> l(mutex);
+        while (size == slots.size())
+            not_full.wait(l);
+
+        slots[(head + size) % slots.size()] = std::move(value);
+        size++;
+        l.unlock();
+        not_empty.notify_one();
+    }
+
+    T Pop()
+    {
+        std::unique_lock<std::mutex> l(mutex);
+        while (size == 0)
+            not_empty.wait(l);
+
+        T value = std::move(slots[head]);
+        head = (head + 1) % slots.size();
+        size--;
+        l.unlock();
+        not_full.notify_one();
+        return value;
+    }
+
+private:
+    std::vector<T> slots;
+    size_t head;
+    size_t size;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+};
+
+#endif
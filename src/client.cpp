@@ -17,6 +17,7 @@
 #define INPUT_CANCEL_ORDER 'C'
 #define INPUT_BUY_ORDER 'B'
 #define INPUT_SELL_ORDER 'S'
+#define INPUT_AMEND_ORDER 'A'
 
 static char* line_buffer;
 static size_t line_buffer_size = 0;
@@ -104,16 +105,30 @@ int main(int argc, char* argv[])
 					return 1;
 				}
 				break;
+			case INPUT_AMEND_ORDER:
+				input.type = input_amend;
+				if(sscanf(line_buffer + 1, " %u %u %u", &input.order_id, &input.price, &input.count) != 3)
+				{
+					fprintf(stderr, "Invalid amend order: %s\n", line_buffer);
+					return 1;
+				}
+				break;
 			case INPUT_BUY_ORDER: input.type = input_buy; goto new_order;
 			case INPUT_SELL_ORDER:
 				input.type = input_sell;
 			new_order:
-				if(sscanf(line_buffer + 1, " %u %8s %u %u", &input.order_id, input.instrument, &input.price, &input.count) != 4)
+			{
+				// An optional trailing I, F or M makes an IOC, FOK or market order.
+				char order_type = order_limit;
+				int fields = sscanf(line_buffer + 1, " %u %8s %u %u %c", &input.order_id, input.instrument, &input.price, &input.count, &order_type);
+				if(fields < 4 || (order_type != order_limit && order_type != order_ioc && order_type != order_fok && order_type != order_market))
 				{
 					fprintf(stderr, "Invalid new order: %s\n", line_buffer);
 					return 1;
 				}
+				input.order_type = order_type;
 				break;
+			}
 			default: fprintf(stderr, "Invalid command '%c'\n", line_buffer[0]); return 1;
 		}
 
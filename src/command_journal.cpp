@@ -0,0 +1,249 @@
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "command_journal.hpp"
+#include "io.hpp"
+
+// Empty polls before the writer thread parks itself.
+static constexpr int SPIN_LIMIT = 256;
+
+// Journal synced once more when the process exits, since the engine binary
+// only ever leaves through exit() and never destroys its engine.
+static std::atomic<CommandJournal *> exit_journal{nullptr};
+
+static void SyncAtExit()
+{
+    if (CommandJournal * journal = exit_journal.load())
+        journal->Sync();
+}
+
+uint32_t JournalRecord::Checksum() const
+{
+    // FNV-1a over every field before the checksum.
+    const unsigned char * bytes = reinterpret_cast<const unsigned char *>(this);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(JournalRecord, checksum); i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+CommandJournal::CommandJournal(const std::string & path, uint64_t sequence, size_t queue_capacity)
+    : queue(queue_capacity), appended(sequence), durable(sequence), start(sequence), sequence(sequence)
+{
+    fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd == -1)
+        throw std::runtime_error("Failed to open journal " + path);
+
+    // Drop a torn record left by a crash so new records follow the valid ones.
+    if (ftruncate(fd, sequence * sizeof(JournalRecord)) != 0 || lseek(fd, 0, SEEK_END) == -1)
+        throw std::runtime_error("Failed to truncate journal " + path);
+
+    thread = std::thread(&CommandJournal::writer_thread, this);
+
+    static std::once_flag registered;
+    std::call_once(registered, []() { atexit(SyncAtExit); });
+    exit_journal.store(this);
+}
+
+CommandJournal::~CommandJournal()
+{
+    CommandJournal * self = this;
+    exit_journal.compare_exchange_strong(self, nullptr);
+
+    stopping.store(true, std::memory_order_seq_cst);
+    sleeping.store(false, std::memory_order_relaxed);
+    sleeping.notify_one();
+    thread.join();
+    close(fd);
+}
+
+uint64_t CommandJournal::AppendOrder(symbol_t symbol, const Order & order)
+{
+    JournalRecord record{};
+    record.symbol = symbol;
+    record.order_id = order.GetOrderId();
+    record.price = order.GetPrice();
+    record.count = order.GetCount();
+    record.type = order.GetSide() == Side::BUY ? 'B' : 'S';
+    record.sell = order.GetSide() == Side::SELL;
+    record.time_in_force = uint8_t(order.GetTimeInForce());
+    record.self_trade = uint8_t(order.GetSelfTrade());
+    record.client = order.GetClient();
+    return Append(record);
+}
+
+uint64_t CommandJournal::AppendCancel(symbol_t symbol, order_id_t order_id, Side side)
+{
+    JournalRecord record{};
+    record.symbol = symbol;
+    record.order_id = order_id;
+    record.type = 'C';
+    record.sell = side == Side::SELL;
+    return Append(record);
+}
+
+uint64_t CommandJournal::AppendAmend(symbol_t symbol, order_id_t order_id, Side side, price_t price, uint32_t count)
+{
+    JournalRecord record{};
+    record.symbol = symbol;
+    record.order_id = order_id;
+    record.price = price;
+    record.count = count;
+    record.type = 'A';
+    record.sell = side == Side::SELL;
+    return Append(record);
+}
+
+uint64_t CommandJournal::Append(JournalRecord & record)
+{
+    size_t position;
+    while (!queue.TryPush(record, position))
+        std::this_thread::yield();
+    appended.fetch_add(1, std::memory_order_release);
+
+    // Pairs with the fence in writer_thread so either the writer sees the
+    // record before parking or we see it parked.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed))
+    {
+        sleeping.store(false, std::memory_order_relaxed);
+        sleeping.notify_one();
+    }
+    // The writer numbers records in the order it pops them.
+    return start + position + 1;
+}
+
+void CommandJournal::Sync() const
+{
+    uint64_t target = Appended();
+    while (Durable() < target)
+        std::this_thread::yield();
+}
+
+/**
+ * Stops the engine on a journal error. Commands could no longer be
+ * appended, and after a failed sync it is unknown what reached the disk,
+ * so executing more of them would break the write-ahead guarantee.
+*/
+[[noreturn]] static void Fail(const char * operation)
+{
+    SyncCerr{} << "Failed to " << operation << " journal: " << strerror(errno) << std::endl;
+    std::abort();
+}
+
+void CommandJournal::writer_thread()
+{
+    std::unique_ptr<JournalRecord[]> group(new JournalRecord[GROUP_SIZE]);
+    int idle = 0;
+    while (true)
+    {
+        size_t count = 0;
+        while (count < GROUP_SIZE && queue.TryPop(group[count]))
+        {
+            // Numbered in file order, which is what replay follows.
+            group[count].sequence = sequence++;
+            group[count].checksum = group[count].Checksum();
+            count++;
+        }
+
+        if (count > 0)
+        {
+            idle = 0;
+            const char * bytes = reinterpret_cast<const char *>(group.get());
+            size_t length = count * sizeof(JournalRecord);
+            for (size_t offset = 0; offset < length;)
+            {
+                ssize_t n = write(fd, bytes + offset, length - offset);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0)
+                    Fail("write");
+                offset += n;
+            }
+            if (fdatasync(fd) != 0)
+                Fail("sync");
+            durable.store(sequence, std::memory_order_release);
+            continue;
+        }
+
+        if (stopping.load(std::memory_order_relaxed) && Appended() == sequence)
+            return;
+        if (++idle < SPIN_LIMIT)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (Appended() == sequence && !stopping.load(std::memory_order_relaxed))
+            sleeping.wait(true);
+        sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+JournalReader::JournalReader(const std::string & path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        if (errno == ENOENT)
+            return;
+        throw std::runtime_error("Failed to open journal " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void * memory = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if (memory == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Failed to map journal " + path);
+        }
+        records = static_cast<const JournalRecord *>(memory);
+        mapped = st.st_size;
+    }
+    close(fd);
+}
+
+JournalReader::~JournalReader()
+{
+    if (records != nullptr)
+        munmap(const_cast<JournalRecord *>(records), mapped);
+}
+
+const JournalRecord * JournalReader::Next()
+{
+    if (!Valid(next))
+        return nullptr;
+    return &records[next++];
+}
+
+bool JournalReader::Seek(uint64_t sequence)
+{
+    // Records before a snapshot were synced before it was written, so the
+    // last one standing for all of them is enough.
+    if (sequence > 0 && !Valid(sequence - 1))
+        return false;
+    next = sequence;
+    return true;
+}
+
+bool JournalReader::Valid(uint64_t sequence) const
+{
+    if ((sequence + 1) * sizeof(JournalRecord) > mapped)
+        return false;
+
+    const JournalRecord & record = records[sequence];
+    return record.sequence == sequence && record.checksum == record.Checksum();
+}
@@ -0,0 +1,156 @@
+#ifndef COMMAND_JOURNAL_HPP
+#define COMMAND_JOURNAL_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "mpsc_queue.hpp"
+#include "order.hpp"
+#include "symbol.hpp"
+
+/**
+ * One command in the journal file.
+ * 
+ * The sequence number is the position of the record in the file, and the
+ * checksum covers everything before it, so a record torn by a crash is
+ * recognised and recovery stops right before it.
+*/
+struct JournalRecord
+{
+    uint64_t sequence;
+    symbol_t symbol;
+    order_id_t order_id;
+    price_t price;
+    uint32_t count;
+    // 'B', 'S', 'C' or 'A' like CommandType.
+    char type;
+    // Side of the order to cancel or amend, 1 for sell.
+    uint8_t sell;
+    // TimeInForce of orders, zero for GTC.
+    uint8_t time_in_force;
+    // SelfTrade mode and client of orders, so replay prevents the same trades.
+    uint8_t self_trade;
+    client_id_t client;
+    uint32_t checksum;
+
+    Side GetSide() const { return sell ? Side::SELL : Side::BUY; }
+    TimeInForce GetTimeInForce() const { return TimeInForce(time_in_force); }
+    SelfTrade GetSelfTrade() const { return SelfTrade(self_trade); }
+    uint32_t Checksum() const;
+};
+
+/**
+ * Append-only write-ahead journal of the commands executed by the engine.
+ * 
+ * Matching threads append a record before executing a command and carry
+ * on; a writer thread takes everything queued since its last pass, writes
+ * it with one write() and makes it durable with one fdatasync(), so the
+ * cost of syncing is shared by every command of the group. A failed write
+ * or sync aborts the process rather than leave commands unjournaled.
+ * 
+ * Whatever was appended is synced when the process exits through exit(),
+ * as the engine binary does on SIGINT and SIGTERM.
+*/
+class CommandJournal
+{
+public:
+    /**
+     * Appends to the journal at path, created if missing.
+     * 
+     * @param sequence Number of records already in the file.
+    */
+    CommandJournal(const std::string & path, uint64_t sequence, size_t queue_capacity);
+
+    /**
+     * Syncs everything appended before destruction.
+    */
+    ~CommandJournal();
+
+    CommandJournal(const CommandJournal &) = delete;
+    CommandJournal & operator=(const CommandJournal &) = delete;
+
+    /**
+     * Queues a record for the command.
+     * 
+     * @return the value of Durable() from which the record is on disk.
+    */
+    uint64_t AppendOrder(symbol_t symbol, const Order & order);
+    uint64_t AppendCancel(symbol_t symbol, order_id_t order_id, Side side);
+    uint64_t AppendAmend(symbol_t symbol, order_id_t order_id, Side side, price_t price, uint32_t count);
+
+    /**
+     * Number of records appended so far, including those in the file at start.
+    */
+    uint64_t Appended() const { return appended.load(std::memory_order_acquire); }
+
+    /**
+     * Number of records known to be on disk.
+    */
+    uint64_t Durable() const { return durable.load(std::memory_order_acquire); }
+
+    /**
+     * Blocks until every record appended before the call is on disk.
+    */
+    void Sync() const;
+
+private:
+    static constexpr size_t GROUP_SIZE = 4096;
+
+    uint64_t Append(JournalRecord & record);
+    void writer_thread();
+
+    int fd;
+    MpscQueue<JournalRecord> queue;
+    std::atomic<uint64_t> appended;
+    std::atomic<uint64_t> durable;
+    // Records in the file when it was opened, ahead of every queued one.
+    const uint64_t start;
+    uint64_t sequence;
+    std::atomic<bool> sleeping{false};
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+};
+
+/**
+ * Reads the valid prefix of a journal file.
+*/
+class JournalReader
+{
+public:
+    /**
+     * Maps the file; a missing or empty file reads as an empty journal.
+    */
+    explicit JournalReader(const std::string & path);
+    ~JournalReader();
+
+    JournalReader(const JournalReader &) = delete;
+    JournalReader & operator=(const JournalReader &) = delete;
+
+    /**
+     * Returns the next record, or null at the end of the valid records.
+    */
+    const JournalRecord * Next();
+
+    /**
+     * Skips the first sequence records, as when a snapshot covers them.
+     * 
+     * @return false if the journal holds fewer valid records than that.
+    */
+    bool Seek(uint64_t sequence);
+
+    /**
+     * Records returned so far.
+    */
+    uint64_t Sequence() const { return next; }
+
+private:
+    bool Valid(uint64_t sequence) const;
+
+    const JournalRecord * records = nullptr;
+    size_t mapped = 0;
+    uint64_t next = 0;
+};
+
+#endif
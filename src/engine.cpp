@@ -1,5 +1,11 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <stdexcept>
 #include <thread>
 #include <unordered_map>
 
@@ -7,76 +13,462 @@
 #include "io.hpp"
 #include "order.hpp"
 #include "order_book.hpp"
+#include "trace.hpp"
+
+// Engine dumping latency stats, written once more when the process exits
+// since the engine binary only ever leaves through exit().
+static std::atomic<Engine *> stats_engine{nullptr};
+
+static void WriteStatsAtExit()
+{
+    if (Engine * engine = stats_engine.load())
+        engine->WriteStats();
+}
+
+Engine::Engine(EngineOptions options) : options(options)
+{
+    // Before recovery creates books, so they are placed too.
+    std::vector<ThreadPlacement> placements;
+    if (options.matching == Matching::Sharded)
+    {
+        placements = NumaTopology::Instance().Place(options.shards, options.pinning, options.numa_nodes);
+        std::vector<int> nodes;
+        for (const ThreadPlacement & placement : placements)
+            nodes.push_back(placement.node);
+        instruments.Place(std::move(nodes));
+    }
+    if (!options.market_data.empty())
+    {
+        market_data = std::make_unique<MarketDataFeed>(
+            options.market_data, options.market_data_capacity, options.market_data_snapshot_interval);
+        OutputJournal::Instance().AttachMarketData(market_data.get());
+    }
+    if (!options.journal.empty())
+    {
+        uint64_t recovered = Recover();
+        journal = std::make_unique<CommandJournal>(options.journal, recovered, options.journal_queue_capacity);
+        OutputJournal::Instance().AttachCommandJournal(journal.get());
+    }
+    if (options.matching == Matching::Sharded)
+        for (size_t i = 0; i < options.shards; i++)
+            shards.push_back(std::make_unique<MatchingShard>(options.shard_queue_capacity, journal.get(), placements[i]));
+    if (options.threading == Threading::Pooled)
+    {
+        pool = std::make_unique<MatchingPool>(*this, options.matching_threads, options.queue_capacity);
+        reactor = std::make_unique<Reactor>(*pool, options.io_threads);
+    }
+    if (!options.snapshot.empty())
+        snapshots = std::thread(&Engine::snapshot_thread, this);
+    if (!options.stats.empty())
+    {
+        LatencyStats::Instance().Enable();
+        stats = std::thread(&Engine::stats_thread, this);
+        static std::once_flag registered;
+        std::call_once(registered, []() { atexit(WriteStatsAtExit); });
+        stats_engine.store(this);
+    }
+}
+
+Engine::~Engine()
+{
+    {
+        std::unique_lock<std::mutex> l(background_mutex);
+        stopping = true;
+    }
+    background_stop.notify_all();
+    if (snapshots.joinable())
+        snapshots.join();
+    if (stats.joinable())
+        stats.join();
+
+    // Stop reading before the workers go away, and the workers before the shards.
+    reactor.reset();
+    pool.reset();
+    shards.clear();
+    if (journal)
+    {
+        // Release the held events before the journal goes away.
+        journal->Sync();
+        OutputJournal::Instance().AttachCommandJournal(nullptr);
+        OutputJournal::Instance().Flush();
+    }
+    journal.reset();
+
+    // A last dump covers every command handled.
+    if (!options.stats.empty())
+    {
+        Engine * self = this;
+        stats_engine.compare_exchange_strong(self, nullptr);
+        WriteStats();
+    }
+
+    if (market_data)
+    {
+        OutputJournal::Instance().AttachMarketData(nullptr);
+        OutputJournal::Instance().Flush();
+    }
+}
+
+uint64_t Engine::Recover()
+{
+    auto start = std::chrono::steady_clock::now();
+    JournalReader reader(options.journal);
+    std::unique_ptr<SnapshotReader> snapshot;
+    if (!options.snapshot.empty())
+        snapshot = std::make_unique<SnapshotReader>(options.snapshot);
+
+    // The events were printed when the commands first ran; only the market
+    // data feed, which starts from empty books, hears about them again.
+    OutputJournal::Instance().Mute(true);
+    size_t restored = 0;
+    if (snapshot && snapshot->Valid())
+    {
+        if (!reader.Seek(snapshot->JournalSequence()))
+            throw std::runtime_error("Snapshot " + options.snapshot + " is ahead of journal " + options.journal);
+
+        // Orders follow the books in the same order, bids then asks.
+        const SnapshotOrder * order = snapshot->Orders().data();
+        for (const SnapshotBook & entry : snapshot->Books())
+        {
+            OrderBook & book = GetOrderBook(entry.symbol);
+            for (uint32_t i = 0; i < entry.bids + entry.asks; i++, order++)
+            {
+                Order * restoredOrder = Order::from(order->order_id, entry.symbol, order->price, order->count,
+                    i < entry.bids ? Side::BUY : Side::SELL, TimeInForce::GTC, book.node);
+                restoredOrder->SetExecutionId(order->execution_id);
+                // Only the mode of an incoming order matters.
+                restoredOrder->SetClient(order->client, SelfTrade::Allow);
+                next_session_id = std::max<size_t>(next_session_id, order->client);
+                book.Restore(*restoredOrder);
+            }
+        }
+        restored = snapshot->Orders().size();
+    }
+    uint64_t skipped = reader.Sequence();
+    while (const JournalRecord * record = reader.Next())
+    {
+        OrderBook & book = GetOrderBook(record->symbol);
+        if (record->type == input_cancel)
+            book.CancelExclusive(record->order_id, record->GetSide());
+        else if (record->type == input_amend)
+            book.AmendExclusive(record->order_id, record->GetSide(), record->price, record->count);
+        else
+        {
+            Order * order = Order::from(record->order_id, record->symbol, record->price, record->count, record->GetSide(),
+                record->GetTimeInForce(), book.node);
+            order->SetClient(record->client, record->GetSelfTrade());
+            book.HandleExclusive(*order);
+            next_session_id = std::max<size_t>(next_session_id, record->client);
+        }
+    }
+    OutputJournal::Instance().Flush();
+    OutputJournal::Instance().Mute(false);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    SyncCerr{} << "Recovered " << restored << " orders from snapshot and " << reader.Sequence() - skipped
+               << " commands from " << options.journal << " in " << elapsed.count() << " s" << std::endl;
+    return reader.Sequence();
+}
 
 void Engine::accept(ClientConnection connection)
 {
-    auto thread = std::thread(&Engine::connection_thread, this, std::move(connection));
+    Session * session;
+    {
+        std::unique_lock<std::mutex> l(sessions_mutex);
+        session = new Session(std::move(connection), next_session_id++);
+        live_sessions++;
+    }
+
+    if (options.threading == Threading::Pooled)
+    {
+        reactor->Register(session);
+        return;
+    }
+
+    auto thread = std::thread(&Engine::connection_thread, this, session);
     thread.detach();
 }
 
-void Engine::connection_thread(ClientConnection connection)
+void Engine::connection_thread(Session * session)
 {
-    std::unordered_map<int, std::shared_ptr<Order>> orders;
+    OutputJournal::Instance().Attach();
     while (true)
     {
-        ClientCommand input{};
-        switch (connection.readInput(input))
+        std::span<const ClientCommand> commands;
+        switch (session->connection.readBatch(commands))
         {
             case ReadResult::Error:
                 SyncCerr{} << "Error reading input" << std::endl;
+                [[fallthrough]];
             case ReadResult::EndOfFile:
-                SyncCerr{} << "END OF FILE\n";
+            case ReadResult::WouldBlock:
+                TRACE(TRACE_INFO, ConnectionClosed, session->id);
+                CloseSession(session);
                 return;
             case ReadResult::Success:
                 break;
         }
 
-        // Functions for printing output actions in the prescribed format are
-        // provided in the Output class:
-        switch (input.type)
-        {
-            case input_cancel: {
-                SyncCerr{} << "Got cancel: ID: " << input.order_id << std::endl;
+        HandleBatch(*session, commands, LatencyStats::Start());
+    }
+}
 
-                // Checks if the order has been added by the current client before.
-                if (orders.find(input.order_id) == orders.end())
-                {
-                    Output::OrderDeleted(input.order_id, false, getCurrentTimestamp());
-                    break;
-                }
-                std::shared_ptr<Order> order = orders[input.order_id];
-                std::shared_ptr<OrderBook> ob = GetOrderBook(order->GetInstrumentId());
-                ob->Cancel(order);
+void Engine::HandleBatch(Session & session, std::span<const ClientCommand> commands, int64_t received)
+{
+    for (const ClientCommand & input : commands)
+        HandleCommand(session, input, received);
+}
+
+void Engine::HandleCommand(Session & session, const ClientCommand & input, int64_t received)
+{
+    // Functions for printing output actions in the prescribed format are
+    // provided in the Output class:
+    switch (input.type)
+    {
+        case input_cancel: {
+            TRACE(TRACE_INFO, CancelReceived, input.order_id);
+
+            // Checks if the order has been added by the current client before.
+            auto it = session.orders.find(input.order_id);
+            if (it == session.orders.end())
+            {
+                LatencyStats::Scope scope(LatencyStats::NONE, session.id);
+                Output::OrderDeleted(input.order_id, false, getCurrentTimestamp());
                 break;
             }
+            SubmitCancel(*it->second.book, input.order_id, it->second, session.id, received);
+            break;
+        }
 
-            default: {
-                SyncCerr{} << "Got order: " << static_cast<char>(input.type) << " " << input.instrument << " x " << input.count << " @ "
-                           << input.price << " ID: " << input.order_id << std::endl;
-
-                std::shared_ptr<Order> order = Order::from(
-                    input.order_id, input.instrument, input.price, input.count, input.type == input_sell ? Side::SELL : Side::BUY);
-                orders.insert({order->GetOrderId(), order});
-                std::shared_ptr<OrderBook> ob = GetOrderBook(order->GetInstrumentId());
+        case input_amend: {
+            TRACE(TRACE_INFO, AmendReceived, input.order_id, input.price, input.count);
 
-                std::unique_lock<std::mutex> l(order->GetSide() == Side::BUY ? ob->buy : ob->sell);
-                ob->Handle(order);
+            auto it = session.orders.find(input.order_id);
+            if (it == session.orders.end())
+            {
+                LatencyStats::Scope scope(LatencyStats::NONE, session.id);
+                Output::OrderAmended(input.order_id, input.price, input.count, false, getCurrentTimestamp());
                 break;
             }
+            if (options.risk.Enabled())
+            {
+                RejectReason reason = CheckRisk(session, *it->second.book, it->second.side, input.price, input.count, false, false);
+                if (reason != RejectReason::None)
+                {
+                    LatencyStats::Scope scope(it->second.book->id, session.id);
+                    Output::OrderRejected(input.order_id, reason, getCurrentTimestamp());
+                    break;
+                }
+            }
+            SubmitAmend(*it->second.book, input, it->second, session.id, received);
+            break;
         }
-        SyncCerr() << "END OF INPUT\n";
+
+        default: {
+            Side side = input.type == input_sell ? Side::SELL : Side::BUY;
+            symbol_t symbol = PackSymbol(input.instrument);
+            if (side == Side::BUY)
+                TRACE(TRACE_INFO, BuyReceived, input.order_id, symbol, input.price, input.count);
+            else
+                TRACE(TRACE_INFO, SellReceived, input.order_id, symbol, input.price, input.count);
+            price_t price = input.price;
+            TimeInForce timeInForce = TimeInForce::GTC;
+            switch (input.order_type)
+            {
+                case order_ioc: timeInForce = TimeInForce::IOC; break;
+                case order_fok: timeInForce = TimeInForce::FOK; break;
+                case order_market:
+                    timeInForce = TimeInForce::IOC;
+                    price = side == Side::BUY ? std::numeric_limits<price_t>::max() : 0;
+                    break;
+                default: break;
+            }
+            OrderBook & ob = GetOrderBook(symbol);
+            if (options.risk.Enabled())
+            {
+                RejectReason reason = CheckRisk(session, ob, side, price, input.count, input.order_type == order_market, true);
+                if (reason != RejectReason::None)
+                {
+                    LatencyStats::Scope scope(ob.id, session.id);
+                    Output::OrderRejected(input.order_id, reason, getCurrentTimestamp());
+                    break;
+                }
+            }
+            Order * order = Order::from(input.order_id, symbol, price, input.count, side, timeInForce, ob.node);
+            order->SetClient(session.Client(), options.self_trade);
+            if (session.risk != nullptr)
+                session.risk->Accepted(*order, session.risk->Exposure(ob.id));
+            // An order that never rests can never be cancelled either.
+            if (order->Rests())
+                session.orders[input.order_id] = OrderRef{&ob, side};
+            Submit(ob, *order, session.id, received);
+            break;
+        }
+    }
+}
+
+RejectReason Engine::CheckRisk(Session & session, OrderBook & book, Side side, price_t price, uint32_t count, bool market, bool adds)
+{
+    if (session.risk == nullptr)
+    {
+        std::unique_lock<std::mutex> l(accounts_mutex);
+        accounts.push_back(std::make_unique<RiskAccount>(options.risk));
+        session.risk = accounts.back().get();
+    }
+    return session.risk->Check(book.id, book.LastTradePrice(), side, price, count, market, adds);
+}
+
+void Engine::Submit(OrderBook & book, Order & order, size_t connection, int64_t received)
+{
+    if (options.matching == Matching::Sharded)
+    {
+        shards[book.shard]->Handle(&book, &order, connection, received);
+        return;
+    }
+
+    LatencyStats::Scope scope(book.id, connection);
+    // An order that cannot cross rests without waiting for the side lock.
+    if (book.TryRest(order))
+    {
+        LatencyStats::Record(Stage::Queued, received);
+        return;
+    }
+
+    // A FOK order holds the other side too, so the totals it checks are not
+    // changed by orders of that side being activated meanwhile. The buy lock
+    // is always taken first.
+    bool bothSides = order.GetTimeInForce() == TimeInForce::FOK;
+    std::unique_lock<BookMutex> l
+        = LatencyStats::Lock(order.GetSide() == Side::BUY || bothSides ? book.buy : book.sell, Stage::SideLock);
+    std::unique_lock<BookMutex> other;
+    if (bothSides)
+        other = LatencyStats::Lock(book.sell, Stage::SideLock);
+    LatencyStats::Record(Stage::Queued, received);
+    book.Handle(order);
+}
+
+void Engine::SubmitCancel(OrderBook & book, order_id_t order_id, const OrderRef & ref, size_t connection, int64_t received)
+{
+    if (options.matching == Matching::Sharded)
+    {
+        shards[book.shard]->Cancel(&book, order_id, ref.side, connection, received);
+        return;
+    }
+
+    LatencyStats::Scope scope(book.id, connection);
+    LatencyStats::Record(Stage::Queued, received);
+    book.Cancel(order_id, ref.side);
+}
+
+void Engine::SubmitAmend(OrderBook & book, const ClientCommand & input, const OrderRef & ref, size_t connection, int64_t received)
+{
+    if (options.matching == Matching::Sharded)
+    {
+        shards[book.shard]->Amend(&book, input.order_id, ref.side, input.price, input.count, connection, received);
+        return;
     }
+
+    // Held like for a new order of the side, since the amended order may
+    // be matched again.
+    LatencyStats::Scope scope(book.id, connection);
+    std::unique_lock<BookMutex> l = LatencyStats::Lock(ref.side == Side::BUY ? book.buy : book.sell, Stage::SideLock);
+    LatencyStats::Record(Stage::Queued, received);
+    book.Amend(input.order_id, ref.side, input.price, input.count);
+}
+
+void Engine::CloseSession(Session * session)
+{
+    delete session;
+
+    std::unique_lock<std::mutex> l(sessions_mutex);
+    live_sessions--;
+    if (live_sessions == 0)
+        sessions_closed.notify_all();
 }
 
-std::shared_ptr<OrderBook> Engine::GetOrderBook(instrument_id_t instrument)
+void Engine::WaitForConnections()
 {
-    WrapperValue<std::shared_ptr<OrderBook>> & w = instruments.Get(instrument);
-    std::unique_lock<std::mutex> l(w.lock);
-    if (!w.initialised)
+    std::unique_lock<std::mutex> l(sessions_mutex);
+    while (live_sessions > 0)
+        sessions_closed.wait(l);
+    l.unlock();
+
+    for (auto & shard : shards)
+        shard->Drain();
+    OutputJournal::Instance().Flush();
+}
+
+bool Engine::TakeSnapshot()
+{
+    BookSnapshot snapshot;
     {
-        w.initialised = true;
-        w.val = std::make_shared<OrderBook>();
+        MatchingShard::Quiesce quiesce(shards.size());
+        for (auto & shard : shards)
+            shard->Pause(quiesce);
+        quiesce.paused.wait();
+
+        // Every command appended to the journal so far has executed, and
+        // none after it has.
+        snapshot.journal_sequence = journal->Appended();
+        instruments.ForEach([&](OrderBook & book) { snapshot.Capture(book); });
+        quiesce.resume.set_value();
     }
 
-    return w.val;
-}
\ No newline at end of file
+    // Only publish a snapshot once the journal it follows is on disk, or a
+    // crash could leave it ahead of the journal.
+    while (journal->Durable() < snapshot.journal_sequence)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return snapshot.Write(options.snapshot);
+}
+
+void Engine::snapshot_thread()
+{
+    uint64_t last = journal->Appended();
+    std::unique_lock<std::mutex> l(background_mutex);
+    while (!background_stop.wait_for(l, std::chrono::seconds(options.snapshot_interval), [this] { return stopping; }))
+    {
+        if (journal->Appended() == last)
+            continue;
+        last = journal->Appended();
+        l.unlock();
+        TakeSnapshot();
+        l.lock();
+    }
+}
+
+bool Engine::WriteStats()
+{
+    std::vector<std::string> names;
+    instruments.ForEach(
+        [&](OrderBook & book)
+        {
+            names.resize(std::max(names.size(), book.id + 1));
+            names[book.id] = SymbolText(book.symbol).c_str();
+        });
+
+    // Readers never see a half written dump.
+    std::string temporary = options.stats + ".tmp";
+    FILE * out = fopen(temporary.c_str(), "w");
+    if (out == nullptr)
+        return false;
+    LatencyStats::Instance().Dump(out, names);
+    bool ok = fclose(out) == 0;
+    return ok && rename(temporary.c_str(), options.stats.c_str()) == 0;
+}
+
+void Engine::stats_thread()
+{
+    std::unique_lock<std::mutex> l(background_mutex);
+    while (!background_stop.wait_for(l, std::chrono::seconds(options.stats_interval), [this] { return stopping; }))
+    {
+        l.unlock();
+        WriteStats();
+        l.lock();
+    }
+}
+
+OrderBook & Engine::GetOrderBook(symbol_t symbol)
+{
+    // Not shards.size(), which is still 0 while recovering.
+    return instruments.Get(symbol, options.matching == Matching::Sharded ? options.shards : 0);
+}
@@ -5,21 +5,128 @@
 #define ENGINE_HPP
 
 #include <chrono>
+#include <cstdint>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
 
-#include "atomic_map.hpp"
+#include "book_snapshot.hpp"
+#include "command_journal.hpp"
+#include "instrument_directory.hpp"
 #include "io.hpp"
+#include "latency_stats.hpp"
+#include "market_data.hpp"
+#include "matching_pool.hpp"
+#include "matching_shard.hpp"
+#include "options.hpp"
 #include "order_book.hpp"
+#include "reactor.hpp"
+#include "session.hpp"
 
 struct Engine
 {
 public:
+    explicit Engine(EngineOptions options = EngineOptions());
+    ~Engine();
+
     void accept(ClientConnection conn);
-    std::shared_ptr<OrderBook> GetOrderBook(instrument_id_t instrument);
+    OrderBook & GetOrderBook(symbol_t symbol);
+
+    /**
+     * Executes a single command on behalf of the session.
+     * 
+     * Must not be called concurrently for the same session.
+     * 
+     * @param received When the command was read, from LatencyStats::Start.
+    */
+    void HandleCommand(Session & session, const ClientCommand & input, int64_t received = 0);
+
+    /**
+     * Executes the commands of the session in order.
+    */
+    void HandleBatch(Session & session, std::span<const ClientCommand> commands, int64_t received = 0);
+
+    /**
+     * Releases a session whose connection has been fully consumed.
+    */
+    void CloseSession(Session * session);
+
+    /**
+     * Blocks until every accepted connection has been closed and all of
+     * its commands handled and written out.
+    */
+    void WaitForConnections();
+
+    /**
+     * Writes a snapshot of every book to the snapshot path.
+     * 
+     * The shards are all held still only while the books are copied, then
+     * resume while the copy is written out.
+     * 
+     * @return false if the snapshot could not be written.
+    */
+    bool TakeSnapshot();
+
+    /**
+     * Writes the latency histograms to the stats path, replacing the
+     * previous dump at once.
+     * 
+     * @return false if the dump could not be written.
+    */
+    bool WriteStats();
 
 private:
-    void connection_thread(ClientConnection conn);
-    AtomicMap<instrument_id_t, WrapperValue<std::shared_ptr<OrderBook>>> instruments;
+    /**
+     * Restores the books from the snapshot, if any, then re-executes the
+     * valid records of the journal following it.
+     * 
+     * @return the number of valid records in the journal.
+    */
+    uint64_t Recover();
+
+    void connection_thread(Session * session);
+    void snapshot_thread();
+    void stats_thread();
+    void Submit(OrderBook & book, Order & order, size_t connection, int64_t received);
+    void SubmitCancel(OrderBook & book, order_id_t order_id, const OrderRef & ref, size_t connection, int64_t received);
+    void SubmitAmend(OrderBook & book, const ClientCommand & input, const OrderRef & ref, size_t connection, int64_t received);
+
+    /**
+     * Runs the pre-trade checks of an order or amend of the session.
+     * 
+     * @return the reason the command is rejected, None to go on.
+    */
+    RejectReason CheckRisk(Session & session, OrderBook & book, Side side, price_t price, uint32_t count, bool market, bool adds);
+
+    EngineOptions options;
+    // Declared before the books, so they are gone before the accounts their orders charge.
+    std::mutex accounts_mutex;
+    std::vector<std::unique_ptr<RiskAccount>> accounts;
+    InstrumentDirectory instruments;
+
+    std::mutex sessions_mutex;
+    std::condition_variable sessions_closed;
+    size_t live_sessions = 0;
+    // Moved past the clients of recovered orders, so new connections never
+    // share a client with them. See Session::Client.
+    size_t next_session_id = 0;
+
+    std::unique_ptr<MarketDataFeed> market_data;
+    std::unique_ptr<CommandJournal> journal;
+
+    // Wakes the snapshot and stats threads up to stop.
+    std::mutex background_mutex;
+    std::condition_variable background_stop;
+    bool stopping = false;
+    std::thread snapshots;
+    std::thread stats;
+
+    // Declared last so their threads stop before the state above is destroyed.
+    std::vector<std::unique_ptr<MatchingShard>> shards;
+    std::unique_ptr<MatchingPool> pool;
+    std::unique_ptr<Reactor> reactor;
 };
 
 #endif
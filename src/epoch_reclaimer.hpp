@@ -0,0 +1,215 @@
+#ifndef EPOCH_RECLAIMER_HPP
+#define EPOCH_RECLAIMER_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * Epoch based reclamation of memory shared by lock-free structures.
+ * 
+ * A thread reading a structure without locks holds a Guard, which records
+ * the global epoch it started in. Memory unlinked from a structure is
+ * retired rather than freed, tagged with the epoch at the time. The epoch
+ * only advances once every guarded thread has seen the current one, so
+ * once it has advanced twice past a retirement no reader can still hold
+ * the memory and it is freed.
+ * 
+ * Retiring takes a mutex and is meant for rare events such as growing a
+ * table or erasing an entry; entering a guard costs one atomic exchange.
+ * 
+ * Threads register in blocks of slots chained as more threads show up, so
+ * any number of threads may hold guards.
+*/
+class EpochReclaimer
+{
+public:
+    static EpochReclaimer & Instance()
+    {
+        // Never destroyed so that exiting threads may still leave their guards.
+        static EpochReclaimer * reclaimer = new EpochReclaimer();
+        return *reclaimer;
+    }
+
+    /**
+     * Keeps everything reachable when it was entered from being freed until
+     * it is left. Guards nest.
+    */
+    class Guard
+    {
+    public:
+        Guard()
+        {
+            Participant & self = Self();
+            if (self.depth++ == 0)
+                self.slot->epoch.exchange(Instance().global.load());
+        }
+        ~Guard()
+        {
+            Participant & self = Self();
+            if (--self.depth == 0)
+                self.slot->epoch.store(IDLE, std::memory_order_release);
+        }
+
+        Guard(const Guard &) = delete;
+        Guard & operator=(const Guard &) = delete;
+    };
+
+    /**
+     * Frees pointer with deleter once no guard entered before the call is
+     * still held. The pointer must already be unreachable for new readers.
+    */
+    void Retire(void * pointer, void (*deleter)(void *))
+    {
+        std::unique_lock<std::mutex> l(retired_mutex);
+        retired.push_back(Retired{pointer, deleter, global.load()});
+        Collect(l);
+    }
+
+    /**
+     * Advances the epoch if possible and frees what can be.
+    */
+    void Collect()
+    {
+        std::unique_lock<std::mutex> l(retired_mutex);
+        Collect(l);
+    }
+
+    /**
+     * Number of retired pointers not yet freed.
+    */
+    size_t Pending()
+    {
+        std::unique_lock<std::mutex> l(retired_mutex);
+        return retired.size();
+    }
+
+    // Threads registered before another block of slots is chained.
+    static constexpr size_t BLOCK_SLOTS = 1024;
+
+private:
+    static constexpr uint64_t IDLE = UINT64_MAX;
+
+    struct alignas(64) Slot
+    {
+        // Epoch the owning thread entered its guard in, IDLE outside of one.
+        std::atomic<uint64_t> epoch{IDLE};
+        std::atomic<bool> used{false};
+    };
+
+    /**
+     * Slots of up to BLOCK_SLOTS threads. Blocks are only ever appended,
+     * and never freed.
+    */
+    struct Block
+    {
+        std::array<Slot, BLOCK_SLOTS> slots;
+        std::atomic<Block *> next{nullptr};
+    };
+
+    /**
+     * Per thread registration, giving its slot back when the thread exits.
+    */
+    struct Participant
+    {
+        Participant() : slot(&Instance().Register()) { }
+        ~Participant()
+        {
+            slot->epoch.store(IDLE);
+            slot->used.store(false, std::memory_order_release);
+        }
+
+        Slot * slot;
+        size_t depth = 0;
+    };
+
+    struct Retired
+    {
+        void * pointer;
+        void (*deleter)(void *);
+        uint64_t epoch;
+    };
+
+    static Participant & Self()
+    {
+        thread_local Participant participant;
+        return participant;
+    }
+
+    Slot & Register()
+    {
+        size_t base = 0;
+        for (Block * block = &first;; base += BLOCK_SLOTS)
+        {
+            for (size_t i = 0; i < BLOCK_SLOTS; i++)
+            {
+                Slot & slot = block->slots[i];
+                bool expected = false;
+                if (!slot.used.load(std::memory_order_relaxed) && slot.used.compare_exchange_strong(expected, true))
+                {
+                    // Scans stop at the highest slot ever handed out.
+                    size_t count = slot_count.load();
+                    while (count < base + i + 1 && !slot_count.compare_exchange_weak(count, base + i + 1))
+                        ;
+                    return slot;
+                }
+            }
+
+            // Every slot is taken, chain a block unless another thread just did.
+            Block * next = block->next.load();
+            if (next == nullptr)
+            {
+                Block * added = new Block();
+                if (block->next.compare_exchange_strong(next, added))
+                    next = added;
+                else
+                    delete added;
+            }
+            block = next;
+        }
+    }
+
+    void Collect(std::unique_lock<std::mutex> &)
+    {
+        uint64_t epoch = global.load();
+        bool current = true;
+        size_t count = slot_count.load();
+        for (Block * block = &first; block != nullptr && count > 0 && current; block = block->next.load())
+        {
+            for (size_t i = 0; i < std::min(count, BLOCK_SLOTS) && current; i++)
+            {
+                uint64_t seen = block->slots[i].epoch.load();
+                current = seen == IDLE || seen == epoch;
+            }
+            count -= std::min(count, BLOCK_SLOTS);
+        }
+        if (current)
+            global.compare_exchange_strong(epoch, epoch + 1);
+
+        uint64_t now = global.load();
+        size_t kept = 0;
+        for (Retired & item : retired)
+        {
+            if (item.epoch + 2 <= now)
+                item.deleter(item.pointer);
+            else
+                retired[kept++] = item;
+        }
+        retired.resize(kept);
+    }
+
+    EpochReclaimer() = default;
+
+    std::atomic<uint64_t> global{0};
+    Block first;
+    std::atomic<size_t> slot_count{0};
+
+    std::mutex retired_mutex;
+    std::vector<Retired> retired;
+};
+
+#endif
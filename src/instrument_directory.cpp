@@ -0,0 +1,40 @@
+#include <new>
+
+#include "instrument_directory.hpp"
+
+void InstrumentDirectory::Place(std::vector<int> shard_nodes)
+{
+    std::unique_lock<std::mutex> l(mutex);
+    this->shard_nodes = std::move(shard_nodes);
+}
+
+size_t InstrumentDirectory::Size() const
+{
+    std::unique_lock<std::mutex> l(mutex);
+    return books.size();
+}
+
+OrderBook & InstrumentDirectory::Create(symbol_t symbol, size_t shards)
+{
+    std::unique_lock<std::mutex> l(mutex);
+
+    // Another thread may have created it since the lock-free miss.
+    if (OrderBook * book = Find(symbol))
+        return *book;
+
+    size_t id = books.size();
+    size_t shard = shards > 0 ? id % shards : 0;
+    std::unique_ptr<OrderBook, Deleter> book;
+    if (shards > 0 && shard < shard_nodes.size() && shard_nodes[shard] != ThreadPlacement::NO_NODE)
+    {
+        void * memory = NodeArena::Allocate(sizeof(OrderBook), alignof(OrderBook), shard_nodes[shard]);
+        book.reset(new (memory) OrderBook(symbol, id));
+        book->node = shard_nodes[shard];
+    }
+    else
+        book.reset(new OrderBook(symbol, id));
+    book->shard = shard;
+    index.Insert(symbol, book.get());
+    books.push_back(std::move(book));
+    return *books.back();
+}
@@ -0,0 +1,93 @@
+#ifndef INSTRUMENT_DIRECTORY_HPP
+#define INSTRUMENT_DIRECTORY_HPP
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "atomic_map.hpp"
+#include "order_book.hpp"
+#include "symbol.hpp"
+
+/**
+ * Maps instrument symbols to their OrderBook.
+ * 
+ * Lookups go through an AtomicMap, so they take no lock and usually cost a
+ * single probe. Books are only ever added, under a mutex, and given a dense
+ * id in order of creation.
+ * 
+ * Once shards are placed on NUMA nodes, each book is allocated on the node
+ * of its shard rather than wherever the thread creating it runs.
+*/
+class InstrumentDirectory
+{
+public:
+    InstrumentDirectory() = default;
+
+    InstrumentDirectory(const InstrumentDirectory &) = delete;
+    InstrumentDirectory & operator=(const InstrumentDirectory &) = delete;
+
+    /**
+     * Returns the book of the symbol, creating it on first use.
+     * 
+     * @param shards Number of matching shards books are spread over,
+     *               zero when the engine is not sharded.
+    */
+    OrderBook & Get(symbol_t symbol, size_t shards)
+    {
+        OrderBook * book = Find(symbol);
+        return book != nullptr ? *book : Create(symbol, shards);
+    }
+
+    OrderBook * Find(symbol_t symbol) const
+    {
+        OrderBook * const * book = index.Find(symbol);
+        return book != nullptr ? *book : nullptr;
+    }
+
+    /**
+     * Allocates the books of shard i on shard_nodes[i] from now on.
+     * Only to be called before any book is created.
+    */
+    void Place(std::vector<int> shard_nodes);
+
+    /**
+     * Number of books created so far.
+    */
+    size_t Size() const;
+
+    /**
+     * Calls visit on every book in order of creation.
+    */
+    template <typename Visitor>
+    void ForEach(Visitor && visit) const
+    {
+        std::unique_lock<std::mutex> l(mutex);
+        for (const auto & book : books)
+            visit(*book);
+    }
+
+private:
+    OrderBook & Create(symbol_t symbol, size_t shards);
+
+    // Placed books live in a NodeArena, which keeps their memory.
+    struct Deleter
+    {
+        void operator()(OrderBook * book) const
+        {
+            if (book->node == ThreadPlacement::NO_NODE)
+                delete book;
+            else
+                book->~OrderBook();
+        }
+    };
+
+    AtomicMap<symbol_t, OrderBook *> index;
+    std::vector<int> shard_nodes;
+
+    // Owned books, only touched with mutex held.
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<OrderBook, Deleter>> books;
+};
+
+#endif
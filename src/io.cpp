@@ -1,6 +1,8 @@
 // This file contains I/O functions.
 // There should be no need to modify this file.
 
+#include <cerrno>
+#include <cstring>
 #include <fcntl.h>
 #include <unistd.h>
 
@@ -20,17 +22,36 @@ void ClientConnection::freeHandle()
     }
 }
 
-ReadResult ClientConnection::readInput(ClientCommand & read_into)
+ReadResult ClientConnection::readBatch(std::span<const ClientCommand> & commands)
 {
-    switch (read(m_handle, &read_into, sizeof(ClientCommand)))
-    {
-        case 0: //
-            return ReadResult::EndOfFile;
+    if (!m_buffer)
+        m_buffer = std::make_unique<char[]>(READ_BUFFER_SIZE);
 
-        case sizeof(ClientCommand): //
-            return ReadResult::Success;
+    // Drop the commands handed out last time and keep a partial one at the front.
+    size_t consumed = m_batched * sizeof(ClientCommand);
+    memmove(m_buffer.get(), m_buffer.get() + consumed, m_buffered - consumed);
+    m_buffered -= consumed;
+    m_batched = 0;
+    commands = {};
 
-        default: //
-            return ReadResult::Error;
-    }
+    ssize_t n;
+    do
+        n = read(m_handle, m_buffer.get() + m_buffered, READ_BUFFER_SIZE - m_buffered);
+    while (n == -1 && errno == EINTR);
+
+    if (n == 0)
+        return m_buffered == 0 ? ReadResult::EndOfFile : ReadResult::Error;
+    if (n == -1)
+        return errno == EAGAIN || errno == EWOULDBLOCK ? ReadResult::WouldBlock : ReadResult::Error;
+
+    m_buffered += n;
+    m_batched = m_buffered / sizeof(ClientCommand);
+    // ClientCommand only holds 4 byte fields, so every offset in the buffer is suitably aligned.
+    commands = std::span<const ClientCommand>(reinterpret_cast<const ClientCommand *>(m_buffer.get()), m_batched);
+    return ReadResult::Success;
+}
+
+void ClientConnection::setNonBlocking()
+{
+    fcntl(m_handle, F_SETFL, fcntl(m_handle, F_GETFL) | O_NONBLOCK);
 }
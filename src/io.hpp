@@ -3,19 +3,43 @@
 
 #pragma once
 
-#define DEBUG
 #define UNUSED(x) (void)(x)
 
 #include <cstdint>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <span>
 #include <utility>
 
+#include "output_journal.hpp"
+
+// Defined in risk_check.hpp, which needs Order and so this header.
+enum class RejectReason : uint8_t;
+
 enum CommandType
 {
     input_buy = 'B',
     input_sell = 'S',
-    input_cancel = 'C'
+    input_cancel = 'C',
+    // Gives a resting order of the connection a new price and quantity.
+    input_amend = 'A'
+};
+
+/**
+ * Variants of buy and sell orders. The byte used to be padding, so clients
+ * that zero their commands send plain limit orders.
+*/
+enum OrderType : char
+{
+    // Rests whatever it does not fill on arrival.
+    order_limit = '\0',
+    // Immediate or cancel: fills what it can on arrival, drops the rest.
+    order_ioc = 'I',
+    // Fill or kill: fills entirely on arrival or not at all.
+    order_fok = 'F',
+    // Immediate or cancel at any price, the price field is ignored.
+    order_market = 'M'
 };
 
 struct ClientCommand
@@ -25,13 +49,18 @@ struct ClientCommand
     uint32_t price;
     uint32_t count;
     char instrument[9];
+    // See OrderType, only read for buy and sell commands.
+    char order_type;
 };
+static_assert(sizeof(ClientCommand) == 28, "order_type must fit in what was padding");
 
 enum class ReadResult
 {
     Success,
     EndOfFile,
-    Error
+    Error,
+    // Only returned for non-blocking connections with nothing to read.
+    WouldBlock
 };
 
 struct ClientConnection
@@ -39,7 +68,13 @@ struct ClientConnection
     ~ClientConnection() { this->freeHandle(); }
     explicit ClientConnection(int handle) : m_handle(handle) { }
 
-    ClientConnection(ClientConnection && other) : m_handle(std::exchange(other.m_handle, -1)) { }
+    ClientConnection(ClientConnection && other)
+        : m_handle(std::exchange(other.m_handle, -1))
+        , m_buffer(std::move(other.m_buffer))
+        , m_buffered(std::exchange(other.m_buffered, 0))
+        , m_batched(std::exchange(other.m_batched, 0))
+    {
+    }
     ClientConnection & operator=(ClientConnection && other)
     {
         if (&other == this)
@@ -47,6 +82,9 @@ struct ClientConnection
 
         this->freeHandle();
         m_handle = std::exchange(other.m_handle, -1);
+        m_buffer = std::move(other.m_buffer);
+        m_buffered = std::exchange(other.m_buffered, 0);
+        m_batched = std::exchange(other.m_batched, 0);
 
         return *this;
     }
@@ -54,10 +92,30 @@ struct ClientConnection
     ClientConnection(const ClientConnection &) = delete;
     ClientConnection & operator=(const ClientConnection &) = delete;
 
-    ReadResult readInput(ClientCommand & read_into);
+    /**
+     * Reads whatever is available, up to READ_BUFFER_SIZE bytes per call,
+     * and returns the whole commands received so far.
+     * 
+     * Commands are decoded in place: the span points into the connection's
+     * buffer and stays valid until the next call. A command split across
+     * reads is kept and completed by a later call, so a successful read
+     * may yield an empty span.
+     * 
+     * Reaching end of file in the middle of a command is an Error.
+    */
+    ReadResult readBatch(std::span<const ClientCommand> & commands);
+    void setNonBlocking();
+    int handle() const { return m_handle; }
+
+    static constexpr size_t READ_BUFFER_SIZE = 16 * 1024;
 
 private:
     int m_handle;
+    // Allocated on the first read.
+    std::unique_ptr<char[]> m_buffer;
+    // Bytes in the buffer, of which the first m_batched commands were returned by the last call.
+    size_t m_buffered = 0;
+    size_t m_batched = 0;
     void freeHandle();
 };
 
@@ -135,37 +193,86 @@ struct SyncInfo
 class Output
 {
 public:
+    // Events are queued to the OutputJournal, which writes them in order
+    // in the same text format from a thread of its own.
     inline static void
     OrderAdded(uint32_t id, const char * symbol, uint32_t price, uint32_t count, bool is_sell_side, intmax_t output_timestamp)
     {
-        SyncCout() << (is_sell_side ? "S " : "B ") //
-                   << id << " " //
-                   << symbol << " " //
-                   << price << " " //
-                   << count << " " //
-                   << output_timestamp //
-                   << std::endl;
+        OutputJournal::Record record;
+        record.kind = OutputJournal::Kind::Added;
+        record.id = id;
+        record.symbol = PackSymbol(symbol);
+        record.price = price;
+        record.count = count;
+        record.flag = is_sell_side;
+        record.timestamp = output_timestamp;
+        OutputJournal::Instance().Append(record);
     }
 
     inline static void
     OrderExecuted(uint32_t resting_id, uint32_t new_id, uint32_t execution_id, uint32_t price, uint32_t count, intmax_t output_timestamp)
     {
-        SyncCout() << "E " //
-                   << resting_id << " " //
-                   << new_id << " " //
-                   << execution_id << " " //
-                   << price << " " //
-                   << count << " " //
-                   << output_timestamp //
-                   << std::endl;
+        OutputJournal::Record record;
+        record.kind = OutputJournal::Kind::Executed;
+        record.id = resting_id;
+        record.other_id = new_id;
+        record.execution_id = execution_id;
+        record.price = price;
+        record.count = count;
+        record.timestamp = output_timestamp;
+        OutputJournal::Instance().Append(record);
     }
 
     inline static void OrderDeleted(uint32_t id, bool cancel_accepted, intmax_t output_timestamp)
     {
-        SyncCout() << "X " //
-                   << id << " " //
-                   << (cancel_accepted ? "A " : "R ") //
-                   << output_timestamp //
-                   << std::endl;
+        OutputJournal::Record record;
+        record.kind = OutputJournal::Kind::Deleted;
+        record.id = id;
+        record.flag = cancel_accepted;
+        record.timestamp = output_timestamp;
+        OutputJournal::Instance().Append(record);
+    }
+
+    // Single event for an amend: the new price and the quantity left resting,
+    // 0 if the order traded away, or the requested ones if rejected.
+    inline static void OrderAmended(uint32_t id, uint32_t price, uint32_t count, bool amend_accepted, intmax_t output_timestamp)
+    {
+        OutputJournal::Record record;
+        record.kind = OutputJournal::Kind::Amended;
+        record.id = id;
+        record.price = price;
+        record.count = count;
+        record.flag = amend_accepted;
+        record.timestamp = output_timestamp;
+        OutputJournal::Instance().Append(record);
+    }
+
+    // An order or amend the pre-trade checks kept from its book.
+    inline static void OrderRejected(uint32_t id, RejectReason reason, intmax_t output_timestamp)
+    {
+        OutputJournal::Record record;
+        record.kind = OutputJournal::Kind::Rejected;
+        record.id = id;
+        record.count = uint32_t(reason);
+        record.timestamp = output_timestamp;
+        OutputJournal::Instance().Append(record);
+    }
+
+    /**
+     * Whether LevelChanged is published anywhere, so books can skip it.
+    */
+    inline static bool MarketDataEnabled() { return OutputJournal::Instance().HasMarketData(); }
+
+    inline static void LevelChanged(symbol_t symbol, bool is_sell_side, uint32_t price, uint64_t quantity, uint32_t orders)
+    {
+        OutputJournal::Record record;
+        record.kind = OutputJournal::Kind::Level;
+        record.symbol = symbol;
+        record.flag = is_sell_side;
+        record.price = price;
+        record.quantity = quantity;
+        record.count = orders;
+        record.timestamp = 0;
+        OutputJournal::Instance().Append(record);
     }
 };
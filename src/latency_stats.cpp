@@ -0,0 +1,227 @@
+#include <cinttypes>
+
+#include "latency_stats.hpp"
+
+void LatencyHistogram::Merge(const LatencyHistogram & other)
+{
+    for (size_t i = 0; i < BUCKETS; i++)
+        counts[i].store(counts[i].load(std::memory_order_relaxed) + other.counts[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    if (other.Max() > Max())
+        max.store(other.Max(), std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::Count() const
+{
+    uint64_t total = 0;
+    for (const auto & count : counts)
+        total += count.load(std::memory_order_relaxed);
+    return total;
+}
+
+uint64_t LatencyHistogram::Percentile(double fraction) const
+{
+    uint64_t total = Count();
+    if (total == 0)
+        return 0;
+    // Rank of the value, counting from 1.
+    uint64_t rank = std::max<uint64_t>(1, uint64_t(fraction * total + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++)
+    {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return std::min(UpperBound(i), Max());
+    }
+    return Max();
+}
+
+uint64_t LatencyHistogram::UpperBound(size_t bucket)
+{
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+    if (bucket == BUCKETS - 1)
+        return UINT64_MAX;
+    int magnitude = int(bucket / SUB_BUCKETS) + SUB_BITS - 1;
+    uint64_t sub = bucket % SUB_BUCKETS;
+    // The leading one, the sub-bucket bits, then every lower bit set.
+    return ((SUB_BUCKETS + sub + 1) << (magnitude - SUB_BITS)) - 1;
+}
+
+LatencyStats & LatencyStats::Instance()
+{
+    // Never destroyed: detached connection threads may still record during exit.
+    static LatencyStats * stats = new LatencyStats();
+    return *stats;
+}
+
+LatencyStats::Summary & LatencyStats::Recorder::Instrument(size_t id)
+{
+    // Only this thread adds histograms, so it can look without the lock.
+    if (id < instruments.size() && instruments[id])
+        return *instruments[id];
+
+    std::unique_lock<std::mutex> l(mutex);
+    if (id >= instruments.size())
+        instruments.resize(id + 1);
+    instruments[id] = std::make_unique<Summary>();
+    return *instruments[id];
+}
+
+LatencyStats::Summary & LatencyStats::Recorder::Connection(size_t id)
+{
+    // Only this thread adds or folds histograms, so it can look without the lock.
+    auto it = connections.find(id);
+    if (it != connections.end())
+        return *it->second;
+    if (!Instance().IsOpen(id))
+        return closed;
+
+    std::unique_lock<std::mutex> l(mutex);
+    // Sweeping once the connections kept have doubled spreads its cost
+    // over the connections added.
+    if (connections.size() >= std::max(SWEEP_MIN, 2 * swept))
+        Sweep();
+    return *connections.emplace(id, std::make_unique<Summary>()).first->second;
+}
+
+void LatencyStats::Recorder::Sweep()
+{
+    LatencyStats & stats = Instance();
+    std::unique_lock<std::mutex> l(stats.open_mutex);
+    for (auto it = connections.begin(); it != connections.end();)
+    {
+        if (stats.open.count(it->first) > 0)
+        {
+            ++it;
+            continue;
+        }
+        closed.Merge(*it->second);
+        it = connections.erase(it);
+    }
+    swept = connections.size();
+}
+
+void LatencyStats::OpenConnection(size_t id)
+{
+    std::unique_lock<std::mutex> l(open_mutex);
+    open.insert(id);
+}
+
+void LatencyStats::CloseConnection(size_t id)
+{
+    std::unique_lock<std::mutex> l(open_mutex);
+    open.erase(id);
+}
+
+bool LatencyStats::IsOpen(size_t id)
+{
+    std::unique_lock<std::mutex> l(open_mutex);
+    return open.count(id) > 0;
+}
+
+LatencyStats::Recorder & LatencyStats::Self()
+{
+    thread_local Recorder * self = nullptr;
+    if (self == nullptr)
+    {
+        std::unique_lock<std::mutex> l(recorders_mutex);
+        recorders.push_back(std::make_unique<Recorder>());
+        self = recorders.back().get();
+    }
+    return *self;
+}
+
+void LatencyStats::RecordSlow(Stage stage, uint64_t ns)
+{
+    if (context.instrument == NONE && context.connection == NONE)
+        return;
+
+    Recorder & self = Instance().Self();
+    if (context.instrument != NONE)
+        self.Instrument(context.instrument).stages[size_t(stage)].Record(ns);
+    if (context.connection != NONE)
+        self.Connection(context.connection).stages[size_t(stage)].Record(ns);
+}
+
+static void MergeInto(std::vector<std::unique_ptr<LatencyStats::Summary>> & into, const std::vector<std::unique_ptr<LatencyStats::Summary>> & from)
+{
+    if (into.size() < from.size())
+        into.resize(from.size());
+    for (size_t id = 0; id < from.size(); id++)
+    {
+        if (!from[id])
+            continue;
+        if (!into[id])
+            into[id] = std::make_unique<LatencyStats::Summary>();
+        into[id]->Merge(*from[id]);
+    }
+}
+
+void LatencyStats::Collect(std::vector<std::unique_ptr<Summary>> & instruments, std::map<size_t, std::unique_ptr<Summary>> & connections,
+    Summary & closed)
+{
+    std::unique_lock<std::mutex> l(recorders_mutex);
+    for (auto & recorder : recorders)
+    {
+        std::unique_lock<std::mutex> recorder_lock(recorder->mutex);
+        MergeInto(instruments, recorder->instruments);
+        // Connections closed since the last sweep count as closed already.
+        std::unique_lock<std::mutex> open_lock(open_mutex);
+        for (const auto & [id, summary] : recorder->connections)
+        {
+            if (open.count(id) == 0)
+            {
+                closed.Merge(*summary);
+                continue;
+            }
+            std::unique_ptr<Summary> & into = connections[id];
+            if (!into)
+                into = std::make_unique<Summary>();
+            into->Merge(*summary);
+        }
+        closed.Merge(recorder->closed);
+    }
+}
+
+static void DumpRow(FILE * out, const char * kind, const std::string & name, const LatencyStats::Summary & summary)
+{
+    for (size_t stage = 0; stage < size_t(Stage::Count); stage++)
+    {
+        const LatencyHistogram & histogram = summary.stages[stage];
+        if (histogram.Count() == 0)
+            continue;
+        fprintf(out, "%-10s %-10s %-10s %12" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %12" PRIu64 "\n", kind, name.c_str(),
+            LatencyStats::StageName(Stage(stage)), histogram.Count(), histogram.Percentile(0.5), histogram.Percentile(0.99),
+            histogram.Percentile(0.999), histogram.Max());
+    }
+}
+
+void LatencyStats::Dump(FILE * out, const std::vector<std::string> & names)
+{
+    std::vector<std::unique_ptr<Summary>> instruments;
+    std::map<size_t, std::unique_ptr<Summary>> connections;
+    Summary closed;
+    Collect(instruments, connections, closed);
+
+    // Every command is charged to its connection, so they add up to the total.
+    Summary total;
+    total.Merge(closed);
+    for (const auto & [id, connection] : connections)
+        total.Merge(*connection);
+
+    fprintf(out, "%-10s %-10s %-10s %12s %10s %10s %10s %12s\n", "# scope", "name", "stage", "count", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+    DumpRow(out, "all", "-", total);
+    for (size_t id = 0; id < instruments.size(); id++)
+        if (instruments[id])
+            DumpRow(out, "instrument", id < names.size() ? names[id] : std::to_string(id), *instruments[id]);
+    for (const auto & [id, connection] : connections)
+        DumpRow(out, "connection", std::to_string(id), *connection);
+    DumpRow(out, "connection", "closed", closed);
+}
+
+const char * LatencyStats::StageName(Stage stage)
+{
+    static const char * const NAMES[] = {"queued", "side-lock", "book-lock", "activation", "match", "output"};
+    static_assert(sizeof(NAMES) / sizeof(NAMES[0]) == size_t(Stage::Count), "every stage needs a name");
+    return NAMES[size_t(stage)];
+}
@@ -0,0 +1,270 @@
+#ifndef LATENCY_STATS_HPP
+#define LATENCY_STATS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <source_location>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "lock_profile.hpp"
+
+/**
+ * Where the time of a command goes, as recorded by LatencyStats.
+*/
+enum class Stage : uint8_t
+{
+    // From the read that received the command to the book starting on it.
+    Queued,
+    // Waiting for the buy or sell lock of an OrderBook.
+    SideLock,
+    // Waiting for the mutex of one side of a book.
+    BookLock,
+    // Blocked until a resting order that was matched or cancelled is activated.
+    Activation,
+    // Crossing the spread, waits included.
+    Match,
+    // Handing an event to the output journal.
+    Output,
+    Count
+};
+
+/**
+ * Log-linear histogram of nanosecond latencies in the manner of HDR
+ * histograms: every power of two is split into SUB_BUCKETS buckets, so a
+ * value is kept to within 1/SUB_BUCKETS of itself, about 12%.
+ * 
+ * Only one thread records into a histogram, so counts are bumped without
+ * a locked instruction; other threads may read them at any time.
+*/
+class LatencyHistogram
+{
+public:
+    static constexpr int SUB_BITS = 3;
+    static constexpr size_t SUB_BUCKETS = 1 << SUB_BITS;
+    // Values from 2^MAX_BITS ns, about 4 s, on share the last bucket.
+    static constexpr int MAX_BITS = 32;
+    static constexpr size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+    void Record(uint64_t ns)
+    {
+        std::atomic<uint64_t> & bucket = counts[Bucket(ns)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (ns > max.load(std::memory_order_relaxed))
+            max.store(ns, std::memory_order_relaxed);
+    }
+
+    /**
+     * Adds the counts of other, which may still be recording.
+    */
+    void Merge(const LatencyHistogram & other);
+
+    uint64_t Count() const;
+    uint64_t Max() const { return max.load(std::memory_order_relaxed); }
+
+    /**
+     * @return the upper bound of the bucket holding the given fraction of
+     *         the values, 0 when empty.
+    */
+    uint64_t Percentile(double fraction) const;
+
+    static size_t Bucket(uint64_t ns)
+    {
+        if (ns < SUB_BUCKETS)
+            return ns;
+        int magnitude = std::bit_width(ns) - 1;
+        if (magnitude >= MAX_BITS)
+            return BUCKETS - 1;
+        // The bits after the leading one pick the sub-bucket.
+        return (magnitude - SUB_BITS + 1) * SUB_BUCKETS + ((ns >> (magnitude - SUB_BITS)) & (SUB_BUCKETS - 1));
+    }
+
+    /**
+     * @return the largest value counted in the bucket.
+    */
+    static uint64_t UpperBound(size_t bucket);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> counts{};
+    std::atomic<uint64_t> max{0};
+};
+
+/**
+ * Latency histograms of every stage, kept per instrument and per connection.
+ * 
+ * Each thread records into histograms of its own, created the first time
+ * it charges a stage to an instrument or connection, so recording takes no
+ * lock and shares no cache line. Reading merges the histograms of all the
+ * threads. Histograms outlive their thread. Those of a connection stay
+ * apart while it is open; once it is closed, each thread folds them into
+ * a single closed bucket, so a long running engine only keeps figures for
+ * the connections still open.
+ * 
+ * Recording is off until Enable is called, and costs a branch until then.
+*/
+class LatencyStats
+{
+public:
+    static constexpr size_t NONE = SIZE_MAX;
+
+    static LatencyStats & Instance();
+
+    /**
+     * Instrument and connection the calling thread's records are charged to.
+    */
+    struct Context
+    {
+        size_t instrument = NONE;
+        size_t connection = NONE;
+    };
+
+    void Enable() { enabled.store(true, std::memory_order_relaxed); }
+    static bool Enabled() { return enabled.load(std::memory_order_relaxed); }
+
+    static int64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * Marks a connection open or closed, by session id. What is recorded
+     * for a connection that is not open goes to the closed bucket.
+    */
+    void OpenConnection(size_t id);
+    void CloseConnection(size_t id);
+
+    /**
+     * Charges what the calling thread records while it lives to an
+     * instrument, by book id, and to a connection, by session id.
+    */
+    class Scope
+    {
+    public:
+        Scope(size_t instrument, size_t connection) : saved(context) { context = Context{instrument, connection}; }
+        ~Scope() { context = saved; }
+
+        Scope(const Scope &) = delete;
+        Scope & operator=(const Scope &) = delete;
+
+    private:
+        Context saved;
+    };
+
+    /**
+     * Records the time elapsed since start in the current scope.
+    */
+    static void Record(Stage stage, int64_t start)
+    {
+        if (Enabled() && start > 0)
+            RecordSlow(stage, uint64_t(std::max<int64_t>(Now() - start, 0)));
+    }
+
+    /**
+     * Start time for Record, or 0 when recording is off.
+    */
+    static int64_t Start() { return Enabled() ? Now() : 0; }
+
+    /**
+     * Locks the mutex, recording the wait under the stage. The call site
+     * goes to a ProfiledMutex.
+    */
+    template <typename Mutex>
+    static std::unique_lock<Mutex> Lock(Mutex & mutex, Stage stage, const std::source_location & site = std::source_location::current())
+    {
+        if (!Enabled())
+            return ProfiledLock(mutex, site);
+        int64_t start = Now();
+        std::unique_lock<Mutex> l = ProfiledLock(mutex, site);
+        Record(stage, start);
+        return l;
+    }
+
+    /**
+     * Merged histograms of one instrument or connection.
+    */
+    struct Summary
+    {
+        std::array<LatencyHistogram, size_t(Stage::Count)> stages;
+
+        void Merge(const Summary & other)
+        {
+            for (size_t stage = 0; stage < stages.size(); stage++)
+                stages[stage].Merge(other.stages[stage]);
+        }
+    };
+
+    /**
+     * Merges the histograms of every thread.
+     * 
+     * @param instruments Histograms by book id, resized to fit.
+     * @param connections Histograms of the open connections by session id.
+     * @param closed Histograms of every connection closed.
+    */
+    void Collect(std::vector<std::unique_ptr<Summary>> & instruments, std::map<size_t, std::unique_ptr<Summary>> & connections,
+        Summary & closed);
+
+    /**
+     * Writes a table of count, percentiles and maximum of every stage, for
+     * all commands, then per instrument and per connection.
+     * 
+     * @param names Instrument names by book id.
+    */
+    void Dump(FILE * out, const std::vector<std::string> & names);
+
+    static const char * StageName(Stage stage);
+
+private:
+    /**
+     * Histograms recorded by one thread.
+    */
+    struct Recorder
+    {
+        // Connections kept before the first sweep.
+        static constexpr size_t SWEEP_MIN = 64;
+
+        Summary & Instrument(size_t id);
+        Summary & Connection(size_t id);
+
+        /**
+         * Folds the histograms of closed connections into closed, under the
+         * mutex.
+        */
+        void Sweep();
+
+        // Taken by the owner to add or fold histograms and by readers.
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Summary>> instruments;
+        std::unordered_map<size_t, std::unique_ptr<Summary>> connections;
+        Summary closed;
+        // Connections kept by the last sweep.
+        size_t swept = 0;
+    };
+
+    static void RecordSlow(Stage stage, uint64_t ns);
+    Recorder & Self();
+
+    static inline std::atomic<bool> enabled{false};
+    static thread_local Context context;
+
+    bool IsOpen(size_t id);
+
+    std::mutex recorders_mutex;
+    std::vector<std::unique_ptr<Recorder>> recorders;
+
+    std::mutex open_mutex;
+    std::unordered_set<size_t> open;
+};
+
+inline thread_local LatencyStats::Context LatencyStats::context;
+
+#endif
@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "lock_profile.hpp"
+
+static int64_t Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void Add(std::atomic<uint64_t> & counter, uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// Every live ProfiledMutex, for the report.
+static std::mutex registry_mutex;
+static ProfiledMutex * registry = nullptr;
+
+// Site the calling thread last named, for acquisitions that name none.
+static thread_local std::source_location last_site;
+
+static void ReportAtExit()
+{
+    const char * path = getenv("ENGINE_LOCK_PROFILE");
+    FILE * out = fopen(path != nullptr ? path : "lock_profile.txt", "w");
+    if (out == nullptr)
+        return;
+    ProfiledMutex::Report(out);
+    fclose(out);
+}
+
+ProfiledMutex::ProfiledMutex(const char * name) : name(name)
+{
+    static std::once_flag registered;
+    std::call_once(registered, []() { atexit(ReportAtExit); });
+
+    std::unique_lock<std::mutex> l(registry_mutex);
+    next = registry;
+    if (registry != nullptr)
+        registry->prev = this;
+    registry = this;
+}
+
+ProfiledMutex::~ProfiledMutex()
+{
+    std::unique_lock<std::mutex> l(registry_mutex);
+    if (prev != nullptr)
+        prev->next = next;
+    else
+        registry = next;
+    if (next != nullptr)
+        next->prev = prev;
+}
+
+void ProfiledMutex::lock(const std::source_location & site)
+{
+    last_site = site;
+    int64_t waited = 0;
+    if (!mutex.try_lock())
+    {
+        int64_t start = Now();
+        mutex.lock();
+        waited = std::max<int64_t>(Now() - start, 1);
+    }
+    Acquired(SiteFor(site), waited);
+}
+
+void ProfiledMutex::lock()
+{
+    lock(last_site);
+}
+
+bool ProfiledMutex::try_lock()
+{
+    if (!mutex.try_lock())
+        return false;
+    Acquired(SiteFor(last_site), 0);
+    return true;
+}
+
+void ProfiledMutex::unlock()
+{
+    Add(holder->hold_ns, Now() - acquired);
+    holder = nullptr;
+    mutex.unlock();
+}
+
+ProfiledMutex::Site & ProfiledMutex::SiteFor(const std::source_location & site)
+{
+    for (size_t i = 0; i < MAX_SITES - 1; i++)
+    {
+        const char * function = sites[i].function.load(std::memory_order_relaxed);
+        if (function == nullptr)
+        {
+            sites[i].file.store(site.file_name(), std::memory_order_relaxed);
+            sites[i].line.store(site.line(), std::memory_order_relaxed);
+            sites[i].function.store(site.function_name(), std::memory_order_release);
+            return sites[i];
+        }
+        if (function == site.function_name() && sites[i].line.load(std::memory_order_relaxed) == site.line())
+            return sites[i];
+    }
+    Site & other = sites[MAX_SITES - 1];
+    if (other.function.load(std::memory_order_relaxed) == nullptr)
+        other.function.store("(other sites)", std::memory_order_release);
+    return other;
+}
+
+void ProfiledMutex::Acquired(Site & site, int64_t waited)
+{
+    Add(site.acquisitions, 1);
+    if (waited > 0)
+    {
+        Add(site.contended, 1);
+        Add(site.wait_ns, waited);
+        if (uint64_t(waited) > site.max_wait_ns.load(std::memory_order_relaxed))
+            site.max_wait_ns.store(waited, std::memory_order_relaxed);
+    }
+    holder = &site;
+    acquired = Now();
+}
+
+namespace
+{
+struct Totals
+{
+    uint64_t acquisitions = 0;
+    uint64_t contended = 0;
+    uint64_t wait_ns = 0;
+    uint64_t max_wait_ns = 0;
+    uint64_t hold_ns = 0;
+
+    void Add(const ProfiledMutex::Site & site)
+    {
+        acquisitions += site.acquisitions.load(std::memory_order_relaxed);
+        contended += site.contended.load(std::memory_order_relaxed);
+        wait_ns += site.wait_ns.load(std::memory_order_relaxed);
+        max_wait_ns = std::max(max_wait_ns, site.max_wait_ns.load(std::memory_order_relaxed));
+        hold_ns += site.hold_ns.load(std::memory_order_relaxed);
+    }
+
+    void Add(const Totals & other)
+    {
+        acquisitions += other.acquisitions;
+        contended += other.contended;
+        wait_ns += other.wait_ns;
+        max_wait_ns = std::max(max_wait_ns, other.max_wait_ns);
+        hold_ns += other.hold_ns;
+    }
+};
+
+struct LockEntry
+{
+    std::string name;
+    const ProfiledMutex * lock;
+    Totals totals;
+};
+}
+
+static void PrintHeader(FILE * out, const char * title)
+{
+    fprintf(out, "\n%-28s %12s %10s %12s %12s %12s %10s\n", title, "acquired", "contended", "wait ms", "max wait us", "hold ms",
+        "avg hold");
+}
+
+static void PrintRow(FILE * out, const std::string & label, const Totals & totals)
+{
+    fprintf(out, "%-28s %12" PRIu64 " %9.2f%% %12.3f %12.1f %12.3f %8" PRIu64 " ns\n", label.c_str(), totals.acquisitions,
+        totals.acquisitions ? 100.0 * totals.contended / totals.acquisitions : 0.0, totals.wait_ns / 1e6,
+        totals.max_wait_ns / 1e3, totals.hold_ns / 1e6, totals.acquisitions ? totals.hold_ns / totals.acquisitions : uint64_t(0));
+}
+
+static bool ByWait(const std::pair<std::string, Totals> & a, const std::pair<std::string, Totals> & b)
+{
+    return a.second.wait_ns > b.second.wait_ns;
+}
+
+void ProfiledMutex::Report(FILE * out)
+{
+    static constexpr size_t TOP = 20;
+
+    std::unique_lock<std::mutex> l(registry_mutex);
+    std::vector<LockEntry> locks;
+    std::map<std::string, Totals> by_name;
+    std::map<std::string, Totals> by_instrument;
+    for (const ProfiledMutex * lock = registry; lock != nullptr; lock = lock->next)
+    {
+        LockEntry entry{lock->Name(), lock, {}};
+        for (const Site & site : lock->Sites())
+            entry.totals.Add(site);
+        if (entry.totals.acquisitions == 0)
+            continue;
+        std::string instrument = SymbolText(lock->Instrument()).c_str();
+        if (!instrument.empty())
+            entry.name = instrument + " " + entry.name;
+        by_name[lock->Name()].Add(entry.totals);
+        by_instrument[instrument.empty() ? "-" : instrument].Add(entry.totals);
+        locks.push_back(std::move(entry));
+    }
+
+    fprintf(out, "Lock profile of %zu locks, sorted by time spent waiting\n", locks.size());
+
+    // Which lock in the chain queues threads up.
+    std::vector<std::pair<std::string, Totals>> rows(by_name.begin(), by_name.end());
+    std::sort(rows.begin(), rows.end(), ByWait);
+    PrintHeader(out, "lock");
+    for (const auto & [name, totals] : rows)
+        PrintRow(out, name, totals);
+
+    // Which instruments they queue up on.
+    rows.assign(by_instrument.begin(), by_instrument.end());
+    std::sort(rows.begin(), rows.end(), ByWait);
+    PrintHeader(out, "instrument");
+    for (size_t i = 0; i < std::min(TOP, rows.size()); i++)
+        PrintRow(out, rows[i].first, rows[i].second);
+
+    // And from where.
+    std::sort(locks.begin(), locks.end(), [](const LockEntry & a, const LockEntry & b) { return a.totals.wait_ns > b.totals.wait_ns; });
+    PrintHeader(out, "lock and call sites");
+    for (size_t i = 0; i < std::min(TOP, locks.size()); i++)
+    {
+        PrintRow(out, locks[i].name, locks[i].totals);
+        std::vector<const Site *> sites;
+        for (const Site & site : locks[i].lock->Sites())
+            if (site.function.load(std::memory_order_acquire) != nullptr && site.acquisitions.load(std::memory_order_relaxed) > 0)
+                sites.push_back(&site);
+        std::sort(sites.begin(), sites.end(), [](const Site * a, const Site * b) { return a->wait_ns.load() > b->wait_ns.load(); });
+        for (const Site * site_ptr : sites)
+        {
+            const Site & site = *site_ptr;
+            const char * function = site.function.load(std::memory_order_acquire);
+            Totals totals;
+            totals.Add(site);
+            const char * file = site.file.load(std::memory_order_relaxed);
+            if (file == nullptr || *function == '\0')
+            {
+                // The overflow slot, or a thread relocking before naming any site.
+                PrintRow(out, *function ? std::string("  ") + function : "  (unattributed)", totals);
+                continue;
+            }
+            PrintRow(out, "  " + std::string(file) + ":" + std::to_string(site.line.load(std::memory_order_relaxed)), totals);
+            fprintf(out, "    %s\n", function);
+        }
+    }
+}
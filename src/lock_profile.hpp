@@ -0,0 +1,139 @@
+#ifndef LOCK_PROFILE_HPP
+#define LOCK_PROFILE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <source_location>
+
+#include "symbol.hpp"
+
+/**
+ * Mutex recording how it is used, for finding lock convoys.
+ * 
+ * Every acquisition is counted, with the time spent waiting when the lock
+ * was contended and the time it was then held, per call site. Statistics
+ * are only written while the lock is held, so they need no synchronisation
+ * of their own; the counters are atomics just so the report may read them
+ * at any time.
+ * 
+ * The call site is passed to lock by ProfiledLock, or LatencyStats::Lock.
+ * Acquisitions that do not name one, like the relock after waiting for an
+ * order to be activated, are charged to the site the thread last locked
+ * from.
+ * 
+ * The books use it in place of std::mutex when built with
+ * `make LOCK_PROFILE=1`, see BookMutex.
+*/
+class ProfiledMutex
+{
+public:
+    explicit ProfiledMutex(const char * name = "unnamed");
+    ~ProfiledMutex();
+
+    ProfiledMutex(const ProfiledMutex &) = delete;
+    ProfiledMutex & operator=(const ProfiledMutex &) = delete;
+
+    void lock(const std::source_location & site);
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    /**
+     * Names the lock and the instrument it belongs to in the report.
+    */
+    void Label(const char * name, symbol_t instrument)
+    {
+        this->name = name;
+        this->instrument = instrument;
+    }
+
+    static constexpr size_t MAX_SITES = 8;
+
+    struct Site
+    {
+        // Null for a free slot. Both point to static strings.
+        std::atomic<const char *> function{nullptr};
+        std::atomic<const char *> file{nullptr};
+        std::atomic<uint32_t> line{0};
+        std::atomic<uint64_t> acquisitions{0};
+        std::atomic<uint64_t> contended{0};
+        std::atomic<uint64_t> wait_ns{0};
+        std::atomic<uint64_t> max_wait_ns{0};
+        std::atomic<uint64_t> hold_ns{0};
+    };
+
+    const char * Name() const { return name; }
+    symbol_t Instrument() const { return instrument; }
+    // The last site gathers every site past the first MAX_SITES - 1.
+    const std::array<Site, MAX_SITES> & Sites() const { return sites; }
+
+    /**
+     * Writes the profile of every live lock: totals per lock in the chain,
+     * per instrument, then the locks with the most waiting and the call
+     * sites that waited on them.
+    */
+    static void Report(FILE * out);
+
+private:
+    Site & SiteFor(const std::source_location & site);
+    void Acquired(Site & site, int64_t waited);
+
+    std::mutex mutex;
+    const char * name;
+    symbol_t instrument = 0;
+
+    // Owned by the holder of the lock.
+    Site * holder = nullptr;
+    int64_t acquired = 0;
+    std::array<Site, MAX_SITES> sites;
+
+    // Links of the list of live locks.
+    ProfiledMutex * prev = nullptr;
+    ProfiledMutex * next = nullptr;
+};
+
+/**
+ * Locks the mutex, telling a ProfiledMutex where from.
+*/
+template <typename Mutex>
+inline std::unique_lock<Mutex> ProfiledLock(Mutex & mutex, const std::source_location & site = std::source_location::current())
+{
+    if constexpr (requires { mutex.lock(site); })
+    {
+        mutex.lock(site);
+        return std::unique_lock<Mutex>(mutex, std::adopt_lock);
+    }
+    else
+    {
+        (void)site;
+        return std::unique_lock<Mutex>(mutex);
+    }
+}
+
+/**
+ * Names a lock in the profile; nothing for a plain mutex.
+*/
+template <typename Mutex>
+inline void LabelLock(Mutex & mutex, const char * name, symbol_t instrument)
+{
+    if constexpr (requires { mutex.Label(name, instrument); })
+        mutex.Label(name, instrument);
+    else
+    {
+        (void)mutex;
+        (void)name;
+        (void)instrument;
+    }
+}
+
+// Building with -DLOCK_PROFILE profiles the locks of every OrderBook and Book.
+#ifdef LOCK_PROFILE
+typedef ProfiledMutex BookMutex;
+#else
+typedef std::mutex BookMutex;
+#endif
+
+#endif
@@ -12,6 +12,7 @@
 
 #include "io.hpp"
 #include "engine.hpp"
+#include "options.hpp"
 
 static int listenfd = -1;
 static char* socketpath = NULL;
@@ -36,7 +37,15 @@ int main(int argc, char* argv[])
 {
 	if(argc < 2)
 	{
-		fprintf(stderr, "Usage: %s <socket path>\n", argv[0]);
+		fprintf(stderr, "Usage: %s <socket path> [options]\n", argv[0]);
+		PrintOptionsUsage();
+		return 1;
+	}
+
+	EngineOptions options;
+	if(!ParseOptions(argc - 2, argv + 2, options))
+	{
+		PrintOptionsUsage();
 		return 1;
 	}
 
@@ -69,7 +78,7 @@ int main(int argc, char* argv[])
 		return 1;
 	}
 
-	auto engine = new Engine();
+	auto engine = new Engine(options);
 	while(true)
 	{
 		int connfd = accept(listenfd, NULL, NULL);
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "market_data.hpp"
+
+MarketDataFeed::MarketDataFeed(const std::string & path, size_t capacity, size_t snapshot_interval)
+    : snapshot_interval(snapshot_interval)
+{
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+        throw std::runtime_error("Failed to create market data file " + path);
+
+    mapped = sizeof(L2RingHeader) + capacity * sizeof(L2Message);
+    void * memory = MAP_FAILED;
+    if (ftruncate(fd, mapped) == 0)
+        memory = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+        throw std::runtime_error("Failed to map market data file " + path);
+
+    header = new (memory) L2RingHeader{L2RingHeader::MAGIC, capacity, {0}};
+    ring = reinterpret_cast<L2Message *>(static_cast<char *>(memory) + sizeof(L2RingHeader));
+
+    // Readers attaching right away can sync from the empty book.
+    Snapshot();
+}
+
+MarketDataFeed::~MarketDataFeed()
+{
+    munmap(header, mapped);
+}
+
+void MarketDataFeed::LevelChanged(symbol_t symbol, bool is_sell_side, uint32_t price, uint64_t quantity, uint32_t orders)
+{
+    std::map<uint32_t, Level> & side = books[symbol].sides[is_sell_side];
+    if (orders == 0)
+        levels -= side.erase(price);
+    else
+    {
+        auto [it, added] = side.try_emplace(price);
+        it->second = Level{quantity, orders};
+        levels += added;
+    }
+
+    Write(L2Message{++sequence, symbol, quantity, price, orders, L2Message::Update, is_sell_side});
+
+    if (++since_snapshot >= std::max(snapshot_interval, levels))
+        Snapshot();
+}
+
+void MarketDataFeed::Snapshot()
+{
+    since_snapshot = 0;
+    if (levels + 2 > header->capacity / 2)
+    {
+        if (!warned)
+            fprintf(stderr, "Skipping market data snapshots of %zu levels, too large for a ring of %" PRIu64 " messages\n", levels,
+                header->capacity);
+        warned = true;
+        return;
+    }
+
+    Write(L2Message{sequence, 0, 0, 0, 0, L2Message::SnapshotStart, 0});
+    for (const auto & [symbol, book] : books)
+        for (uint8_t side = 0; side < 2; side++)
+            for (const auto & [price, level] : book.sides[side])
+                Write(L2Message{sequence, symbol, level.quantity, price, level.orders, L2Message::SnapshotLevel, side});
+    Write(L2Message{sequence, 0, 0, 0, 0, L2Message::SnapshotEnd, 0});
+}
+
+void MarketDataFeed::Write(const L2Message & message)
+{
+    uint64_t index = header->written.load(std::memory_order_relaxed);
+    ring[index % header->capacity] = message;
+    header->written.store(index + 1, std::memory_order_release);
+}
+
+MarketDataReader::MarketDataReader(const std::string & path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw std::runtime_error("Failed to open market data file " + path);
+
+    L2RingHeader probe;
+    if (pread(fd, &probe, sizeof(probe), 0) != sizeof(probe) || probe.magic != L2RingHeader::MAGIC)
+    {
+        close(fd);
+        throw std::runtime_error("Not a market data file " + path);
+    }
+
+    mapped = sizeof(L2RingHeader) + probe.capacity * sizeof(L2Message);
+    void * memory = mmap(nullptr, mapped, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+        throw std::runtime_error("Failed to map market data file " + path);
+
+    header = static_cast<const L2RingHeader *>(memory);
+    ring = reinterpret_cast<const L2Message *>(static_cast<const char *>(memory) + sizeof(L2RingHeader));
+}
+
+MarketDataReader::~MarketDataReader()
+{
+    munmap(const_cast<L2RingHeader *>(header), mapped);
+}
+
+bool MarketDataReader::Next(L2Message & message)
+{
+    uint64_t written = header->written.load(std::memory_order_acquire);
+    if (next == written)
+        return false;
+    // The slot of message next is rewritten while the writer works on message next + capacity.
+    if (written - next >= header->capacity)
+    {
+        SkipAhead(written);
+        return false;
+    }
+
+    memcpy(&message, &ring[next % header->capacity], sizeof(message));
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // The writer may have lapped us while copying.
+    written = header->written.load(std::memory_order_relaxed);
+    if (written - next >= header->capacity)
+    {
+        SkipAhead(written);
+        return false;
+    }
+    next++;
+    return true;
+}
+
+void MarketDataReader::SkipAhead(uint64_t written)
+{
+    // Halfway back leaves room before being lapped again and likely a recent snapshot.
+    next = written - header->capacity / 2;
+    overrun = true;
+}
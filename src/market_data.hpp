@@ -0,0 +1,142 @@
+#ifndef MARKET_DATA_HPP
+#define MARKET_DATA_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include "symbol.hpp"
+
+/**
+ * One message of the binary L2 feed.
+ * 
+ * Updates carry the new totals of a price level, a level with no orders
+ * has been removed. Each update has the next sequence number. A snapshot
+ * is a SnapshotStart, one SnapshotLevel per level of every book and a
+ * SnapshotEnd, all carrying the sequence of the last update they include.
+*/
+struct L2Message
+{
+    enum Type : uint8_t
+    {
+        Update,
+        SnapshotStart,
+        SnapshotLevel,
+        SnapshotEnd
+    };
+
+    uint64_t sequence;
+    symbol_t symbol;
+    uint64_t quantity;
+    uint32_t price;
+    uint32_t orders;
+    Type type;
+    // 0 for bids, 1 for asks.
+    uint8_t side;
+};
+
+/**
+ * Layout of the shared memory ring at the start of the feed file,
+ * followed by `capacity` messages.
+*/
+struct L2RingHeader
+{
+    static constexpr uint64_t MAGIC = 0x4c32464545443031; // "L2FEED01"
+
+    uint64_t magic;
+    uint64_t capacity;
+    // Messages written so far; message i lives in slot i % capacity.
+    alignas(64) std::atomic<uint64_t> written;
+};
+
+/**
+ * Publishes the L2 feed into a memory mapped ring file.
+ * 
+ * Fed by the OutputJournal writer thread with the level changes reported
+ * by the books, in the order they happened. Keeps a shadow copy of every
+ * book to write a full snapshot every `snapshot_interval` updates, so a
+ * reader joining late only waits for the next snapshot to sync. Only ever
+ * called from one thread.
+ * 
+ * Snapshots are spaced by at least as many updates as they have levels, so
+ * writing them never costs more than the updates themselves. A snapshot
+ * that would fill more than half the ring is skipped, since a reader could
+ * not read it before being lapped.
+*/
+class MarketDataFeed
+{
+public:
+    MarketDataFeed(const std::string & path, size_t capacity, size_t snapshot_interval);
+    ~MarketDataFeed();
+
+    MarketDataFeed(const MarketDataFeed &) = delete;
+    MarketDataFeed & operator=(const MarketDataFeed &) = delete;
+
+    void LevelChanged(symbol_t symbol, bool is_sell_side, uint32_t price, uint64_t quantity, uint32_t orders);
+
+private:
+    struct Level
+    {
+        uint64_t quantity;
+        uint32_t orders;
+    };
+
+    struct ShadowBook
+    {
+        std::map<uint32_t, Level> sides[2];
+    };
+
+    void Snapshot();
+    void Write(const L2Message & message);
+
+    L2RingHeader * header;
+    L2Message * ring;
+    size_t mapped;
+
+    uint64_t sequence = 0;
+    size_t snapshot_interval;
+    size_t since_snapshot = 0;
+    // Levels in the shadow books, the length of a snapshot without its ends.
+    size_t levels = 0;
+    bool warned = false;
+    std::unordered_map<symbol_t, ShadowBook> books;
+};
+
+/**
+ * Follows the feed written by a MarketDataFeed, for consumers and tests.
+*/
+class MarketDataReader
+{
+public:
+    explicit MarketDataReader(const std::string & path);
+    ~MarketDataReader();
+
+    MarketDataReader(const MarketDataReader &) = delete;
+    MarketDataReader & operator=(const MarketDataReader &) = delete;
+
+    /**
+     * Reads the next message.
+     * 
+     * @return false when there is none yet, or when the reader fell a
+     *         whole ring behind; then it skips to the middle of the ring
+     *         and Overrun() is set until the caller clears it by resyncing
+     *         from the next snapshot.
+    */
+    bool Next(L2Message & message);
+
+    bool Overrun() const { return overrun; }
+    void ClearOverrun() { overrun = false; }
+
+private:
+    void SkipAhead(uint64_t written);
+
+    const L2RingHeader * header;
+    const L2Message * ring;
+    size_t mapped;
+    uint64_t next = 0;
+    bool overrun = false;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <cstring>
+
+#include "matching_pool.hpp"
+#include "engine.hpp"
+#include "latency_stats.hpp"
+
+MatchingPool::MatchingPool(Engine & engine, size_t threads, size_t queue_capacity) : engine(engine)
+{
+    for (size_t i = 0; i < threads; i++)
+        queues.push_back(std::make_unique<BoundedQueue<Task>>(queue_capacity));
+    for (size_t i = 0; i < threads; i++)
+        workers.emplace_back(&MatchingPool::worker_thread, this, i);
+}
+
+MatchingPool::~MatchingPool()
+{
+    // A task without a session tells the worker to exit.
+    for (auto & queue : queues)
+        queue->Push(Task{nullptr, nullptr, true});
+    for (auto & worker : workers)
+        worker.join();
+}
+
+void MatchingPool::Submit(Session * session, std::span<const ClientCommand> commands)
+{
+    BoundedQueue<Task> & queue = QueueFor(session);
+    int64_t received = LatencyStats::Start();
+    for (size_t offset = 0; offset < commands.size(); offset += BATCH)
+    {
+        Batch * batch = new (BatchPool::Allocate()) Batch;
+        batch->received = received;
+        batch->count = std::min(BATCH, commands.size() - offset);
+        memcpy(batch->commands, commands.data() + offset, batch->count * sizeof(ClientCommand));
+        queue.Push(Task{session, batch, false});
+    }
+}
+
+void MatchingPool::Close(Session * session)
+{
+    QueueFor(session).Push(Task{session, nullptr, true});
+}
+
+void MatchingPool::worker_thread(size_t index)
+{
+    OutputJournal::Instance().Attach();
+    BoundedQueue<Task> & queue = *queues[index];
+    while (true)
+    {
+        Task task = queue.Pop();
+        if (task.session == nullptr)
+            return;
+
+        if (task.close)
+        {
+            engine.CloseSession(task.session);
+            continue;
+        }
+
+        engine.HandleBatch(
+            *task.session, std::span<const ClientCommand>(task.batch->commands, task.batch->count), task.batch->received);
+        BatchPool::Free(task.batch);
+    }
+}
+
+BoundedQueue<MatchingPool::Task> & MatchingPool::QueueFor(const Session * session)
+{
+    return *queues[session->id % queues.size()];
+}
@@ -0,0 +1,68 @@
+#ifndef MATCHING_POOL_HPP
+#define MATCHING_POOL_HPP
+
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.hpp"
+#include "io.hpp"
+#include "session.hpp"
+#include "slab_pool.hpp"
+
+struct Engine;
+
+/**
+ * Fixed set of threads executing client commands against the engine.
+ * 
+ * A session is pinned to one worker so its commands are handled in the
+ * order they were received, while different sessions run in parallel.
+*/
+class MatchingPool
+{
+public:
+    MatchingPool(Engine & engine, size_t threads, size_t queue_capacity);
+    ~MatchingPool();
+
+    /**
+     * Queues the commands, copied in batches of up to BATCH commands.
+    */
+    void Submit(Session * session, std::span<const ClientCommand> commands);
+
+    /**
+     * Hands the session back to the engine once every command submitted
+     * before it has been handled.
+    */
+    void Close(Session * session);
+
+    static constexpr size_t BATCH = 64;
+
+private:
+    struct Batch
+    {
+        // When the commands were read, for LatencyStats.
+        int64_t received;
+        size_t count;
+        ClientCommand commands[BATCH];
+    };
+
+    // Batches are recycled through a slab pool, freed by the worker.
+    typedef SlabPool<sizeof(Batch), alignof(Batch)> BatchPool;
+
+    struct Task
+    {
+        Session * session;
+        Batch * batch;
+        bool close;
+    };
+
+    void worker_thread(size_t index);
+    BoundedQueue<Task> & QueueFor(const Session * session);
+
+    Engine & engine;
+    std::vector<std::unique_ptr<BoundedQueue<Task>>> queues;
+    std::vector<std::thread> workers;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include <cstdio>
+
+#include "matching_shard.hpp"
+#include "output_journal.hpp"
+
+// Empty polls before the shard thread parks itself.
+static constexpr int SPIN_LIMIT = 256;
+
+MatchingShard::MatchingShard(size_t queue_capacity, CommandJournal * journal, ThreadPlacement placement)
+    : journal(journal), queue(queue_capacity), sleeping(false)
+{
+    thread = std::thread(&MatchingShard::shard_thread, this, std::move(placement));
+}
+
+MatchingShard::~MatchingShard()
+{
+    Push(Command{CommandKind::Stop, nullptr, nullptr, 0, Side::BUY, 0, 0, nullptr, nullptr, LatencyStats::NONE, 0});
+    thread.join();
+}
+
+void MatchingShard::Handle(OrderBook * book, Order * order, size_t connection, int64_t received)
+{
+    Push(Command{CommandKind::Handle, book, order, 0, Side::BUY, 0, 0, nullptr, nullptr, connection, received});
+}
+
+void MatchingShard::Cancel(OrderBook * book, order_id_t order_id, Side side, size_t connection, int64_t received)
+{
+    Push(Command{CommandKind::Cancel, book, nullptr, order_id, side, 0, 0, nullptr, nullptr, connection, received});
+}
+
+void MatchingShard::Amend(
+    OrderBook * book, order_id_t order_id, Side side, price_t price, unsigned int count, size_t connection, int64_t received)
+{
+    Push(Command{CommandKind::Amend, book, nullptr, order_id, side, price, count, nullptr, nullptr, connection, received});
+}
+
+void MatchingShard::Drain()
+{
+    std::promise<void> reached;
+    Push(Command{CommandKind::Barrier, nullptr, nullptr, 0, Side::BUY, 0, 0, &reached, nullptr, LatencyStats::NONE, 0});
+    reached.get_future().wait();
+}
+
+void MatchingShard::Pause(Quiesce & quiesce)
+{
+    Push(Command{CommandKind::Pause, nullptr, nullptr, 0, Side::BUY, 0, 0, nullptr, &quiesce, LatencyStats::NONE, 0});
+}
+
+void MatchingShard::Push(Command command)
+{
+    while (!queue.TryPush(command))
+        std::this_thread::yield();
+
+    // Pairs with the fence in shard_thread so either the shard sees the
+    // command before parking or we see it parked.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed))
+    {
+        sleeping.store(false, std::memory_order_relaxed);
+        sleeping.notify_one();
+    }
+}
+
+void MatchingShard::shard_thread(ThreadPlacement placement)
+{
+    if (!placement.Apply())
+        fprintf(stderr, "Failed to pin shard thread to the CPUs of node %d\n", placement.node);
+    OutputJournal::Instance().Attach();
+
+    Command command;
+    int idle = 0;
+    while (true)
+    {
+        if (!queue.TryPop(command))
+        {
+            if (++idle < SPIN_LIMIT)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!queue.TryPop(command))
+            {
+                sleeping.wait(true);
+                sleeping.store(false, std::memory_order_relaxed);
+                continue;
+            }
+            sleeping.store(false, std::memory_order_relaxed);
+        }
+        idle = 0;
+
+        switch (command.kind)
+        {
+            case CommandKind::Handle: {
+                LatencyStats::Scope scope(command.book->id, command.connection);
+                LatencyStats::Record(Stage::Queued, command.received);
+                if (journal != nullptr)
+                    OutputJournal::HoldUntilDurable(journal->AppendOrder(command.book->symbol, *command.order));
+                command.book->HandleExclusive(*command.order);
+                break;
+            }
+            case CommandKind::Cancel: {
+                LatencyStats::Scope scope(command.book->id, command.connection);
+                LatencyStats::Record(Stage::Queued, command.received);
+                if (journal != nullptr)
+                    OutputJournal::HoldUntilDurable(journal->AppendCancel(command.book->symbol, command.order_id, command.side));
+                command.book->CancelExclusive(command.order_id, command.side);
+                break;
+            }
+            case CommandKind::Amend: {
+                LatencyStats::Scope scope(command.book->id, command.connection);
+                LatencyStats::Record(Stage::Queued, command.received);
+                if (journal != nullptr)
+                    OutputJournal::HoldUntilDurable(
+                        journal->AppendAmend(command.book->symbol, command.order_id, command.side, command.price, command.count));
+                command.book->AmendExclusive(command.order_id, command.side, command.price, command.count);
+                break;
+            }
+            case CommandKind::Barrier:
+                command.reached->set_value();
+                break;
+            case CommandKind::Pause: {
+                // The pausing thread may release quiesce as soon as all shards stopped.
+                std::shared_future<void> resumed = command.quiesce->resumed;
+                command.quiesce->paused.count_down();
+                resumed.wait();
+                break;
+            }
+            case CommandKind::Stop:
+                return;
+        }
+    }
+}
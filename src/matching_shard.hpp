@@ -0,0 +1,114 @@
+#ifndef MATCHING_SHARD_HPP
+#define MATCHING_SHARD_HPP
+
+#include <atomic>
+#include <future>
+#include <latch>
+#include <thread>
+
+#include "command_journal.hpp"
+#include "latency_stats.hpp"
+#include "mpsc_queue.hpp"
+#include "numa_placement.hpp"
+#include "order.hpp"
+#include "order_book.hpp"
+
+/**
+ * Thread owning a subset of the instruments.
+ * 
+ * Any thread may submit commands for an instrument of the shard through a
+ * lock-free queue; the shard thread is the only one touching its books, so
+ * matching runs through the exclusive OrderBook paths without locks.
+ * 
+ * With a journal, each command is appended to it right before it executes,
+ * in the order the shard executes them, and its events are held by the
+ * output journal until it is durable.
+ * 
+ * A placed shard thread pins itself before taking any command, so what it
+ * allocates while matching is first touched on its node.
+*/
+class MatchingShard
+{
+public:
+    /**
+     * Holds every shard it is submitted to still at the same time.
+    */
+    struct Quiesce
+    {
+        explicit Quiesce(size_t shards) : paused(shards) { }
+
+        // Counted down by each shard as it stops.
+        std::latch paused;
+        std::promise<void> resume;
+        std::shared_future<void> resumed = resume.get_future().share();
+    };
+
+    MatchingShard(size_t queue_capacity, CommandJournal * journal = nullptr, ThreadPlacement placement = {});
+    ~MatchingShard();
+
+    /**
+     * Queues a command of the connection, read at the time received, to
+     * which the shard charges its latencies.
+    */
+    void Handle(OrderBook * book, Order * order, size_t connection = LatencyStats::NONE, int64_t received = 0);
+    void Cancel(OrderBook * book, order_id_t order_id, Side side, size_t connection = LatencyStats::NONE, int64_t received = 0);
+    void Amend(
+        OrderBook * book,
+        order_id_t order_id,
+        Side side,
+        price_t price,
+        unsigned int count,
+        size_t connection = LatencyStats::NONE,
+        int64_t received = 0);
+
+    /**
+     * Blocks until every command submitted before the call has executed.
+    */
+    void Drain();
+
+    /**
+     * Makes the shard stop once every command submitted before the call has
+     * executed, until quiesce.resume is set.
+    */
+    void Pause(Quiesce & quiesce);
+
+private:
+    enum class CommandKind
+    {
+        Handle,
+        Cancel,
+        Amend,
+        Barrier,
+        Pause,
+        Stop
+    };
+
+    struct Command
+    {
+        CommandKind kind;
+        OrderBook * book;
+        Order * order;
+        // Identify the order to cancel or amend.
+        order_id_t order_id;
+        Side side;
+        // New price and quantity of an amended order.
+        price_t price;
+        unsigned int count;
+        std::promise<void> * reached;
+        Quiesce * quiesce;
+        // Session and read time of the command, for LatencyStats.
+        size_t connection;
+        int64_t received;
+    };
+
+    void Push(Command command);
+    void shard_thread(ThreadPlacement placement);
+
+    CommandJournal * journal;
+    MpscQueue<Command> queue;
+    // Set while the shard thread is parked waiting for commands.
+    std::atomic<bool> sleeping;
+    std::thread thread;
+};
+
+#endif
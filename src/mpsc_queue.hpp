@@ -0,0 +1,102 @@
+#ifndef MPSC_QUEUE_HPP
+#define MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * Bounded lock-free queue for many producers and a single consumer.
+ * 
+ * Every slot carries a sequence number telling whether it is free for the
+ * producer claiming position `pos` (sequence == pos) or holds a value ready
+ * for the consumer (sequence == pos + 1). Producers only contend on the
+ * tail counter; the consumer never writes shared state besides the slots.
+*/
+template <typename T>
+class MpscQueue
+{
+public:
+    /**
+     * @param capacity Rounded up to the next power of two.
+    */
+    explicit MpscQueue(size_t capacity) : tail(0), head(0)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        mask = size - 1;
+        slots = std::make_unique<Slot[]>(size);
+        for (size_t i = 0; i < size; i++)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /**
+     * Moves the value into the queue unless it is full.
+    */
+    bool TryPush(T & value)
+    {
+        size_t position;
+        return TryPush(value, position);
+    }
+
+    /**
+     * Also returns the position of the value, counting every value pushed
+     * before it, which is the order the consumer pops them in.
+    */
+    bool TryPush(T & value, size_t & position)
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Slot * slot;
+        while (true)
+        {
+            slot = &slots[pos & mask];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = tail.load(std::memory_order_relaxed);
+        }
+
+        slot->value = std::move(value);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        position = pos;
+        return true;
+    }
+
+    /**
+     * Only called by the consumer thread.
+    */
+    bool TryPop(T & out)
+    {
+        Slot & slot = slots[head & mask];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1)
+            return false;
+
+        out = std::move(slot.value);
+        slot.sequence.store(head + mask + 1, std::memory_order_release);
+        head++;
+        return true;
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    alignas(64) std::atomic<size_t> tail;
+    alignas(64) size_t head;
+    size_t mask;
+    std::unique_ptr<Slot[]> slots;
+};
+
+#endif
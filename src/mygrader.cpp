@@ -4,6 +4,7 @@
 #include <fcntl.h>
 #include <math.h>
 #include <unistd.h>
+#include <sys/wait.h>
 
 char errMsg[] = "./mygrader [input_file_1]...\n\t example: ./mygrader ./input/1.in";
 
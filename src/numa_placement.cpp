@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "numa_placement.hpp"
+
+// From <numaif.h>, which comes with libnuma rather than the kernel headers.
+static constexpr int MPOL_PREFERRED_MODE = 1;
+
+bool ThreadPlacement::Apply() const
+{
+    current_node = node;
+    if (cpus.empty())
+        return true;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+const NumaTopology & NumaTopology::Instance()
+{
+    // Never destroyed, the engine leaves through exit() from a signal handler.
+    static const NumaTopology * topology = new NumaTopology(Read("/sys/devices/system/node"));
+    return *topology;
+}
+
+NumaTopology NumaTopology::Read(const std::string & root)
+{
+    std::vector<Node> nodes;
+    std::error_code error;
+    for (const auto & entry : std::filesystem::directory_iterator(root, error))
+    {
+        std::string name = entry.path().filename().string();
+        if (name.size() <= 4 || name.compare(0, 4, "node") != 0
+            || !std::all_of(name.begin() + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; }))
+            continue;
+
+        std::ifstream file(entry.path() / "cpulist");
+        std::string cpulist;
+        std::getline(file, cpulist);
+        Node node{atoi(name.c_str() + 4), {}};
+        if (file.is_open() && ParseCpuList(cpulist, node.cpus))
+            nodes.push_back(std::move(node));
+    }
+
+    if (nodes.empty())
+    {
+        Node node{0, {}};
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++)
+            node.cpus.push_back(cpu);
+        nodes.push_back(std::move(node));
+    }
+    std::sort(nodes.begin(), nodes.end(), [](const Node & a, const Node & b) { return a.id < b.id; });
+    return NumaTopology(std::move(nodes));
+}
+
+const NumaTopology::Node * NumaTopology::Find(int id) const
+{
+    for (const Node & node : nodes)
+        if (node.id == id)
+            return &node;
+    return nullptr;
+}
+
+std::vector<ThreadPlacement> NumaTopology::Place(size_t threads, Pinning pinning, const std::vector<int> & chosen) const
+{
+    std::vector<ThreadPlacement> placements(threads);
+    if (pinning == Pinning::None)
+        return placements;
+
+    // Memory only nodes have nowhere to run a thread.
+    std::vector<const Node *> targets;
+    for (int id : chosen)
+        if (const Node * node = Find(id); node != nullptr && !node->cpus.empty())
+            targets.push_back(node);
+    if (chosen.empty())
+        for (const Node & node : nodes)
+            if (!node.cpus.empty())
+                targets.push_back(&node);
+    if (targets.empty())
+        return placements;
+
+    for (size_t i = 0; i < threads; i++)
+    {
+        const Node & node = *targets[i % targets.size()];
+        placements[i].node = node.id;
+        if (pinning == Pinning::Node)
+            placements[i].cpus = node.cpus;
+        else
+            placements[i].cpus = {node.cpus[i / targets.size() % node.cpus.size()]};
+    }
+    return placements;
+}
+
+bool ParseCpuList(const std::string & text, std::vector<int> & out)
+{
+    std::vector<int> parsed;
+    size_t start = 0;
+    // The kernel prints an empty list for a node without CPUs.
+    size_t end = text.find_last_not_of(" \n");
+    size_t length = end == std::string::npos ? 0 : end + 1;
+    while (start < length)
+    {
+        size_t comma = std::min(text.find(',', start), length);
+        std::string range = text.substr(start, comma - start);
+        char * rest = nullptr;
+        long first = strtol(range.c_str(), &rest, 10);
+        long last = first;
+        if (rest != range.c_str() && *rest == '-')
+        {
+            const char * second = rest + 1;
+            last = strtol(second, &rest, 10);
+            if (rest == second)
+                return false;
+        }
+        if (range.empty() || rest == range.c_str() || *rest != '\0' || first < 0 || last < first)
+            return false;
+        for (long cpu = first; cpu <= last; cpu++)
+            parsed.push_back(int(cpu));
+        start = comma + 1;
+    }
+    out = std::move(parsed);
+    return true;
+}
+
+namespace
+{
+struct Arena
+{
+    std::mutex mutex;
+    char * next = nullptr;
+    size_t left = 0;
+};
+}
+
+// Mapped and bound for a node, then handed out piece by piece.
+static constexpr size_t CHUNK = 2 << 20;
+
+static void * MapOnNode(size_t bytes, int node)
+{
+    void * memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        throw std::bad_alloc();
+    // Only a preference, so a full node falls back to the others.
+    unsigned long mask = 1ul << node;
+    syscall(SYS_mbind, memory, bytes, MPOL_PREFERRED_MODE, &mask, sizeof(mask) * 8 + 1, 0);
+    return memory;
+}
+
+void * NodeArena::Allocate(size_t bytes, size_t align, int node)
+{
+    if (node < 0 || node >= MAX_NODES)
+        return ::operator new(bytes, std::align_val_t(align));
+
+    // Never destroyed so that slabs may still be carved out during exit.
+    static std::array<Arena, MAX_NODES> * arenas = new std::array<Arena, MAX_NODES>();
+    Arena & arena = (*arenas)[node];
+
+    // Large blocks get a mapping of their own rather than waste a chunk.
+    if (bytes + align > CHUNK / 4)
+        return MapOnNode((bytes + 4095) & ~size_t(4095), node);
+
+    std::unique_lock<std::mutex> l(arena.mutex);
+    size_t padding = -reinterpret_cast<uintptr_t>(arena.next) & (align - 1);
+    if (arena.next == nullptr || padding + bytes > arena.left)
+    {
+        arena.next = static_cast<char *>(MapOnNode(CHUNK, node));
+        arena.left = CHUNK;
+        padding = 0;
+    }
+    void * p = arena.next + padding;
+    arena.next += padding + bytes;
+    arena.left -= padding + bytes;
+    return p;
+}
@@ -0,0 +1,115 @@
+#ifndef NUMA_PLACEMENT_HPP
+#define NUMA_PLACEMENT_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * How threads owning instruments are pinned, see NumaTopology::Place.
+*/
+enum class Pinning
+{
+    // Threads run anywhere and memory goes wherever it is first touched.
+    None,
+    // Each thread may run on any CPU of its node.
+    Node,
+    // Each thread has a CPU of its node to itself, as far as there are enough.
+    Core
+};
+
+/**
+ * Where a thread runs, and the node what it owns is allocated on.
+*/
+struct ThreadPlacement
+{
+    static constexpr int NO_NODE = -1;
+
+    int node = NO_NODE;
+    // CPUs the thread is pinned to, none to leave it unpinned.
+    std::vector<int> cpus;
+
+    /**
+     * Pins the calling thread to the CPUs and makes the node its current
+     * node.
+     * 
+     * @return false if the CPUs could not be set, the node is current anyway.
+    */
+    bool Apply() const;
+
+    /**
+     * Node the calling thread was placed on, NO_NODE if none.
+    */
+    static int CurrentNode() { return current_node; }
+
+private:
+    static inline thread_local int current_node = NO_NODE;
+};
+
+/**
+ * NUMA nodes of the machine and their CPUs, as listed under
+ * /sys/devices/system/node. A machine without that list is taken as a
+ * single node 0 holding every CPU.
+*/
+class NumaTopology
+{
+public:
+    struct Node
+    {
+        int id;
+        std::vector<int> cpus;
+    };
+
+    static const NumaTopology & Instance();
+
+    explicit NumaTopology(std::vector<Node> nodes) : nodes(std::move(nodes)) { }
+
+    /**
+     * Reads the nodes listed under a sysfs directory, such as
+     * /sys/devices/system/node.
+    */
+    static NumaTopology Read(const std::string & root);
+
+    const std::vector<Node> & Nodes() const { return nodes; }
+    const Node * Find(int id) const;
+
+    /**
+     * Spreads threads round robin over the given nodes, or over every node
+     * with CPUs when none are given, so thread i goes to node i % nodes.
+     * With Pinning::Core the threads of a node take its CPUs in turn.
+     * With Pinning::None every thread is left unplaced.
+    */
+    std::vector<ThreadPlacement> Place(size_t threads, Pinning pinning, const std::vector<int> & chosen = {}) const;
+
+private:
+    std::vector<Node> nodes;
+};
+
+/**
+ * Parses a list of CPUs or nodes as the kernel prints them, "0-3,8,10-11".
+ * 
+ * @return false if the list is malformed.
+*/
+bool ParseCpuList(const std::string & text, std::vector<int> & out);
+
+/**
+ * Memory preferring one NUMA node, carved out of chunks mapped for it.
+ * 
+ * Allocations are never freed, the arena serves books and pool slabs which
+ * are not given back either. Chunks are bound with mbind before they
+ * are touched, so their pages come from the node whichever thread touches
+ * them first. Where the kernel refuses the binding the chunks are still
+ * handed out, placed by first touch.
+*/
+class NodeArena
+{
+public:
+    static constexpr int MAX_NODES = 16;
+
+    /**
+     * @param node Node below MAX_NODES.
+    */
+    static void * Allocate(size_t bytes, size_t align, int node);
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "options.hpp"
+
+static bool ParseCount(const char * value, size_t & out)
+{
+    char * end = nullptr;
+    unsigned long long parsed = strtoull(value, &end, 10);
+    if (end == value || *end != '\0')
+        return false;
+
+    out = parsed;
+    return true;
+}
+
+bool ParseOptions(int argc, char * argv[], EngineOptions & options)
+{
+    for (int i = 0; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == std::string::npos)
+        {
+            fprintf(stderr, "Malformed option: %s\n", argv[i]);
+            return false;
+        }
+
+        std::string key = arg.substr(2, eq - 2);
+        const char * value = argv[i] + eq + 1;
+        bool ok = true;
+        if (key == "threading")
+        {
+            if (strcmp(value, "pooled") == 0)
+                options.threading = Threading::Pooled;
+            else if (strcmp(value, "per-connection") == 0)
+                options.threading = Threading::PerConnection;
+            else
+                ok = false;
+        }
+        else if (key == "matching")
+        {
+            if (strcmp(value, "locked") == 0)
+                options.matching = Matching::Locked;
+            else if (strcmp(value, "sharded") == 0)
+                options.matching = Matching::Sharded;
+            else
+                ok = false;
+        }
+        else if (key == "self-trade")
+        {
+            if (strcmp(value, "allow") == 0)
+                options.self_trade = SelfTrade::Allow;
+            else if (strcmp(value, "cancel-newest") == 0)
+                options.self_trade = SelfTrade::CancelNewest;
+            else if (strcmp(value, "cancel-oldest") == 0)
+                options.self_trade = SelfTrade::CancelOldest;
+            else if (strcmp(value, "cancel-both") == 0)
+                options.self_trade = SelfTrade::CancelBoth;
+            else if (strcmp(value, "decrement") == 0)
+                options.self_trade = SelfTrade::Decrement;
+            else
+                ok = false;
+        }
+        else if (key == "shards")
+            ok = ParseCount(value, options.shards);
+        else if (key == "pin")
+        {
+            if (strcmp(value, "none") == 0)
+                options.pinning = Pinning::None;
+            else if (strcmp(value, "node") == 0)
+                options.pinning = Pinning::Node;
+            else if (strcmp(value, "core") == 0)
+                options.pinning = Pinning::Core;
+            else
+                ok = false;
+        }
+        else if (key == "numa-nodes")
+        {
+            ok = ParseCpuList(value, options.numa_nodes) && !options.numa_nodes.empty();
+            for (int node : options.numa_nodes)
+            {
+                const NumaTopology::Node * found = NumaTopology::Instance().Find(node);
+                ok = ok && found != nullptr && !found->cpus.empty() && node < NodeArena::MAX_NODES;
+            }
+        }
+        else if (key == "shard-queue-capacity")
+            ok = ParseCount(value, options.shard_queue_capacity) && options.shard_queue_capacity > 0;
+        else if (key == "io-threads")
+            ok = ParseCount(value, options.io_threads) && options.io_threads > 0;
+        else if (key == "matching-threads")
+            ok = ParseCount(value, options.matching_threads);
+        else if (key == "queue-capacity")
+            ok = ParseCount(value, options.queue_capacity) && options.queue_capacity > 0;
+        else if (key == "market-data")
+            options.market_data = value;
+        else if (key == "market-data-capacity")
+            ok = ParseCount(value, options.market_data_capacity) && options.market_data_capacity > 0;
+        else if (key == "market-data-snapshot")
+            ok = ParseCount(value, options.market_data_snapshot_interval) && options.market_data_snapshot_interval > 0;
+        else if (key == "journal")
+            options.journal = value;
+        else if (key == "journal-queue-capacity")
+            ok = ParseCount(value, options.journal_queue_capacity) && options.journal_queue_capacity > 0;
+        else if (key == "snapshot")
+            options.snapshot = value;
+        else if (key == "snapshot-interval")
+            ok = ParseCount(value, options.snapshot_interval) && options.snapshot_interval > 0;
+        else if (key == "stats")
+            options.stats = value;
+        else if (key == "stats-interval")
+            ok = ParseCount(value, options.stats_interval) && options.stats_interval > 0;
+        else if (key == "max-order-size")
+            ok = ParseCount(value, options.risk.max_order_size);
+        else if (key == "max-notional")
+            ok = ParseCount(value, options.risk.max_notional);
+        else if (key == "max-position")
+            ok = ParseCount(value, options.risk.max_position);
+        else if (key == "max-open-orders")
+            ok = ParseCount(value, options.risk.max_open_orders);
+        else if (key == "price-collar-bps")
+            ok = ParseCount(value, options.risk.price_collar_bps);
+        else
+            ok = false;
+
+        if (!ok)
+        {
+            fprintf(stderr, "Invalid option: %s\n", argv[i]);
+            return false;
+        }
+    }
+
+    if (options.matching_threads == 0)
+        options.matching_threads = std::max(1u, std::thread::hardware_concurrency());
+    if (options.shards == 0)
+        options.shards = std::max(1u, std::thread::hardware_concurrency());
+
+    // With locks, the order of the appends does not match the order in
+    // which concurrent commands on a book executed, so replay could diverge.
+    if (!options.journal.empty() && options.matching != Matching::Sharded)
+    {
+        fprintf(stderr, "--journal requires --matching=sharded\n");
+        return false;
+    }
+    // Only shard threads own instruments.
+    if (options.pinning != Pinning::None && options.matching != Matching::Sharded)
+    {
+        fprintf(stderr, "--pin requires --matching=sharded\n");
+        return false;
+    }
+    if (!options.numa_nodes.empty() && options.pinning == Pinning::None)
+    {
+        fprintf(stderr, "--numa-nodes requires --pin\n");
+        return false;
+    }
+    // Commands after the last snapshot are only found in the journal.
+    if (!options.snapshot.empty() && options.journal.empty())
+    {
+        fprintf(stderr, "--snapshot requires --journal\n");
+        return false;
+    }
+    return true;
+}
+
+void PrintOptionsUsage()
+{
+    fprintf(
+        stderr,
+        "Options:\n"
+        "  --threading=pooled|per-connection  connection threading model (default pooled)\n"
+        "  --io-threads=N                     epoll threads reading connections (default 1)\n"
+        "  --matching-threads=N               threads handling commands (default: cores)\n"
+        "  --queue-capacity=N                 command batches queued per matching thread (default 4096)\n"
+        "  --matching=locked|sharded          lock based matching or one owning thread per instrument (default locked)\n"
+        "  --shards=N                         owning threads when sharded (default: cores)\n"
+        "  --shard-queue-capacity=N           commands buffered per shard (default 65536)\n"
+        "  --pin=none|node|core               pin shard threads to the CPUs of a NUMA node or to one CPU each, placing\n"
+        "                                     their books and orders on that node (default none)\n"
+        "  --numa-nodes=LIST                  NUMA nodes to spread pinned shards over, such as 0-1 (default all)\n"
+        "  --market-data=PATH                 publish the binary L2 feed into a ring mapped from PATH\n"
+        "  --market-data-capacity=N           messages held by the feed ring (default 262144)\n"
+        "  --market-data-snapshot=N           updates between full snapshots of the feed (default 65536)\n"
+        "  --journal=PATH                     journal commands to PATH and recover from it at start (sharded only)\n"
+        "  --journal-queue-capacity=N         commands buffered for the journal writer (default 65536)\n"
+        "  --snapshot=PATH                    snapshot the books to PATH and restart from it with the journal tail\n"
+        "  --snapshot-interval=N              seconds between snapshots (default 60)\n"
+        "  --stats=PATH                       record latency histograms and dump them to PATH\n"
+        "  --stats-interval=N                 seconds between dumps of the histograms (default 10)\n"
+        "  --max-order-size=N                 reject orders above N in quantity\n"
+        "  --max-notional=N                   reject orders above N in price times quantity\n"
+        "  --max-position=N                   reject orders that could take a connection's position in an instrument beyond N\n"
+        "  --max-open-orders=N                reject orders of a connection with N orders open\n"
+        "  --price-collar-bps=N               reject orders priced more than N basis points from the last trade\n"
+        "  --self-trade=allow|cancel-newest|cancel-oldest|cancel-both|decrement\n"
+        "                                     what to do when a connection's orders would trade together (default allow)\n");
+}
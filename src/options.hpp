@@ -0,0 +1,89 @@
+#ifndef OPTIONS_HPP
+#define OPTIONS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "numa_placement.hpp"
+#include "order.hpp"
+
+enum class Threading
+{
+    // One detached thread per client connection.
+    PerConnection,
+    // Connections multiplexed onto epoll threads feeding a fixed matching pool.
+    Pooled
+};
+
+enum class Matching
+{
+    // Any thread matches any instrument, synchronised by the book locks.
+    Locked,
+    // Every instrument is owned by one shard thread matching without locks.
+    Sharded
+};
+
+/**
+ * Pre-trade limits applied to every connection, 0 for no limit. See
+ * RiskAccount.
+*/
+struct RiskLimits
+{
+    // Quantity of a single order.
+    uint64_t max_order_size = 0;
+    // Price times quantity of a single order.
+    uint64_t max_notional = 0;
+    // Absolute position in an instrument, counting open orders as filled.
+    uint64_t max_position = 0;
+    // Orders open at once across all instruments.
+    uint64_t max_open_orders = 0;
+    // Distance from the last trade price of the instrument, in basis points.
+    uint64_t price_collar_bps = 0;
+
+    bool Enabled() const { return max_order_size || max_notional || max_position || max_open_orders || price_collar_bps; }
+};
+
+struct EngineOptions
+{
+    Threading threading = Threading::Pooled;
+    Matching matching = Matching::Locked;
+    size_t shards = 0; // 0 picks the hardware concurrency
+    size_t shard_queue_capacity = 1 << 16;
+    // Pinning of the shard threads, whose books and orders then go on
+    // their node.
+    Pinning pinning = Pinning::None;
+    // NUMA nodes the shards are spread over, empty for all of them.
+    std::vector<int> numa_nodes;
+    size_t io_threads = 1;
+    size_t matching_threads = 0; // 0 picks the hardware concurrency
+    size_t queue_capacity = 4096;
+    // Path of the L2 feed ring, empty for no feed.
+    std::string market_data;
+    size_t market_data_capacity = 1 << 18;
+    size_t market_data_snapshot_interval = 1 << 16;
+    // Path of the write-ahead command journal, empty for no journal.
+    std::string journal;
+    size_t journal_queue_capacity = 1 << 16;
+    // Path of the book snapshot, empty for no snapshots.
+    std::string snapshot;
+    size_t snapshot_interval = 60; // seconds
+    // Path latency histograms are dumped to, empty for no histograms.
+    std::string stats;
+    size_t stats_interval = 10; // seconds
+    RiskLimits risk;
+    // Applied to every order, connections being the clients.
+    SelfTrade self_trade = SelfTrade::Allow;
+};
+
+/**
+ * Parses `--key=value` flags into options.
+ * 
+ * @return false if a flag is unknown or malformed.
+*/
+bool ParseOptions(int argc, char * argv[], EngineOptions & options);
+
+void PrintOptionsUsage();
+
+#endif
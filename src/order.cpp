@@ -1,22 +1,58 @@
 
+#include <algorithm>
+
 #include "order.hpp"
+#include "risk_check.hpp"
+#include "slab_pool.hpp"
 
-Order::Order(order_id_t order_id, instrument_id_t instrument, price_t price, unsigned int count)
+Order::Order(order_id_t order_id, symbol_t symbol, price_t price, unsigned int count)
     : order_id(order_id)
     , execution_id(0)
-    , instrument(instrument)
+    , symbol(symbol)
     , price(price)
     , count(count)
     , timestamp(0)
     , activated(false)
-    , completed(false)
+    , amended(false)
+    , time_in_force(TimeInForce::GTC)
+    , self_trade(SelfTrade::Allow)
+    , client(NO_CLIENT)
+    , risk(nullptr)
 {
 }
 
-std::shared_ptr<Order> Order::from(order_id_t order_id, instrument_id_t instrument, price_t price, unsigned int count, Side side)
+// One slot fits either side of order.
+typedef SlabPool<std::max(sizeof(BuyOrder), sizeof(SellOrder)), std::max(alignof(BuyOrder), alignof(SellOrder))> OrderPool;
+
+Order * Order::from(
+    order_id_t order_id, symbol_t symbol, price_t price, unsigned int count, Side side, TimeInForce time_in_force, int node)
 {
+    void * slot = OrderPool::Allocate(node);
+    Order * order;
     if (side == Side::BUY)
-        return std::make_shared<BuyOrder>(order_id, instrument, price, count);
+        order = new (slot) BuyOrder(order_id, symbol, price, count);
     else
-        return std::make_shared<SellOrder>(order_id, instrument, price, count);
-}
\ No newline at end of file
+        order = new (slot) SellOrder(order_id, symbol, price, count);
+    order->time_in_force = time_in_force;
+    return order;
+}
+
+void Order::Destroy(Order * order)
+{
+    if (order->risk != nullptr)
+    {
+        order->RiskChanged(-int64_t(order->count), 0);
+        order->risk->account->Closed();
+    }
+    order->~Order();
+    OrderPool::Free(order);
+}
+
+void Order::RiskChanged(int64_t open, unsigned int traded)
+{
+    Side side = GetSide();
+    if (open != 0)
+        risk->Open(side).fetch_add(open, std::memory_order_relaxed);
+    if (traded != 0)
+        risk->position.fetch_add(side == Side::BUY ? int64_t(traded) : -int64_t(traded), std::memory_order_relaxed);
+}
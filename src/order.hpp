@@ -1,16 +1,20 @@
 #ifndef ORDER_HPP
 #define ORDER_HPP
 
-#include <condition_variable>
-#include <mutex>
-#include <string>
+#include <algorithm>
+#include <chrono>
 
 #include "io.hpp"
+#include "numa_placement.hpp"
+#include "symbol.hpp"
+
+struct RiskExposure;
 
 typedef unsigned int order_id_t;
 typedef unsigned int execution_id_t;
-typedef std::string instrument_id_t;
 typedef unsigned int price_t;
+// Identifies the client an order belongs to, see Order::NO_CLIENT.
+typedef uint32_t client_id_t;
 
 enum class Side
 {
@@ -18,6 +22,37 @@ enum class Side
     SELL
 };
 
+/**
+ * What happens to the quantity an order does not fill on arrival.
+*/
+enum class TimeInForce : uint8_t
+{
+    // Rests in the book until filled or cancelled.
+    GTC,
+    // Dropped; market orders are IOC orders priced to cross any level.
+    IOC,
+    // The order only trades if it can be filled entirely at once.
+    FOK
+};
+
+/**
+ * What happens when an order would trade with a resting order of its own
+ * client. The incoming order's mode applies.
+*/
+enum class SelfTrade : uint8_t
+{
+    // They trade.
+    Allow,
+    // The rest of the incoming order is cancelled.
+    CancelNewest,
+    // The resting order is cancelled and matching goes on.
+    CancelOldest,
+    CancelBoth,
+    // The smaller quantity is taken off both without a trade, and the order
+    // left with nothing is cancelled.
+    Decrement
+};
+
 /**
  * Represents a Buy or Sell Order.
 */
@@ -26,51 +61,128 @@ class Order
 public:
     /**
      * Factory method to create an Order based on the side.
+     * 
+     * Orders live in a slab pool and are owned by the book they rest in,
+     * which returns them with Destroy once filled or cancelled.
+     * 
+     * @param node NUMA node of the book, see OrderBook::node.
     */
-    static std::shared_ptr<Order> from(order_id_t order_id, instrument_id_t instrument, price_t price, unsigned int count, Side side);
+    static Order * from(
+        order_id_t order_id,
+        symbol_t symbol,
+        price_t price,
+        unsigned int count,
+        Side side,
+        TimeInForce time_in_force = TimeInForce::GTC,
+        int node = ThreadPlacement::NO_NODE);
+    static void Destroy(Order * order);
     order_id_t GetOrderId() const { return order_id; }
     execution_id_t GetExecutionId() const { return execution_id; }
     void IncrementExecutionId() { execution_id++; }
-    instrument_id_t GetInstrumentId() const { return instrument; }
+    void SetExecutionId(execution_id_t id) { execution_id = id; }
+    symbol_t GetSymbol() const { return symbol; }
     price_t GetPrice() const { return price; }
     unsigned int GetCount() const { return count; }
     std::chrono::microseconds::rep GetTimestamp() { return timestamp; }
     void SetTimestamp(std::chrono::microseconds::rep tm) { timestamp = tm; }
     bool GetActivated() { return activated; }
-    bool GetCompleted() const { return completed; }
-    void SetCompleted() { completed = true; }
-    void Fill(unsigned int qty) { count = qty >= count ? 0 : count - qty; }
+    void Fill(unsigned int qty)
+    {
+        qty = std::min(qty, count);
+        if (risk != nullptr)
+            RiskChanged(-int64_t(qty), qty);
+        count -= qty;
+    }
+    TimeInForce GetTimeInForce() const { return time_in_force; }
+
+    /**
+     * Gives the order a new price and quantity before it is queued again.
+     * Amended orders report one amended event instead of being added.
+    */
+    void Amend(price_t price, unsigned int count)
+    {
+        Resize(count);
+        this->price = price;
+        amended = true;
+    }
+    // Smaller quantity at the same price, the order keeps its place.
+    void Resize(unsigned int count)
+    {
+        if (risk != nullptr)
+            RiskChanged(int64_t(count) - this->count, 0);
+        this->count = count;
+    }
+    bool GetAmended() const { return amended; }
+    // Only GTC orders ever enter the book, IOC and FOK orders never rest.
+    bool Rests() const { return time_in_force == TimeInForce::GTC; }
 
     virtual Side GetSide() const = 0;
     virtual bool CanMatch(price_t price) = 0;
     virtual ~Order() = default;
 
-    void Activate()
+    void Activate() { activated = true; }
+    // Back to a dummy node while an amended order is matched again.
+    void Deactivate() { activated = false; }
+
+    /**
+     * Charges the fills of the order, and its quantity until it is
+     * destroyed, to the exposure of the connection that sent it.
+    */
+    void SetRisk(RiskExposure * exposure) { risk = exposure; }
+
+    static constexpr client_id_t NO_CLIENT = 0;
+
+    /**
+     * Gives the order to a client, whose resting orders it is then kept
+     * from trading with as self_trade says.
+    */
+    void SetClient(client_id_t client, SelfTrade self_trade)
+    {
+        this->client = client;
+        this->self_trade = self_trade;
+    }
+    client_id_t GetClient() const { return client; }
+    SelfTrade GetSelfTrade() const { return self_trade; }
+    // Whether matching the order against other must be prevented.
+    bool SelfTrades(const Order & other) const
     {
-        activated = true;
-        cv.notify_all();
+        return self_trade != SelfTrade::Allow && client != NO_CLIENT && client == other.client;
     }
 
-    std::condition_variable cv;
+    // Intrusive links of the price level queue the order rests in.
+    Order * prev = nullptr;
+    Order * next = nullptr;
 
 protected:
-    Order(order_id_t order_id, instrument_id_t instrument, price_t price, unsigned int count);
+    Order(order_id_t order_id, symbol_t symbol, price_t price, unsigned int count);
 
 private:
+    /**
+     * Moves the open quantity of the exposure by open and its position by
+     * traded, in the direction of the order's side.
+    */
+    void RiskChanged(int64_t open, unsigned int traded);
+
     order_id_t order_id;
     execution_id_t execution_id;
-    instrument_id_t instrument;
+    symbol_t symbol;
     price_t price;
     unsigned int count;
     std::chrono::microseconds::rep timestamp;
+    // Only read and written under the lock of the book the order rests in,
+    // which wakes the threads waiting for it, see Book::WaitForActivation.
     bool activated;
-    bool completed;
+    bool amended;
+    TimeInForce time_in_force;
+    SelfTrade self_trade;
+    client_id_t client;
+    RiskExposure * risk;
 };
 
 class BuyOrder : public Order
 {
 public:
-    BuyOrder(order_id_t order_id, instrument_id_t instrument, price_t price, unsigned int count) : Order(order_id, instrument, price, count)
+    BuyOrder(order_id_t order_id, symbol_t symbol, price_t price, unsigned int count) : Order(order_id, symbol, price, count)
     {
     }
     virtual Side GetSide() const override { return Side::BUY; }
@@ -80,8 +192,7 @@ public:
 class SellOrder : public Order
 {
 public:
-    SellOrder(order_id_t order_id, instrument_id_t instrument, price_t price, unsigned int count)
-        : Order(order_id, instrument, price, count)
+    SellOrder(order_id_t order_id, symbol_t symbol, price_t price, unsigned int count) : Order(order_id, symbol, price, count)
     {
     }
 
@@ -1,42 +1,151 @@
 #include "order_book.hpp"
 
-void OrderBook::Handle(std::shared_ptr<Order> order)
+void OrderBook::Handle(Order & order)
 {
-    assert(order->GetActivated() == false);
+    assert(order.GetActivated() == false);
+
+    if (order.GetTimeInForce() == TimeInForce::FOK)
+    {
+        // Orders resting through TryRest take no side lock. Holding this lock
+        // keeps them, and their later timestamps, out of the quantity the
+        // fill check counts.
+        std::unique_lock<BookMutex> l = ProfiledLock(order_book_lock);
+        order.SetTimestamp(getCurrentTimestamp());
+        Execute(order);
+        return;
+    }
 
     Prepare(order);
 
     Execute(order);
 }
 
+bool OrderBook::TryRest(Order & order)
+{
+    if (!order.Rests())
+        return false;
+    BaseBook * other = GetOtherBook(order.GetSide());
+    // Most crossing orders are told apart without the lock.
+    if (order.CanMatch(other->BestHint()))
+        return false;
+
+    // Levels are only ever created under this lock, so the hint read under it
+    // covers every order that came before. It can only be stale by levels
+    // since removed, which sends the order the usual way.
+    std::unique_lock<BookMutex> l = ProfiledLock(order_book_lock);
+    if (order.CanMatch(other->BestHint()))
+        return false;
+    order.SetTimestamp(getCurrentTimestamp());
+    GetBook(order.GetSide())->Rest(order);
+    return true;
+}
+
 // Set arrival timestamp for order and add dummy node into book
-void OrderBook::Prepare(std::shared_ptr<Order> order)
+void OrderBook::Prepare(Order & order)
 {
-    std::unique_lock<std::mutex> l(order_book_lock);
+    std::unique_lock<BookMutex> l = ProfiledLock(order_book_lock);
 
     // Get timestamp for order
-    order->SetTimestamp(getCurrentTimestamp());
+    order.SetTimestamp(getCurrentTimestamp());
 
-    // Insert dummy node into order
-    Add(order);
+    // Insert dummy node into order. Orders that never rest need none: no
+    // later order can match them, and the timestamp taken under the lock
+    // still tells them which resting orders came first.
+    if (order.Rests())
+        Add(order);
 }
 
-void OrderBook::Add(std::shared_ptr<Order> order)
+void OrderBook::Add(Order & order)
 {
-    GetBook(order->GetSide())->Add(order);
+    GetBook(order.GetSide())->Add(order);
 }
 
-void OrderBook::Execute(std::shared_ptr<Order> order)
+void OrderBook::Execute(Order & order)
 {
     // Perform CrossSpread and match orders to execute
-    bool filled = GetOtherBook(order->GetSide())->CrossSpread(order);
+    int64_t matching = LatencyStats::Start();
+    bool filled = GetOtherBook(order.GetSide())->CrossSpread(order);
+    LatencyStats::Record(Stage::Match, matching);
+
+    if (order.Rests())
+        GetBook(order.GetSide())->AfterExecute(order, filled);
+    else
+        Drop(order, filled);
+}
+
+void OrderBook::Drop(Order & order, bool filled)
+{
+    // The unfilled quantity is deleted right away, as if cancelled.
+    if (!filled)
+        Output::OrderDeleted(order.GetOrderId(), true, getCurrentTimestamp());
+    Order::Destroy(&order);
+}
+
+void OrderBook::Cancel(order_id_t order_id, Side side)
+{
+    GetBook(side)->Cancel(order_id);
+}
+
+void OrderBook::Amend(order_id_t order_id, Side side, price_t price, unsigned int count)
+{
+    Order * order;
+    {
+        // The new timestamp and the dummy node at the new price are taken
+        // together, as in Prepare.
+        std::unique_lock<BookMutex> l = ProfiledLock(order_book_lock);
+        order = GetBook(side)->Amend(order_id, price, count, getCurrentTimestamp());
+    }
 
-    GetBook(order->GetSide())->AfterExecute(order, filled);
+    if (order != nullptr)
+        Execute(*order);
 }
 
-void OrderBook::Cancel(std::shared_ptr<Order> order)
+void OrderBook::HandleExclusive(Order & order)
 {
-    GetBook(order->GetSide())->Cancel(order);
+    // Commands are already serialised by the owning thread, so the arrival
+    // timestamp alone decides priority and no dummy node is needed.
+    order.SetTimestamp(getCurrentTimestamp());
+    ExecuteExclusive(order);
+}
+
+void OrderBook::ExecuteExclusive(Order & order)
+{
+    int64_t matching = LatencyStats::Start();
+    bool filled = GetOtherBook(order.GetSide())->CrossSpreadExclusive(order);
+    LatencyStats::Record(Stage::Match, matching);
+    if (filled)
+    {
+        if (order.GetAmended())
+            Output::OrderAmended(order.GetOrderId(), order.GetPrice(), 0, true, getCurrentTimestamp());
+        Order::Destroy(&order);
+    }
+    else if (!order.Rests())
+        Drop(order, false);
+    else
+        GetBook(order.GetSide())->RestExclusive(order);
+}
+
+void OrderBook::CancelExclusive(order_id_t order_id, Side side)
+{
+    GetBook(side)->CancelExclusive(order_id);
+}
+
+void OrderBook::AmendExclusive(order_id_t order_id, Side side, price_t price, unsigned int count)
+{
+    Order * order = GetBook(side)->AmendExclusive(order_id, price, count);
+    if (order == nullptr)
+        return;
+    order->SetTimestamp(getCurrentTimestamp());
+    ExecuteExclusive(*order);
+}
+
+void OrderBook::Restore(Order & order)
+{
+    order.SetTimestamp(getCurrentTimestamp());
+    if (order.GetSide() == Side::BUY)
+        bids.Restore(order);
+    else
+        asks.Restore(order);
 }
 
 BaseBook * OrderBook::GetBook(Side side)
@@ -50,4 +159,4 @@ BaseBook * OrderBook::GetBook(Side side)
 BaseBook * OrderBook::GetOtherBook(Side side)
 {
     return GetBook(side == Side::BUY ? Side::SELL : Side::BUY);
-}
\ No newline at end of file
+}
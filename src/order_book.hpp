@@ -1,11 +1,11 @@
 #ifndef ORDER_BOOK_HPP
 #define ORDER_BOOK_HPP
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <assert.h>
 
-#include "atomic_map.hpp"
 #include "book.hpp"
 #include "order.hpp"
 
@@ -15,34 +15,136 @@
 class OrderBook
 {
 public:
-    OrderBook() = default;
+    OrderBook(symbol_t symbol, size_t id) : symbol(symbol), id(id)
+    {
+        LabelLock(buy, "buy", symbol);
+        LabelLock(sell, "sell", symbol);
+        LabelLock(order_book_lock, "order_book", symbol);
+        bids.LabelLock("bids", symbol);
+        asks.LabelLock("asks", symbol);
+        bids.TrackLastTrade(&last_trade);
+        asks.TrackLastTrade(&last_trade);
+    }
 
     /**
      * Handles an order of any side by attempting to execute it
      * with current resting orders. Else, adds the order to the 
-     * respective book.
+     * respective book, or drops it if it is not a GTC order.
     */
-    void Handle(std::shared_ptr<Order> order);
-    void Cancel(std::shared_ptr<Order> order);
+    void Handle(Order & order);
+    void Cancel(order_id_t order_id, Side side);
 
-    std::mutex buy;
-    std::mutex sell;
+    /**
+     * Rests a GTC order at once, without matching, if it cannot cross the
+     * other side. Such an order takes no side lock and never shows as a
+     * dummy node, so it neither waits for nor holds up the orders matching
+     * on its side.
+     * 
+     * @return false, having done nothing, if the order may cross.
+    */
+    bool TryRest(Order & order);
+
+    /**
+     * Gives a resting order a new price and quantity, see Book::Amend. An
+     * order moved to a new price is matched again like a new order, and its
+     * outcome reported by a single amended event.
+    */
+    void Amend(order_id_t order_id, Side side, price_t price, unsigned int count);
+
+    /**
+     * Single writer variants of Handle and Cancel.
+     * 
+     * Only valid when every command of this OrderBook is executed by the
+     * same thread, in which case no locks are taken and resting orders are
+     * always activated.
+    */
+    void HandleExclusive(Order & order);
+    void CancelExclusive(order_id_t order_id, Side side);
+    void AmendExclusive(order_id_t order_id, Side side, price_t price, unsigned int count);
+
+    /**
+     * Visits the resting bids, then the resting asks, each in priority order.
+     * Only valid under the same conditions as HandleExclusive.
+    */
+    template <typename Visitor>
+    void ForEachResting(Visitor && visit)
+    {
+        bids.ForEachResting(visit);
+        asks.ForEachResting(visit);
+    }
+
+    /**
+     * Depth queries, answered from the running totals each level and side
+     * keep of their visible orders, without visiting the orders.
+     * 
+     * They take the lock of the side, so any thread may query a book
+     * matched under locks. A book of a matching shard may only be queried
+     * from its shard thread.
+    */
+    bool Best(Side side, DepthLevel & level) { return GetBook(side)->Best(level); }
+    bool BestBid(DepthLevel & level) { return bids.Best(level); }
+    bool BestAsk(DepthLevel & level) { return asks.Best(level); }
+
+    /**
+     * Writes up to count levels of the side, best first.
+     * 
+     * @return the number of levels written.
+    */
+    size_t Depth(Side side, DepthLevel * levels, size_t count) { return GetBook(side)->Depth(levels, count); }
+
+    /**
+     * Quantity resting on the side at price or better, which is what an
+     * order of the other side limited to price could trade against.
+    */
+    uint64_t QuantityUpTo(Side side, price_t price) { return GetBook(side)->QuantityUpTo(price); }
+
+    BookTotals Totals(Side side) { return GetBook(side)->Totals(); }
+
+    /**
+     * Price of the last trade, 0 before any. Read without a lock, so it
+     * may lag behind a trade happening at the same time.
+    */
+    price_t LastTradePrice() const { return last_trade.load(std::memory_order_relaxed); }
+
+    /**
+     * Rests an order restored from a snapshot without matching it.
+    */
+    void Restore(Order & order);
+
+    BookMutex buy;
+    BookMutex sell;
+
+    const symbol_t symbol;
+    // Dense id given by the InstrumentDirectory, in order of creation.
+    const size_t id;
+
+    // Matching shard owning this book when the engine runs sharded.
+    size_t shard = 0;
+    // NUMA node the book and its orders are allocated on, NO_NODE when the
+    // engine does not place them.
+    int node = ThreadPlacement::NO_NODE;
 
 private:
     /**
      * Prepares the order to be handled by attaching the timestamp
      * and adding dummy node into heap.
     */
-    void Prepare(std::shared_ptr<Order> order);
-    void Add(std::shared_ptr<Order> order);
-    void Execute(std::shared_ptr<Order> order);
+    void Prepare(Order & order);
+    void Add(Order & order);
+    void Execute(Order & order);
+    void ExecuteExclusive(Order & order);
+    /**
+     * Reports and destroys an order that never rests once matched.
+    */
+    void Drop(Order & order, bool filled);
     BaseBook * GetBook(Side side);
     BaseBook * GetOtherBook(Side side);
 
     Book<std::greater<price_t>> bids;
     Book<std::less<price_t>> asks;
 
-    std::mutex order_book_lock;
+    BookMutex order_book_lock;
+    std::atomic<price_t> last_trade{0};
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,101 @@
+#ifndef ORDER_INDEX_HPP
+#define ORDER_INDEX_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "order.hpp"
+
+/**
+ * Maps order ids to the orders resting in a book.
+ * 
+ * Open addressing with linear probing over a flat array, erasing by shifting
+ * the following entries back so no tombstones accumulate. Insert, Find and
+ * Erase are O(1) on average and never allocate unless the table grows.
+*/
+class OrderIndex
+{
+public:
+    OrderIndex() : slots(INITIAL_CAPACITY), size(0) { }
+
+    void Insert(order_id_t order_id, Order * order)
+    {
+        if ((size + 1) * 2 > slots.size())
+            Grow();
+
+        size_t i = Home(order_id);
+        while (slots[i].order != nullptr && slots[i].order_id != order_id)
+            i = (i + 1) & Mask();
+        if (slots[i].order == nullptr)
+            size++;
+        slots[i] = Slot{order_id, order};
+    }
+
+    Order * Find(order_id_t order_id) const
+    {
+        for (size_t i = Home(order_id); slots[i].order != nullptr; i = (i + 1) & Mask())
+            if (slots[i].order_id == order_id)
+                return slots[i].order;
+        return nullptr;
+    }
+
+    void Erase(order_id_t order_id)
+    {
+        size_t i = Home(order_id);
+        while (slots[i].order_id != order_id || slots[i].order == nullptr)
+        {
+            if (slots[i].order == nullptr)
+                return;
+            i = (i + 1) & Mask();
+        }
+
+        // Pull back every later entry of the run that may sit in the hole.
+        size_t hole = i;
+        for (size_t j = (hole + 1) & Mask(); slots[j].order != nullptr; j = (j + 1) & Mask())
+        {
+            size_t home = Home(slots[j].order_id);
+            bool reachable = hole <= j ? (home <= hole || home > j) : (home <= hole && home > j);
+            if (reachable)
+            {
+                slots[hole] = slots[j];
+                hole = j;
+            }
+        }
+        slots[hole] = Slot{};
+        size--;
+    }
+
+    size_t Size() const { return size; }
+
+private:
+    static constexpr size_t INITIAL_CAPACITY = 64;
+
+    struct Slot
+    {
+        order_id_t order_id = 0;
+        Order * order = nullptr;
+    };
+
+    size_t Mask() const { return slots.size() - 1; }
+
+    size_t Home(order_id_t order_id) const
+    {
+        // Fibonacci hashing spreads sequential ids over the table.
+        return (uint64_t(order_id) * 0x9E3779B97F4A7C15ull >> 32) & Mask();
+    }
+
+    void Grow()
+    {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        size = 0;
+        for (const Slot & slot : old)
+            if (slot.order != nullptr)
+                Insert(slot.order_id, slot.order);
+    }
+
+    std::vector<Slot> slots;
+    size_t size;
+};
+
+#endif
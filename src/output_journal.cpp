@@ -0,0 +1,338 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "command_journal.hpp"
+#include "latency_stats.hpp"
+#include "market_data.hpp"
+#include "output_journal.hpp"
+#include "risk_check.hpp"
+
+/**
+ * Ring of the calling thread, returned to the journal when the thread exits.
+*/
+struct OutputJournal::Lease
+{
+    ~Lease()
+    {
+        if (ring != nullptr)
+            ring->leased.store(false, std::memory_order_release);
+    }
+
+    OutputJournal * journal = nullptr;
+    Ring * ring = nullptr;
+};
+
+// Durable() value that what the thread appends waits for.
+static thread_local uint64_t held_until = 0;
+
+static void FlushAtExit()
+{
+    OutputJournal::Instance().Flush();
+}
+
+OutputJournal & OutputJournal::Instance()
+{
+    // Never destroyed: detached threads may still report events during exit.
+    static OutputJournal * journal = []()
+    {
+        auto * created = new OutputJournal(STDOUT_FILENO);
+        atexit(FlushAtExit);
+        return created;
+    }();
+    return *journal;
+}
+
+OutputJournal::OutputJournal(int fd) : fd(fd), buffer(new char[BUFFER_SIZE])
+{
+    thread = std::thread(&OutputJournal::writer_thread, this);
+}
+
+OutputJournal::~OutputJournal()
+{
+    stopping.store(true, std::memory_order_seq_cst);
+    sleeping.store(false, std::memory_order_relaxed);
+    sleeping.notify_one();
+    thread.join();
+}
+
+void OutputJournal::Append(Record & record)
+{
+    if (record.kind != Kind::Level && muted.load(std::memory_order_relaxed))
+        return;
+
+    int64_t start = LatencyStats::Start();
+    Ring * ring = LocalRing();
+
+    record.journaled = held_until;
+    record.sequence = issued.fetch_add(1, std::memory_order_relaxed);
+    while (!ring->records.TryPush(record))
+        std::this_thread::yield();
+
+    // Pairs with the fence in writer_thread so either the writer sees the
+    // record before parking or we see it parked.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed))
+    {
+        sleeping.store(false, std::memory_order_relaxed);
+        sleeping.notify_one();
+    }
+    LatencyStats::Record(Stage::Output, start);
+}
+
+void OutputJournal::HoldUntilDurable(uint64_t journaled)
+{
+    held_until = journaled;
+}
+
+void OutputJournal::Attach()
+{
+    LocalRing();
+}
+
+OutputJournal::Ring * OutputJournal::LocalRing()
+{
+    thread_local Lease lease;
+    if (lease.journal != this)
+    {
+        if (lease.ring != nullptr)
+            lease.ring->leased.store(false, std::memory_order_release);
+        lease.journal = this;
+        lease.ring = AcquireRing();
+    }
+    return lease.ring;
+}
+
+OutputJournal::Ring * OutputJournal::AcquireRing()
+{
+    std::unique_lock<std::mutex> l(rings_mutex);
+    for (auto & ring : rings)
+    {
+        // A ring may still hold records of its previous thread; they stay
+        // ahead of ours since the writer drains it in order.
+        bool released = false;
+        if (ring->leased.compare_exchange_strong(released, true, std::memory_order_acquire))
+            return ring.get();
+    }
+
+    // Every ring is leased, add one rather than wait for a thread to exit.
+    size_t count = rings.size();
+    RingTable * current = table.load(std::memory_order_relaxed);
+    if (current == nullptr || count == current->capacity)
+    {
+        auto grown = std::make_unique<RingTable>(current == nullptr ? INITIAL_RINGS : 2 * current->capacity);
+        for (size_t i = 0; i < count; i++)
+            grown->rings[i] = current->rings[i];
+        current = grown.get();
+        tables.push_back(std::move(grown));
+    }
+    rings.push_back(std::make_unique<Ring>());
+    current->rings[count] = rings.back().get();
+    table.store(current, std::memory_order_release);
+    ring_count.store(count + 1, std::memory_order_release);
+    return rings.back().get();
+}
+
+void OutputJournal::Flush()
+{
+    flushing.fetch_add(1, std::memory_order_seq_cst);
+    uint64_t target = issued.load(std::memory_order_seq_cst);
+    for (uint64_t done = written.load(std::memory_order_seq_cst); done < target; done = written.load(std::memory_order_seq_cst))
+        written.wait(done);
+    flushing.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void OutputJournal::writer_thread()
+{
+    uint64_t next = 0;
+    size_t last = 0;
+    while (true)
+    {
+        // Look for the next record in sequence, starting with the ring that
+        // held the previous one since threads tend to report runs of events.
+        const Record * record = nullptr;
+        size_t count = ring_count.load(std::memory_order_acquire);
+        Ring * const * scanned = count > 0 ? table.load(std::memory_order_acquire)->rings.get() : nullptr;
+        for (size_t n = 0; n < count && record == nullptr; n++)
+        {
+            size_t i = (last + n) % count;
+            const Record * front = scanned[i]->records.Front();
+            if (front != nullptr && front->sequence == next)
+            {
+                record = front;
+                last = i;
+            }
+        }
+
+        if (record != nullptr && record->journaled > 0)
+        {
+            const CommandJournal * journal = command_journal.load(std::memory_order_acquire);
+            if (journal != nullptr && journal->Durable() < record->journaled)
+            {
+                // Hand over what is ready while the journal syncs.
+                if (length > 0 || written.load(std::memory_order_relaxed) != next)
+                    WriteOut(next);
+                std::this_thread::yield();
+                continue;
+            }
+        }
+
+        if (record != nullptr)
+        {
+            if (record->kind == Kind::Level)
+            {
+                if (MarketDataFeed * feed = market_data.load(std::memory_order_acquire))
+                    feed->LevelChanged(record->symbol, record->flag, record->price, record->quantity, record->count);
+            }
+            else
+                Format(*record);
+            scanned[last]->records.Pop();
+            next++;
+            if (BUFFER_SIZE - length < MAX_LINE)
+                WriteOut(next);
+            continue;
+        }
+
+        // Caught up with what is visible, so hand the batch to the kernel.
+        // Level records print nothing but still count as written.
+        if (length > 0 || written.load(std::memory_order_relaxed) != next)
+            WriteOut(next);
+
+        if (issued.load(std::memory_order_relaxed) != next)
+        {
+            // The record was numbered but its thread has not pushed it yet.
+            std::this_thread::yield();
+            continue;
+        }
+
+        if (stopping.load(std::memory_order_relaxed))
+            return;
+
+        sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (issued.load(std::memory_order_relaxed) == next && !stopping.load(std::memory_order_relaxed))
+            sleeping.wait(true);
+        sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Writes the decimal digits of value ending right before end.
+ * 
+ * @returns Start of the digits.
+*/
+static char * FormatDigits(char * end, uint64_t value)
+{
+    do
+    {
+        *--end = char('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    return end;
+}
+
+/**
+ * Appends value and a trailing separator at out.
+ * 
+ * @returns Position after the separator.
+*/
+static char * AppendNumber(char * out, uint64_t value, char separator)
+{
+    char digits[20];
+    char * start = FormatDigits(digits + sizeof(digits), value);
+    size_t n = digits + sizeof(digits) - start;
+    memcpy(out, start, n);
+    out[n] = separator;
+    return out + n + 1;
+}
+
+static char * AppendSigned(char * out, int64_t value, char separator)
+{
+    if (value < 0)
+    {
+        *out++ = '-';
+        return AppendNumber(out, 0 - uint64_t(value), separator);
+    }
+    return AppendNumber(out, uint64_t(value), separator);
+}
+
+void OutputJournal::Format(const Record & record)
+{
+    char * out = buffer.get() + length;
+    switch (record.kind)
+    {
+        case Kind::Added: {
+            *out++ = record.flag ? 'S' : 'B';
+            *out++ = ' ';
+            out = AppendNumber(out, record.id, ' ');
+            SymbolText symbol(record.symbol);
+            size_t n = strlen(symbol.c_str());
+            memcpy(out, symbol.c_str(), n);
+            out[n] = ' ';
+            out += n + 1;
+            out = AppendNumber(out, record.price, ' ');
+            out = AppendNumber(out, record.count, ' ');
+            break;
+        }
+        case Kind::Executed:
+            *out++ = 'E';
+            *out++ = ' ';
+            out = AppendNumber(out, record.id, ' ');
+            out = AppendNumber(out, record.other_id, ' ');
+            out = AppendNumber(out, record.execution_id, ' ');
+            out = AppendNumber(out, record.price, ' ');
+            out = AppendNumber(out, record.count, ' ');
+            break;
+        case Kind::Deleted:
+            *out++ = 'X';
+            *out++ = ' ';
+            out = AppendNumber(out, record.id, ' ');
+            *out++ = record.flag ? 'A' : 'R';
+            *out++ = ' ';
+            break;
+        case Kind::Amended:
+            *out++ = 'M';
+            *out++ = ' ';
+            out = AppendNumber(out, record.id, ' ');
+            out = AppendNumber(out, record.price, ' ');
+            out = AppendNumber(out, record.count, ' ');
+            *out++ = record.flag ? 'A' : 'R';
+            *out++ = ' ';
+            break;
+        case Kind::Rejected: {
+            *out++ = 'R';
+            *out++ = ' ';
+            out = AppendNumber(out, record.id, ' ');
+            const char * reason = RejectReasonName(RejectReason(record.count));
+            size_t n = strlen(reason);
+            memcpy(out, reason, n);
+            out[n] = ' ';
+            out += n + 1;
+            break;
+        }
+        case Kind::Level:
+            return;
+    }
+    out = AppendSigned(out, record.timestamp, '\n');
+    length = out - buffer.get();
+}
+
+void OutputJournal::WriteOut(uint64_t next)
+{
+    for (size_t offset = 0; offset < length;)
+    {
+        ssize_t n = write(fd, buffer.get() + offset, length - offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        // Nowhere left to report to; drop the batch rather than stall matching.
+        if (n < 0)
+            break;
+        offset += n;
+    }
+    length = 0;
+
+    written.store(next, std::memory_order_seq_cst);
+    if (flushing.load(std::memory_order_seq_cst) > 0)
+        written.notify_all();
+}
@@ -0,0 +1,189 @@
+#ifndef OUTPUT_JOURNAL_HPP
+#define OUTPUT_JOURNAL_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.hpp"
+#include "symbol.hpp"
+
+class CommandJournal;
+class MarketDataFeed;
+
+/**
+ * Asynchronous writer of the engine's output events.
+ * 
+ * Threads reporting an event copy a fixed size record into a ring of their
+ * own and return; a writer thread formats the records and writes them in
+ * large batches. Every record takes a number from one global sequence when
+ * appended, and the writer emits records strictly in that order, so events
+ * that happen one after the other (under a book lock, or on a shard) keep
+ * that order in the output exactly as they did with a shared mutex.
+ * 
+ * The text is the same as the one produced by SyncCout and std::endl.
+ * 
+ * With a command journal attached, a record is only written once the
+ * commands its thread journaled before it are durable, so no event reaches
+ * a client for a command a crash could lose.
+*/
+class OutputJournal
+{
+public:
+    enum class Kind : uint8_t
+    {
+        Added,
+        Executed,
+        Deleted,
+        Amended,
+        // Reason in count.
+        Rejected,
+        // Totals of a price level for the market data feed, not printed.
+        Level
+    };
+
+    struct Record
+    {
+        uint64_t sequence;
+        // Value of CommandJournal::Durable() the record waits for.
+        uint64_t journaled;
+        int64_t timestamp;
+        symbol_t symbol;
+        uint32_t id;
+        // Id of the incoming order for executions.
+        uint32_t other_id;
+        uint32_t execution_id;
+        uint32_t price;
+        // Orders in the level for level records.
+        uint32_t count;
+        uint64_t quantity;
+        Kind kind;
+        // Sell side for additions and levels, accepted for deletions and amends.
+        bool flag;
+    };
+
+    /**
+     * Journal writing to standard output, flushed at exit.
+    */
+    static OutputJournal & Instance();
+
+    /**
+     * Starts a writer thread for the file descriptor.
+     * 
+     * Threads that appended must not append again once it is destroyed.
+    */
+    explicit OutputJournal(int fd);
+    ~OutputJournal();
+
+    OutputJournal(const OutputJournal &) = delete;
+    OutputJournal & operator=(const OutputJournal &) = delete;
+
+    /**
+     * Leases the calling thread's ring ahead of its first append, so that
+     * Append, which runs under book locks, never waits for the rings mutex.
+     * Threads reporting events call it when they start.
+    */
+    void Attach();
+
+    /**
+     * Queues the record, numbering it, from any thread.
+    */
+    void Append(Record & record);
+
+    /**
+     * Blocks until everything appended before the call has been written.
+    */
+    void Flush();
+
+    /**
+     * Hands level records to the feed from the writer thread, or drops them
+     * when null. Detaching is complete once a following Flush returns.
+    */
+    void AttachMarketData(MarketDataFeed * feed) { market_data.store(feed, std::memory_order_release); }
+    bool HasMarketData() const { return market_data.load(std::memory_order_relaxed) != nullptr; }
+
+    /**
+     * Holds records until the commands they follow are durable in the
+     * journal, or stops holding them when null. Detaching is complete once a
+     * following Flush returns.
+    */
+    void AttachCommandJournal(const CommandJournal * journal) { command_journal.store(journal, std::memory_order_release); }
+
+    /**
+     * Holds what the calling thread appends from now on until Durable() of
+     * the command journal reaches the value. Called by the thread executing
+     * a command once it is journaled.
+    */
+    static void HoldUntilDurable(uint64_t journaled);
+
+    /**
+     * Drops every record but level ones while muted, so that replaying a
+     * journal rebuilds the market data without printing events again.
+    */
+    void Mute(bool muted) { this->muted.store(muted, std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t INITIAL_RINGS = 64;
+    static constexpr size_t RING_CAPACITY = 1024;
+    static constexpr size_t BUFFER_SIZE = 1 << 16;
+    // Longest formatted event: a tag, five 32 bit integers and a timestamp.
+    static constexpr size_t MAX_LINE = 2 + 5 * 11 + 21;
+
+    struct Ring
+    {
+        Ring() : records(RING_CAPACITY) { }
+        SpscRing<Record> records;
+        // Held by a live thread; released rings are handed to new threads.
+        std::atomic<bool> leased{true};
+    };
+
+    /**
+     * Rings the writer scans, replaced by one twice as large when full.
+     * Replaced tables are kept, since the writer may still be scanning one.
+    */
+    struct RingTable
+    {
+        explicit RingTable(size_t capacity) : rings(new Ring *[capacity]), capacity(capacity) { }
+        std::unique_ptr<Ring *[]> rings;
+        size_t capacity;
+    };
+
+    struct Lease;
+    Ring * LocalRing();
+    Ring * AcquireRing();
+
+    void writer_thread();
+    void Format(const Record & record);
+    void WriteOut(uint64_t next);
+
+    int fd;
+
+    alignas(64) std::atomic<uint64_t> issued{0};
+    alignas(64) std::atomic<bool> sleeping{false};
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> written{0};
+    std::atomic<size_t> flushing{0};
+    std::atomic<MarketDataFeed *> market_data{nullptr};
+    std::atomic<const CommandJournal *> command_journal{nullptr};
+    std::atomic<bool> muted{false};
+
+    // Rings and tables, only touched with rings_mutex held.
+    std::mutex rings_mutex;
+    std::vector<std::unique_ptr<Ring>> rings;
+    std::vector<std::unique_ptr<RingTable>> tables;
+    // Published before ring_count, so a table loaded after the count holds
+    // at least that many rings.
+    std::atomic<RingTable *> table{nullptr};
+    std::atomic<size_t> ring_count{0};
+
+    // Only touched by the writer thread.
+    std::unique_ptr<char[]> buffer;
+    size_t length = 0;
+
+    std::thread thread;
+};
+
+#endif
@@ -0,0 +1,359 @@
+#ifndef PRICE_LADDER_HPP
+#define PRICE_LADDER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "order.hpp"
+#include "slab_pool.hpp"
+
+/**
+ * Queue of the orders resting at one price, linked through Order::prev and
+ * Order::next so queueing and unlinking never allocate.
+ * 
+ * Also keeps the totals of the level for market data. They only cover
+ * activated orders, since a dummy node is not part of the book yet.
+*/
+class Price
+{
+public:
+    uint64_t quantity() const { return visible_quantity; }
+    uint32_t orders() const { return visible_orders; }
+
+    // Maintain the totals as an order becomes visible, trades or leaves.
+    void Show(const Order & order)
+    {
+        visible_quantity += order.GetCount();
+        visible_orders++;
+    }
+    void Trade(unsigned int qty) { visible_quantity -= qty; }
+    void Hide(const Order & order)
+    {
+        visible_quantity -= order.GetCount();
+        visible_orders--;
+    }
+
+    Order * front() const { return head; }
+    bool empty() const { return head == nullptr; }
+
+    void push_back(Order & order)
+    {
+        order.prev = tail;
+        order.next = nullptr;
+        if (tail)
+            tail->next = &order;
+        else
+            head = &order;
+        tail = &order;
+    }
+
+    void pop_front() { erase(*head); }
+
+    void erase(Order & order)
+    {
+        if (order.prev)
+            order.prev->next = order.next;
+        else
+            head = order.next;
+        if (order.next)
+            order.next->prev = order.prev;
+        else
+            tail = order.prev;
+        order.prev = nullptr;
+        order.next = nullptr;
+    }
+
+private:
+    Order * head = nullptr;
+    Order * tail = nullptr;
+    uint64_t visible_quantity = 0;
+    uint32_t visible_orders = 0;
+};
+
+/*
+ * A ladder stores the price levels of one side of a book. Both ladders expose
+ * the same interface so Book can be instantiated with either:
+ *
+ *   Price * Find(price)         level at price, null if there is none
+ *   Price & GetOrAssign(price)  level at price, created if missing
+ *   void Erase(price)           reclaims an empty level
+ *   Price * First(price)        best level, its price is written to price
+ *   Price * Next(price)         first level strictly worse than price
+ *   bool Empty()
+ *
+ * Levels are visited by price instead of by iterator, so callers may erase
+ * levels or release the book lock between two steps. Level addresses are not
+ * stable across GetOrAssign of another price.
+*/
+
+/**
+ * Ladder keeping levels in an ordered map, best price first according to
+ * the comparator. Suits any price range.
+*/
+template <typename Comparator>
+class MapLadder
+{
+public:
+    Price * Find(price_t price)
+    {
+        auto it = map.find(price);
+        return it == map.end() ? nullptr : &it->second;
+    }
+
+    Price & GetOrAssign(price_t price) { return map[price]; }
+
+    void Erase(price_t price) { map.erase(price); }
+
+    Price * First(price_t & price) { return At(map.begin(), price); }
+
+    Price * Next(price_t & price) { return At(map.upper_bound(price), price); }
+
+    bool Empty() const { return map.empty(); }
+
+private:
+    // Map nodes come from a slab pool so new levels do not hit the heap.
+    typedef std::map<price_t, Price, Comparator, SlabAllocator<std::pair<const price_t, Price>>> Levels;
+
+    Price * At(typename Levels::iterator it, price_t & price)
+    {
+        if (it == map.end())
+            return nullptr;
+        price = it->first;
+        return &it->second;
+    }
+
+    Levels map;
+};
+
+/**
+ * Ladder keeping levels in a contiguous array indexed by the tick offset
+ * from a base price, with a bitmap of occupied levels and a cursor on the
+ * best one.
+ * 
+ * The window is re-based and grown as prices arrive, so its memory is
+ * proportional to the spread between the best and worst resting price.
+ * A price the window cannot take without spanning more than MAX_SPAN ticks
+ * goes to an overflow MapLadder instead, so a stray price costs a map
+ * lookup rather than an unbounded window.
+*/
+template <typename Comparator>
+class ArrayLadder
+{
+public:
+    static constexpr size_t MAX_SPAN = size_t(1) << 24;
+
+    Price * Find(price_t price)
+    {
+        if (InWindow(price) && Occupied(price - base))
+            return &levels[price - base];
+        return overflow.Empty() ? nullptr : overflow.Find(price);
+    }
+
+    Price & GetOrAssign(price_t price)
+    {
+        // A level that overflowed stays there even once the window covers it.
+        if (!overflow.Empty())
+            if (Price * level = overflow.Find(price))
+                return *level;
+        if (!InWindow(price) && !Cover(price))
+            return overflow.GetOrAssign(price);
+
+        size_t i = price - base;
+        if (!Occupied(i))
+        {
+            bitmap[i / 64] |= uint64_t(1) << (i % 64);
+            if (count++ == 0 || Better(i, best))
+                best = i;
+        }
+        return levels[i];
+    }
+
+    void Erase(price_t price)
+    {
+        if (!InWindow(price) || !Occupied(price - base))
+        {
+            if (!overflow.Empty())
+                overflow.Erase(price);
+            return;
+        }
+
+        size_t i = price - base;
+        levels[i] = Price();
+        bitmap[i / 64] &= ~(uint64_t(1) << (i % 64));
+        if (--count > 0 && i == best)
+            best = Scan(i);
+    }
+
+    Price * First(price_t & price)
+    {
+        if (overflow.Empty())
+            return count > 0 ? At(best, price) : nullptr;
+        price_t other = 0;
+        Price * spilled = overflow.First(other);
+        if (count > 0 && !Comparator()(other, price_t(base + best)))
+            return At(best, price);
+        price = other;
+        return spilled;
+    }
+
+    Price * Next(price_t & price)
+    {
+        price_t other = price;
+        Price * level = WindowNext(price);
+        if (overflow.Empty())
+            return level;
+        // The better of the next level in the window and in the overflow.
+        Price * spilled = overflow.Next(other);
+        if (spilled == nullptr || (level != nullptr && !Comparator()(other, price)))
+            return level;
+        price = other;
+        return spilled;
+    }
+
+    bool Empty() const { return count == 0 && overflow.Empty(); }
+
+private:
+    static constexpr bool DESCENDING = Comparator()(price_t(1), price_t(0));
+    static constexpr size_t NONE = ~size_t(0);
+    static constexpr size_t INITIAL_SPAN = 1024;
+
+    Price * WindowNext(price_t & price)
+    {
+        if (count == 0)
+            return nullptr;
+
+        // The level at price may have been reclaimed and the window re-based
+        // without it, in which case the whole window is on one side of it.
+        if (price < base)
+            return DESCENDING ? nullptr : At(best, price);
+        if (price - base >= levels.size())
+            return DESCENDING ? At(best, price) : nullptr;
+
+        size_t next = Scan(price - base);
+        if (next == NONE)
+            return nullptr;
+        return At(next, price);
+    }
+
+    bool InWindow(price_t price) const { return price >= base && price - base < levels.size(); }
+
+    bool Better(size_t a, size_t b) const { return DESCENDING ? a > b : a < b; }
+
+    bool Occupied(size_t i) const { return bitmap[i / 64] >> (i % 64) & 1; }
+
+    Price * At(size_t i, price_t & price)
+    {
+        price = base + i;
+        return &levels[i];
+    }
+
+    /**
+     * Finds the first occupied level strictly worse than index i.
+    */
+    size_t Scan(size_t i) const
+    {
+        if (DESCENDING)
+        {
+            if (i == 0)
+                return NONE;
+            i--;
+            size_t word = i / 64;
+            uint64_t bits = bitmap[word] & (~uint64_t(0) >> (63 - i % 64));
+            while (true)
+            {
+                if (bits)
+                    return word * 64 + 63 - __builtin_clzll(bits);
+                if (word == 0)
+                    return NONE;
+                bits = bitmap[--word];
+            }
+        }
+
+        i++;
+        if (i >= levels.size())
+            return NONE;
+        size_t word = i / 64;
+        uint64_t bits = bitmap[word] & (~uint64_t(0) << (i % 64));
+        while (true)
+        {
+            if (bits)
+                return word * 64 + __builtin_ctzll(bits);
+            if (++word == bitmap.size())
+                return NONE;
+            bits = bitmap[word];
+        }
+    }
+
+    /**
+     * Re-bases and grows the window so it covers the occupied levels and
+     * the new price, leaving slack on both sides for the price to move.
+     * 
+     * @return false, leaving the window as it is, if that would span more
+     *         than MAX_SPAN ticks.
+    */
+    bool Cover(price_t price)
+    {
+        uint64_t low = price;
+        uint64_t high = price;
+        if (count > 0)
+        {
+            low = std::min<uint64_t>(low, base + LowestOccupied());
+            high = std::max<uint64_t>(high, base + HighestOccupied());
+        }
+
+        uint64_t needed = high - low + 1;
+        if (needed > MAX_SPAN)
+            return false;
+
+        size_t span = INITIAL_SPAN;
+        while (span < needed * 2)
+            span <<= 1;
+        uint64_t new_base = low > (span - needed) / 2 ? low - (span - needed) / 2 : 0;
+
+        std::vector<Price> moved(span);
+        std::vector<uint64_t> moved_bitmap(span / 64, 0);
+        for (size_t i = 0; i < levels.size(); i++)
+        {
+            if (!Occupied(i))
+                continue;
+            size_t j = base + i - new_base;
+            moved[j] = levels[i];
+            moved_bitmap[j / 64] |= uint64_t(1) << (j % 64);
+        }
+        if (count > 0)
+            best = base + best - new_base;
+
+        levels.swap(moved);
+        bitmap.swap(moved_bitmap);
+        base = new_base;
+        return true;
+    }
+
+    size_t LowestOccupied() const
+    {
+        size_t word = 0;
+        while (bitmap[word] == 0)
+            word++;
+        return word * 64 + __builtin_ctzll(bitmap[word]);
+    }
+
+    size_t HighestOccupied() const
+    {
+        size_t word = bitmap.size() - 1;
+        while (bitmap[word] == 0)
+            word--;
+        return word * 64 + 63 - __builtin_clzll(bitmap[word]);
+    }
+
+    std::vector<Price> levels;
+    std::vector<uint64_t> bitmap;
+    uint64_t base = 0;
+    size_t best = 0;
+    size_t count = 0;
+    // Levels too far from the window, usually none.
+    MapLadder<Comparator> overflow;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include <cstring>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "reactor.hpp"
+#include "trace.hpp"
+
+static constexpr int MAX_EVENTS = 64;
+
+Reactor::Reactor(MatchingPool & pool, size_t threads) : pool(pool), next_loop(0)
+{
+    wakeup_fd = eventfd(0, EFD_NONBLOCK);
+    if (wakeup_fd == -1)
+        throw std::runtime_error("eventfd failed");
+
+    for (size_t i = 0; i < threads; i++)
+    {
+        int fd = epoll_create1(0);
+        if (fd == -1)
+            throw std::runtime_error("epoll_create1 failed");
+
+        // The wakeup fd stays readable once written, stopping every loop.
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        epoll_ctl(fd, EPOLL_CTL_ADD, wakeup_fd, &ev);
+        epoll_fds.push_back(fd);
+    }
+    for (size_t i = 0; i < threads; i++)
+        loops.emplace_back(&Reactor::loop_thread, this, i);
+}
+
+Reactor::~Reactor()
+{
+    uint64_t one = 1;
+    if (write(wakeup_fd, &one, sizeof(one)) != sizeof(one))
+        SyncCerr{} << "Failed to wake reactor" << std::endl;
+    for (auto & loop : loops)
+        loop.join();
+    for (int fd : epoll_fds)
+        close(fd);
+    close(wakeup_fd);
+}
+
+void Reactor::Register(Session * session)
+{
+    session->connection.setNonBlocking();
+
+    int fd = epoll_fds[next_loop.fetch_add(1, std::memory_order_relaxed) % epoll_fds.size()];
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = session;
+    if (epoll_ctl(fd, EPOLL_CTL_ADD, session->connection.handle(), &ev) == -1)
+    {
+        SyncCerr{} << "Failed to register connection: " << strerror(errno) << std::endl;
+        pool.Close(session);
+    }
+}
+
+void Reactor::loop_thread(size_t index)
+{
+    int epoll_fd = epoll_fds[index];
+    epoll_event events[MAX_EVENTS];
+    while (true)
+    {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            SyncCerr{} << "epoll_wait failed: " << strerror(errno) << std::endl;
+            return;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            Session * session = static_cast<Session *>(events[i].data.ptr);
+            if (session == nullptr)
+                return;
+
+            if (!ReadReady(*session))
+            {
+                // The session belongs to the matching pool from here on.
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, session->connection.handle(), nullptr);
+                pool.Close(session);
+            }
+        }
+    }
+}
+
+bool Reactor::ReadReady(Session & session)
+{
+    std::span<const ClientCommand> commands;
+    switch (session.connection.readBatch(commands))
+    {
+        case ReadResult::WouldBlock:
+            return true;
+        case ReadResult::Error:
+            SyncCerr{} << "Error reading input" << std::endl;
+            return false;
+        case ReadResult::EndOfFile:
+            TRACE(TRACE_INFO, ConnectionClosed, session.id);
+            return false;
+        case ReadResult::Success:
+            break;
+    }
+
+    if (!commands.empty())
+        pool.Submit(&session, commands);
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef REACTOR_HPP
+#define REACTOR_HPP
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "matching_pool.hpp"
+#include "session.hpp"
+
+/**
+ * Multiplexes client connections onto a fixed number of epoll threads.
+ * 
+ * Each loop reads whatever its readable connections have buffered and
+ * forwards the whole commands to the matching pool in batches. A session stays on
+ * the loop it was registered with for its entire life.
+*/
+class Reactor
+{
+public:
+    Reactor(MatchingPool & pool, size_t threads);
+    ~Reactor();
+
+    void Register(Session * session);
+
+private:
+    void loop_thread(size_t index);
+
+    /**
+     * Reads the available bytes of a readable session.
+     * 
+     * @return false once the connection reached end of file or failed.
+    */
+    bool ReadReady(Session & session);
+
+    MatchingPool & pool;
+    std::vector<int> epoll_fds;
+    int wakeup_fd;
+    std::atomic<size_t> next_loop;
+    std::vector<std::thread> loops;
+};
+
+#endif
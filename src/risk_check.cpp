@@ -0,0 +1,78 @@
+#include "risk_check.hpp"
+
+const char * RejectReasonName(RejectReason reason)
+{
+    switch (reason)
+    {
+        case RejectReason::None:
+            return "none";
+        case RejectReason::OrderSize:
+            return "order-size";
+        case RejectReason::Notional:
+            return "notional";
+        case RejectReason::Position:
+            return "position";
+        case RejectReason::OpenOrders:
+            return "open-orders";
+        case RejectReason::PriceCollar:
+            return "price-collar";
+    }
+    return "?";
+}
+
+RejectReason RiskAccount::Check(size_t book, price_t last_trade, Side side, price_t price, uint32_t count, bool market, bool adds)
+{
+    if (limits.max_order_size && count > limits.max_order_size)
+        return RejectReason::OrderSize;
+
+    // A market order is valued at the last trade, and passes unvalued before any.
+    price_t value = market ? last_trade : price;
+    if (limits.max_notional && uint64_t(value) * count > limits.max_notional)
+        return RejectReason::Notional;
+
+    if (limits.price_collar_bps && !market && last_trade > 0)
+    {
+        uint64_t distance = price > last_trade ? price - last_trade : last_trade - price;
+        if (distance * 10000 > uint64_t(last_trade) * limits.price_collar_bps)
+            return RejectReason::PriceCollar;
+    }
+
+    if (adds && limits.max_open_orders && open_orders.load(std::memory_order_relaxed) >= limits.max_open_orders)
+        return RejectReason::OpenOrders;
+
+    // Assumes every open order of the side fills, this one included. An
+    // amend is counted on top of the quantity it replaces, so it may be
+    // refused when close to the limit.
+    if (limits.max_position && book < exposures.size() && exposures[book])
+    {
+        RiskExposure & exposure = *exposures[book];
+        int64_t position = exposure.position.load(std::memory_order_relaxed);
+        int64_t open = exposure.Open(side).load(std::memory_order_relaxed) + count;
+        int64_t worst = side == Side::BUY ? position + open : open - position;
+        if (worst > int64_t(limits.max_position))
+            return RejectReason::Position;
+    }
+    else if (limits.max_position && count > limits.max_position)
+        return RejectReason::Position;
+
+    return RejectReason::None;
+}
+
+RiskExposure & RiskAccount::Exposure(size_t book)
+{
+    if (book >= exposures.size())
+        exposures.resize(book + 1);
+    if (!exposures[book])
+    {
+        exposures[book] = std::make_unique<RiskExposure>();
+        exposures[book]->account = this;
+    }
+    return *exposures[book];
+}
+
+void RiskAccount::Accepted(Order & order, RiskExposure & exposure)
+{
+    open_orders.fetch_add(1, std::memory_order_relaxed);
+    exposure.Open(order.GetSide()).fetch_add(order.GetCount(), std::memory_order_relaxed);
+    order.SetRisk(&exposure);
+}
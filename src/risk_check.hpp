@@ -0,0 +1,100 @@
+#ifndef RISK_CHECK_HPP
+#define RISK_CHECK_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "options.hpp"
+#include "order.hpp"
+
+class RiskAccount;
+
+/**
+ * Why the pre-trade checks rejected an order, see RiskAccount.
+*/
+enum class RejectReason : uint8_t
+{
+    None,
+    OrderSize,
+    Notional,
+    Position,
+    OpenOrders,
+    PriceCollar
+};
+
+const char * RejectReasonName(RejectReason reason);
+
+/**
+ * What one connection has at stake in one instrument.
+ * 
+ * The connection's thread adds to it when an order is accepted; the threads
+ * matching the instrument take away as the connection's orders trade or
+ * leave the book. Only this connection's orders update it, so its cache
+ * line is not shared with other clients.
+*/
+struct RiskExposure
+{
+    // Quantity traded, bought minus sold.
+    std::atomic<int64_t> position{0};
+    // Unfilled quantity of the open orders, by side.
+    std::atomic<int64_t> open_buy{0};
+    std::atomic<int64_t> open_sell{0};
+    RiskAccount * account = nullptr;
+
+    std::atomic<int64_t> & Open(Side side) { return side == Side::BUY ? open_buy : open_sell; }
+};
+
+/**
+ * Pre-trade limits of one connection, checked before its orders reach a
+ * book.
+ * 
+ * Everything the checks read is kept per connection, so checking takes no
+ * lock and shares no cache line with other connections; the last trade
+ * price of the instrument is the only shared value, read without a lock.
+ * 
+ * Position limits count open orders as if they fill, so a connection can
+ * never exceed them however its orders trade. Accounts outlive their
+ * connection, since its orders keep resting and trading after it closes.
+*/
+class RiskAccount
+{
+public:
+    explicit RiskAccount(const RiskLimits & limits) : limits(limits) { }
+
+    RiskAccount(const RiskAccount &) = delete;
+    RiskAccount & operator=(const RiskAccount &) = delete;
+
+    /**
+     * Checks an order, or an amend when adds is false.
+     * 
+     * @param book Id of the instrument's OrderBook.
+     * @param last_trade Last trade price of the instrument, 0 if none yet.
+     * @param market Whether price is ignored, so the notional is taken at
+     *               the last trade price and no collar applies.
+    */
+    RejectReason Check(
+        size_t book, price_t last_trade, Side side, price_t price, uint32_t count, bool market, bool adds);
+
+    /**
+     * Exposure in the instrument, made the first time it is needed. Only
+     * for the connection's thread, the address is stable.
+    */
+    RiskExposure & Exposure(size_t book);
+
+    /**
+     * Counts an accepted order as open until it is destroyed.
+    */
+    void Accepted(Order & order, RiskExposure & exposure);
+    void Closed() { open_orders.fetch_sub(1, std::memory_order_relaxed); }
+
+    uint32_t OpenOrders() const { return open_orders.load(std::memory_order_relaxed); }
+
+private:
+    RiskLimits limits;
+    std::vector<std::unique_ptr<RiskExposure>> exposures;
+    std::atomic<uint32_t> open_orders{0};
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include <unordered_map>
+
+#include "io.hpp"
+#include "latency_stats.hpp"
+#include "order.hpp"
+#include "order_book.hpp"
+#include "risk_check.hpp"
+#include "slab_pool.hpp"
+
+/**
+ * What a session remembers about an order it submitted, enough to route a
+ * cancel to the book the order rests in.
+*/
+struct OrderRef
+{
+    OrderBook * book;
+    Side side;
+};
+
+/**
+ * State belonging to a single client connection.
+ * 
+ * All commands of a session are handled by one thread at a time, so
+ * the orders map is never accessed concurrently.
+*/
+struct Session
+{
+    Session(ClientConnection connection, size_t id) : connection(std::move(connection)), id(id)
+    {
+        LatencyStats::Instance().OpenConnection(id);
+    }
+    ~Session() { LatencyStats::Instance().CloseConnection(id); }
+
+    ClientConnection connection;
+    std::unordered_map<
+        order_id_t,
+        OrderRef,
+        std::hash<order_id_t>,
+        std::equal_to<order_id_t>,
+        SlabAllocator<std::pair<const order_id_t, OrderRef>>>
+        orders;
+    size_t id;
+    // Owned by the Engine, which attaches it on the first order when limits are set.
+    RiskAccount * risk = nullptr;
+
+    // Client the session's orders belong to, never Order::NO_CLIENT.
+    client_id_t Client() const { return client_id_t(id + 1); }
+};
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef SLAB_POOL_HPP
+#define SLAB_POOL_HPP
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "numa_placement.hpp"
+
+/**
+ * Allocator of fixed size slots carved out of large slabs.
+ * 
+ * Every thread allocates from and frees into its own free list without
+ * synchronisation. Lists exchange batches of slots with a shared depot when
+ * they run dry or grow too long, so memory freed on one thread (a resting
+ * order filled by another connection) flows back to the allocating threads.
+ * Slabs are never returned to the system.
+ * 
+ * Slots of a NUMA node come from slabs of its NodeArena and go through free
+ * lists and a depot of their own. A slot is freed to the node of the thread
+ * freeing it, which for the threads placed with an owning node is the node
+ * the slot came from.
+*/
+template <size_t Size, size_t Align>
+class SlabPool
+{
+public:
+    /**
+     * Allocates a slot of the calling thread's node.
+    */
+    static void * Allocate() { return Allocate(ThreadPlacement::CurrentNode()); }
+
+    /**
+     * @param node NUMA node of the slot, NO_NODE for wherever the memory
+     *             is first touched.
+    */
+    static void * Allocate(int node)
+    {
+        Cache & cache = local.For(node);
+        if (cache.head == nullptr)
+            Refill(cache);
+
+        Slot * slot = cache.head;
+        cache.head = slot->next;
+        cache.size--;
+        return slot;
+    }
+
+    static void Free(void * p)
+    {
+        Cache & cache = local.For(ThreadPlacement::CurrentNode());
+        Slot * slot = static_cast<Slot *>(p);
+        slot->next = cache.head;
+        cache.head = slot;
+        if (++cache.size >= 2 * BATCH)
+            Spill(cache);
+    }
+
+private:
+    static constexpr size_t BATCH = 64;
+    static constexpr size_t SLAB_SLOTS = 16 * BATCH;
+
+    union Slot
+    {
+        Slot * next;
+        alignas(Align) unsigned char storage[Size];
+    };
+
+    // Slots of nodes beyond NodeArena::MAX_NODES are left unplaced.
+    static constexpr size_t LISTS = NodeArena::MAX_NODES + 1;
+
+    static size_t List(int node) { return node >= 0 && node < NodeArena::MAX_NODES ? node + 1 : 0; }
+
+    struct Cache
+    {
+        Slot * head = nullptr;
+        size_t size = 0;
+        // Index of the list in the depot, see List.
+        size_t list = 0;
+
+        // Slots of an exiting thread go back to the depot.
+        ~Cache()
+        {
+            while (size > 0)
+                Spill(*this);
+        }
+    };
+
+    struct Caches
+    {
+        Caches()
+        {
+            for (size_t i = 0; i < LISTS; i++)
+                lists[i].list = i;
+        }
+
+        Cache & For(int node) { return lists[List(node)]; }
+
+        Cache lists[LISTS];
+    };
+
+    struct Depot
+    {
+        std::mutex mutex;
+        // Chains of up to BATCH slots linked through Slot::next.
+        std::vector<std::pair<Slot *, size_t>> chains;
+    };
+
+    static Depot & depot(size_t list)
+    {
+        // Never destroyed so that thread caches may spill into it during exit.
+        static Depot * d = new Depot[LISTS];
+        return d[list];
+    }
+
+    static void Refill(Cache & cache)
+    {
+        Depot & d = depot(cache.list);
+        std::unique_lock<std::mutex> l(d.mutex);
+        if (!d.chains.empty())
+        {
+            auto [head, size] = d.chains.back();
+            d.chains.pop_back();
+            cache.head = head;
+            cache.size = size;
+            return;
+        }
+        l.unlock();
+
+        Slot * slab = static_cast<Slot *>(cache.list == 0
+                ? ::operator new(sizeof(Slot) * SLAB_SLOTS, std::align_val_t(alignof(Slot)))
+                : NodeArena::Allocate(sizeof(Slot) * SLAB_SLOTS, alignof(Slot), int(cache.list) - 1));
+        for (size_t i = 0; i < SLAB_SLOTS; i++)
+            slab[i].next = (i + 1) % BATCH != 0 ? &slab[i + 1] : nullptr;
+
+        // The cache takes one batch and the depot the others, so the cache
+        // stays below the spill threshold and the next Free does not spill.
+        cache.head = slab;
+        cache.size = BATCH;
+        l.lock();
+        for (size_t i = BATCH; i < SLAB_SLOTS; i += BATCH)
+            d.chains.emplace_back(&slab[i], BATCH);
+    }
+
+    /**
+     * Moves the batch freed longest ago to the depot, keeping the most
+     * recently freed slots, still warm in the CPU cache, for reuse.
+    */
+    static void Spill(Cache & cache)
+    {
+        size_t keep = cache.size > BATCH ? cache.size - BATCH : 0;
+        Slot * head = cache.head;
+        Slot * last = nullptr;
+        for (size_t i = 0; i < keep; i++)
+        {
+            last = head;
+            head = head->next;
+        }
+        if (last != nullptr)
+            last->next = nullptr;
+        else
+            cache.head = nullptr;
+        size_t size = cache.size - keep;
+        cache.size = keep;
+
+        Depot & d = depot(cache.list);
+        std::unique_lock<std::mutex> l(d.mutex);
+        d.chains.emplace_back(head, size);
+    }
+
+    static thread_local Caches local;
+};
+
+template <size_t Size, size_t Align>
+thread_local typename SlabPool<Size, Align>::Caches SlabPool<Size, Align>::local;
+
+/**
+ * Standard allocator drawing single objects from a SlabPool, for node based
+ * containers. Arrays, such as hash buckets, still come from operator new.
+*/
+template <typename T>
+struct SlabAllocator
+{
+    typedef T value_type;
+
+    SlabAllocator() = default;
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U> &)
+    {
+    }
+
+    T * allocate(size_t n)
+    {
+        if (n == 1)
+            return static_cast<T *>(SlabPool<sizeof(T), alignof(T)>::Allocate());
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+    }
+
+    void deallocate(T * p, size_t n)
+    {
+        if (n == 1)
+            SlabPool<sizeof(T), alignof(T)>::Free(p);
+        else
+            ::operator delete(p, std::align_val_t(alignof(T)));
+    }
+
+    template <typename U>
+    bool operator==(const SlabAllocator<U> &) const
+    {
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+/**
+ * Bounded lock-free ring for a single producer and a single consumer.
+ * 
+ * Each side owns one counter and only reads the other's, so neither ever
+ * writes a cache line the other writes. The consumer reads values in place
+ * through Front and releases them with Pop.
+*/
+template <typename T>
+class SpscRing
+{
+public:
+    /**
+     * @param capacity Rounded up to the next power of two.
+    */
+    explicit SpscRing(size_t capacity) : tail(0), head(0)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        mask = size - 1;
+        slots = std::make_unique<T[]>(size);
+    }
+
+    /**
+     * Only called by the producer thread.
+    */
+    bool TryPush(const T & value)
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        if (pos - head.load(std::memory_order_acquire) > mask)
+            return false;
+
+        slots[pos & mask] = value;
+        tail.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Oldest value, null when the ring is empty. Only called by the consumer.
+    */
+    const T * Front() const
+    {
+        size_t pos = head.load(std::memory_order_relaxed);
+        if (pos == tail.load(std::memory_order_acquire))
+            return nullptr;
+        return &slots[pos & mask];
+    }
+
+    /**
+     * Releases the value returned by Front. Only called by the consumer.
+    */
+    void Pop() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+private:
+    alignas(64) std::atomic<size_t> tail;
+    alignas(64) std::atomic<size_t> head;
+    size_t mask;
+    std::unique_ptr<T[]> slots;
+};
+
+#endif
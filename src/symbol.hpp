@@ -0,0 +1,34 @@
+#ifndef SYMBOL_HPP
+#define SYMBOL_HPP
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * An instrument symbol packed into a single word.
+ * 
+ * The wire format caps symbols at 8 characters, so the bytes of the
+ * symbol, zero padded, fit in a uint64_t and compare as one integer.
+*/
+typedef uint64_t symbol_t;
+
+inline symbol_t PackSymbol(const char * instrument)
+{
+    symbol_t symbol = 0;
+    memcpy(&symbol, instrument, strnlen(instrument, sizeof(symbol_t)));
+    return symbol;
+}
+
+/**
+ * Null terminated text of a packed symbol, for output.
+*/
+struct SymbolText
+{
+    explicit SymbolText(symbol_t symbol) { memcpy(text, &symbol, sizeof(symbol_t)); }
+    const char * c_str() const { return text; }
+
+private:
+    char text[sizeof(symbol_t) + 1] = {};
+};
+
+#endif
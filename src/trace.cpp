@@ -0,0 +1,198 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "trace.hpp"
+
+static const TraceEventInfo EVENTS[] = {
+    {"buy received", {"id", "symbol", "price", "count"}, 1},
+    {"sell received", {"id", "symbol", "price", "count"}, 1},
+    {"cancel received", {"id", nullptr, nullptr, nullptr}, -1},
+    {"connection closed", {"session", nullptr, nullptr, nullptr}, -1},
+    {"match waiting", {"id", "resting", "price", nullptr}, -1},
+    {"cancel waiting", {"id", nullptr, nullptr, nullptr}, -1},
+    {"amend received", {"id", "price", "count", nullptr}, -1},
+    {"amend waiting", {"id", nullptr, nullptr, nullptr}, -1},
+    {"self-trade prevented", {"id", "resting", "mode", nullptr}, -1},
+};
+static_assert(sizeof(EVENTS) / sizeof(EVENTS[0]) == size_t(TraceEvent::Count), "every event needs a description");
+
+static int TraceFile()
+{
+    static int fd = []()
+    {
+        const char * path = getenv("ENGINE_TRACE_FILE");
+        return open(path != nullptr ? path : "engine.trace", O_WRONLY | O_CREAT | O_APPEND, 0644);
+    }();
+    return fd;
+}
+
+namespace
+{
+/**
+ * Entries of one thread, written out as a whole so threads never interleave
+ * within a block.
+ * 
+ * Only the owner appends, publishing each entry through used, so the exit
+ * hook can write out what a thread still running has buffered. Writing out
+ * takes the mutex, and entries written by the hook are skipped by the
+ * owner's next flush.
+*/
+struct TraceBuffer
+{
+    static constexpr size_t CAPACITY = 1024;
+
+    void Flush()
+    {
+        std::unique_lock<std::mutex> l(mutex);
+        size_t end = used.load(std::memory_order_acquire);
+        if (end > flushed && write(TraceFile(), entries + flushed, (end - flushed) * sizeof(TraceEntry)) < 0)
+        {
+            // Tracing is best effort; the entries are dropped.
+        }
+        flushed = end;
+        // Only the owner may start over, another thread only skips ahead.
+        if (end == CAPACITY || owner == std::this_thread::get_id())
+        {
+            used.store(0, std::memory_order_relaxed);
+            flushed = 0;
+        }
+    }
+
+    uint32_t thread = 0;
+    std::thread::id owner;
+    std::atomic<size_t> used{0};
+    std::mutex mutex;
+    size_t flushed = 0;
+    // Released by its thread on exit, for the next thread to take.
+    bool leased = false;
+    TraceEntry entries[CAPACITY];
+};
+
+/**
+ * Every buffer ever made, never freed, so the exit hook can reach those of
+ * threads still running.
+*/
+struct TraceBuffers
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    uint32_t next_thread = 0;
+};
+}
+
+static void FlushAtExit();
+
+static TraceBuffers & Buffers()
+{
+    // Never destroyed: detached threads may still trace during exit.
+    static TraceBuffers * buffers = []()
+    {
+        auto * created = new TraceBuffers();
+        atexit(FlushAtExit);
+        return created;
+    }();
+    return *buffers;
+}
+
+static void FlushAtExit()
+{
+    TraceBuffers & all = Buffers();
+    std::unique_lock<std::mutex> l(all.mutex);
+    for (auto & buffer : all.buffers)
+        buffer->Flush();
+}
+
+static TraceBuffer * AcquireBuffer()
+{
+    TraceBuffers & all = Buffers();
+    std::unique_lock<std::mutex> l(all.mutex);
+    TraceBuffer * buffer = nullptr;
+    for (auto & released : all.buffers)
+        if (!released->leased)
+        {
+            buffer = released.get();
+            break;
+        }
+    if (buffer == nullptr)
+    {
+        all.buffers.push_back(std::make_unique<TraceBuffer>());
+        buffer = all.buffers.back().get();
+    }
+    buffer->leased = true;
+    buffer->owner = std::this_thread::get_id();
+    buffer->thread = all.next_thread++;
+    return buffer;
+}
+
+/**
+ * Buffer of the calling thread, taken on first use so threads that never
+ * trace do not hold one, and written out and released when it exits.
+*/
+struct TraceLease
+{
+    ~TraceLease()
+    {
+        if (buffer == nullptr)
+            return;
+        buffer->Flush();
+        std::unique_lock<std::mutex> l(Buffers().mutex);
+        buffer->leased = false;
+    }
+
+    TraceBuffer * buffer = nullptr;
+};
+
+static thread_local TraceLease local;
+
+void Trace::Write(int level, TraceEvent event, uint64_t a, uint64_t b, uint64_t c, uint64_t d)
+{
+    if (local.buffer == nullptr)
+        local.buffer = AcquireBuffer();
+    TraceBuffer & buffer = *local.buffer;
+    size_t used = buffer.used.load(std::memory_order_relaxed);
+    TraceEntry & entry = buffer.entries[used];
+    entry.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    entry.thread = buffer.thread;
+    entry.event = event;
+    entry.level = level;
+    entry.args[0] = a;
+    entry.args[1] = b;
+    entry.args[2] = c;
+    entry.args[3] = d;
+    buffer.used.store(used + 1, std::memory_order_release);
+    if (used + 1 == TraceBuffer::CAPACITY)
+        buffer.Flush();
+}
+
+void Trace::Flush()
+{
+    if (local.buffer != nullptr)
+        local.buffer->Flush();
+}
+
+const TraceEventInfo & Trace::Describe(TraceEvent event)
+{
+    return EVENTS[size_t(event)];
+}
+
+const char * Trace::LevelName(int level)
+{
+    switch (level)
+    {
+        case TRACE_ERROR:
+            return "ERROR";
+        case TRACE_INFO:
+            return "INFO";
+        case TRACE_DEBUG:
+            return "DEBUG";
+        default:
+            return "?";
+    }
+}
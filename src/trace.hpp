@@ -0,0 +1,86 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstdint>
+
+/**
+ * Structured tracing with levels fixed at compile time.
+ * 
+ * TRACE(level, event, args...) records a binary entry of up to four integer
+ * arguments in a buffer of the calling thread, which is appended to the
+ * trace file (ENGINE_TRACE_FILE, default engine.trace) when it fills up,
+ * when the thread exits, and at process exit for threads still running,
+ * such as pool workers and shards. build/trace_decode turns the file back
+ * into text. Entries above TRACE_LEVEL are discarded at compile time:
+ * neither the call nor its arguments generate any code.
+ * 
+ * Build with `make TRACE=<level>` to enable them.
+*/
+#define TRACE_OFF 0
+#define TRACE_ERROR 1
+#define TRACE_INFO 2
+#define TRACE_DEBUG 3
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TRACE_OFF
+#endif
+
+#define TRACE(level, event, ...)                                                                                                   \
+    do                                                                                                                             \
+    {                                                                                                                              \
+        if constexpr ((level) <= TRACE_LEVEL)                                                                                      \
+            Trace::Write((level), TraceEvent::event __VA_OPT__(, ) __VA_ARGS__);                                                   \
+    } while (0)
+
+enum class TraceEvent : uint16_t
+{
+    BuyReceived,
+    SellReceived,
+    CancelReceived,
+    ConnectionClosed,
+    MatchWaiting,
+    CancelWaiting,
+    AmendReceived,
+    AmendWaiting,
+    SelfTradePrevented,
+    Count
+};
+
+/**
+ * Layout of an entry in the trace file.
+*/
+struct TraceEntry
+{
+    int64_t timestamp;
+    uint32_t thread;
+    TraceEvent event;
+    uint16_t level;
+    uint64_t args[4];
+};
+
+/**
+ * How the decoder prints an event.
+*/
+struct TraceEventInfo
+{
+    const char * name;
+    // Labels of the arguments in use, null for unused ones.
+    const char * args[4];
+    // Index of an argument holding a packed symbol, -1 if none.
+    int symbol;
+};
+
+namespace Trace
+{
+void Write(int level, TraceEvent event, uint64_t a = 0, uint64_t b = 0, uint64_t c = 0, uint64_t d = 0);
+
+/**
+ * Appends the entries buffered by the calling thread to the trace file.
+*/
+void Flush();
+
+const TraceEventInfo & Describe(TraceEvent event);
+const char * LevelName(int level);
+}
+
+#endif
@@ -0,0 +1,57 @@
+// Prints the binary trace written by an engine built with tracing enabled,
+// ordered by time.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <vector>
+
+#include "symbol.hpp"
+#include "trace.hpp"
+
+int main(int argc, char * argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <trace file>...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<TraceEntry> entries;
+    for (int i = 1; i < argc; i++)
+    {
+        FILE * file = fopen(argv[i], "rb");
+        if (file == nullptr)
+        {
+            perror(argv[i]);
+            return 1;
+        }
+        TraceEntry entry;
+        while (fread(&entry, sizeof(entry), 1, file) == 1)
+            entries.push_back(entry);
+        fclose(file);
+    }
+
+    // Threads append whole buffers, so entries are only ordered per thread.
+    std::stable_sort(
+        entries.begin(), entries.end(), [](const TraceEntry & a, const TraceEntry & b) { return a.timestamp < b.timestamp; });
+
+    for (const TraceEntry & entry : entries)
+    {
+        if (entry.event >= TraceEvent::Count)
+        {
+            fprintf(stderr, "Unknown event %u, is the trace from another build?\n", unsigned(entry.event));
+            return 1;
+        }
+
+        const TraceEventInfo & info = Trace::Describe(entry.event);
+        printf("%" PRId64 " [%u] %-5s %s", entry.timestamp, entry.thread, Trace::LevelName(entry.level), info.name);
+        for (int i = 0; i < 4 && info.args[i] != nullptr; i++)
+            if (i == info.symbol)
+                printf(" %s=%s", info.args[i], SymbolText(entry.args[i]).c_str());
+            else
+                printf(" %s=%" PRIu64, info.args[i], entry.args[i]);
+        printf("\n");
+    }
+    return 0;
+}
@@ -1,47 +1,93 @@
-#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 #include <vector>
 
-int main(int argc, char **argv)
+#include "../../bench/workload.hpp"
+
+char usage[] = "./test_generator [--key=value ...]\n"
+               "       ./test_generator <tests> <instruments> <commands>\n"
+               "\t example: ./test_generator --tests=1 --commands=10000000 --clients=400 --binary=1";
+
+struct Config
 {
-    std::string path = "";
+    int tests = 1;
+    long commands = 10000;
+    // Write raw ClientCommand records to <n>.bin instead of <n>.in text.
+    bool binary = false;
+    WorkloadConfig workload;
+};
 
-    int test_count = std::stoi(argv[1]);
-    int ticker_count = std::stoi(argv[2]);
-    int command_count = std::stoi(argv[3]);
+static bool ParseConfig(int argc, char ** argv, Config & config)
+{
+    if (argc == 4 && strncmp(argv[1], "--", 2) != 0)
+    {
+        config.tests = std::stoi(argv[1]);
+        config.workload.instruments = std::stoi(argv[2]);
+        config.commands = std::stol(argv[3]);
+        return true;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (ParseWorkloadOption(argv[i], config.workload))
+            continue;
+        const char * eq = strchr(argv[i], '=');
+        if (strncmp(argv[i], "--", 2) != 0 || eq == nullptr)
+            return false;
+        std::string key(argv[i] + 2, eq - argv[i] - 2);
+        const char * value = eq + 1;
+        if (key == "tests")
+            config.tests = atoi(value);
+        else if (key == "commands")
+            config.commands = atol(value);
+        else if (key == "binary")
+            config.binary = atoi(value) != 0;
+        else
+            return false;
+    }
+    return true;
+}
 
-    for (int i = 0; i < test_count; i++)
+int main(int argc, char ** argv)
+{
+    Config config;
+    if (!ParseConfig(argc, argv, config))
     {
-        // create file
-        std::string test_name = std::to_string(i) + ".in";
-        std::ofstream test_file;
-        test_file.open(path + test_name);
+        fprintf(stderr, "%s\n", usage);
+        return EXIT_FAILURE;
+    }
 
-        int order_id = 1;
-        std::vector<std::vector<int>> threadToIds(40);
+    for (int i = 0; i < config.tests; i++)
+    {
+        std::string test_name = std::to_string(i) + (config.binary ? ".bin" : ".in");
+        FILE * test_file = fopen(test_name.c_str(), "w");
+        if (test_file == nullptr)
+        {
+            perror(test_name.c_str());
+            return EXIT_FAILURE;
+        }
+        std::vector<char> buffer(1 << 20);
+        setvbuf(test_file, buffer.data(), _IOFBF, buffer.size());
 
-        test_file << 40 << std::endl;
-        test_file << "o" << std::endl;
-        for (int j = 0; j < command_count; j++)
+        Workload workload(config.workload, config.workload.seed + i);
+        if (!config.binary)
+            fprintf(test_file, "%d\no\n", config.workload.clients);
+        for (long j = 0; j < config.commands; j++)
         {
-            int thread = rand() % 40;
-            int buy_or_sell_or_canc = rand() % 3;
-            int ticker = rand() % ticker_count;
-
-            if (buy_or_sell_or_canc == 2)
-            {
-                if (threadToIds[thread].empty())
-                    continue;
-                test_file << thread << " C " << threadToIds[thread][rand() % threadToIds[thread].size()] << std::endl;
-                continue;
-            }
-
-            int id = order_id++;
-            threadToIds[thread].push_back(id);
-            test_file << thread << (buy_or_sell_or_canc == 0 ? " B " : " S ") << id << " " << ticker << " " << (rand() % 100 + 1) << " "
-                      << (rand() % 100 + 1) << std::endl;
+            ClientCommand cmd;
+            int client;
+            workload.Next(cmd, client);
+            if (config.binary)
+                fwrite(&cmd, sizeof(cmd), 1, test_file);
+            else if (cmd.type == input_cancel)
+                fprintf(test_file, "%d C %u\n", client, cmd.order_id);
+            else
+                fprintf(test_file, "%d %c %u %s %u %u\n", client, cmd.type, cmd.order_id, cmd.instrument, cmd.price, cmd.count);
         }
-        test_file << "x" << std::endl;
-        test_file.close();
+        if (!config.binary)
+            fprintf(test_file, "x\n");
+        fclose(test_file);
     }
 }
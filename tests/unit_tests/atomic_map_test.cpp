@@ -1,14 +1,15 @@
-#define private public
+#include <atomic>
 #include <chrono>
 #include <iostream>
+#include <latch>
+#include <mutex>
+#include <set>
 #include <string>
 #include <thread>
 #include <vector>
 #include <assert.h>
 
 #include "../../src/atomic_map.hpp"
-#include "../../src/order.hpp"
-#include "../../src/order_book.hpp"
 
 struct test
 {
@@ -77,66 +78,207 @@ bool test_get_multiple_thread()
     return true;
 }
 
-bool test_sort_atomic_map_no_sorter()
+bool test_for_each()
 {
-    std::cout << "\nStarting [test_sort_atomic_map_no_sorter]\n";
-    AtomicMap<int, char> map;
-    map.Get(8);
-    map.Get(2);
-    map.Get(5);
-    map.Get(9);
-    map.Get(1);
-    int last = -1;
-    for (auto [_, v] : map.map)
-        if (last > v)
-            return false;
-        else
-            last = v;
-    std::cout << "Ending [test_sort_atomic_map_no_sorter]\n\n";
-    return true;
+    std::cout << "\nStarting [test_for_each]\n";
+    AtomicMap<int, int> map;
+    for (int i = 0; i < 100; i++)
+        map.Insert(i, i * 2);
+    bool ok = !map.Insert(5, 0).second && map.Erase(5) == 1 && map.Erase(5) == 0 && map.Find(5) == nullptr;
+    std::set<int> keys;
+    map.ForEach(
+        [&](int key, int value)
+        {
+            ok = ok && value == key * 2;
+            keys.insert(key);
+        });
+    ok = ok && keys.size() == 99 && map.Size() == 99 && !keys.count(5);
+    std::cout << "Ending [test_for_each]\n\n";
+    return ok;
 }
 
-bool test_sort_atomic_map_greater_sort()
+bool test_concurrent_insert_find()
 {
-    std::cout << "\nStarting [test_sort_atomic_map_greater_sort]\n";
-    AtomicMap<int, char, std::greater<int>> map;
-    map.Get(8);
-    map.Get(2);
-    map.Get(5);
-    map.Get(9);
-    map.Get(1);
-    int last = -1;
-    for (auto [_, v] : map.map)
+    std::cout << "\nStarting [test_concurrent_insert_find]\n";
+    constexpr int KEYS = 20000;
+    constexpr int THREADS = 4;
+    // Starting small makes the threads race with many growths.
+    AtomicMap<int, int> map(16);
+    std::vector<std::vector<int *>> seen(THREADS, std::vector<int *>(KEYS));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++)
+        threads.emplace_back(
+            [&, t]()
+            {
+                // Every thread inserts all keys, starting at its own offset.
+                for (int n = 0; n < KEYS; n++)
+                {
+                    int key = (n + t * KEYS / THREADS) % KEYS;
+                    int * value = map.Insert(key, key).first;
+                    int * found = map.Find(key);
+                    seen[t][key] = found == value ? value : nullptr;
+                }
+            });
+    for (auto & thread : threads)
+        thread.join();
+
+    bool ok = map.Size() == KEYS;
+    for (int key = 0; key < KEYS && ok; key++)
     {
-        {
-            if (last == -1 || last >= v)
-                last = v;
-            else
-                return false;
-        }
+        // Values never move, so every thread saw the one the map still holds.
+        int * value = map.Find(key);
+        ok = value != nullptr && *value == key;
+        for (int t = 0; t < THREADS && ok; t++)
+            ok = seen[t][key] == value;
     }
-    std::cout << "Ending [test_sort_atomic_map_greater_sort]\n\n";
-    return true;
+    std::cout << "Ending [test_concurrent_insert_find]\n\n";
+    return ok;
 }
 
-bool test_iterators()
+bool test_concurrent_erase()
 {
-    std::cout << "\nStarting [test_iterators]\n";
-    AtomicMap<int, char> map;
-    map.Get(5);
-    map.Get(2);
-    map.Get(3);
-    map.Get(1);
-    std::vector<int> answers({1, 2, 3, 5});
-    int i = 0;
-    for (auto s = map.begin(); s != map.end(); s++)
+    std::cout << "\nStarting [test_concurrent_erase]\n";
+    constexpr int KEYS = 10000;
+    AtomicMap<int, int> map;
+    for (int key = 0; key < KEYS; key++)
+        map.Insert(key, key);
+
+    // Readers check that a value they find is intact while odd keys are
+    // erased and new keys inserted, growing the table under them.
+    std::atomic<bool> done{false};
+    std::atomic<bool> ok{true};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; t++)
+        readers.emplace_back(
+            [&]()
+            {
+                while (!done.load())
+                    for (int key = 0; key < KEYS; key++)
+                    {
+                        int * value = map.Find(key);
+                        if (key % 2 == 0 ? value == nullptr || *value != key : value != nullptr && *value != key)
+                            ok.store(false);
+                    }
+            });
+    for (int key = 1; key < KEYS; key += 2)
+        map.Erase(key);
+    for (int key = KEYS; key < 4 * KEYS; key++)
+        map.Insert(key, key);
+    done.store(true);
+    for (auto & reader : readers)
+        reader.join();
+
+    bool erased = map.Size() == KEYS / 2 + 3 * KEYS;
+    for (int key = 0; key < KEYS && erased; key++)
+        erased = (map.Find(key) == nullptr) == (key % 2 == 1);
+    std::cout << "Ending [test_concurrent_erase]\n\n";
+    return ok.load() && erased;
+}
+
+bool test_reclamation()
+{
+    std::cout << "\nStarting [test_reclamation]\n";
+    EpochReclaimer & reclaimer = EpochReclaimer::Instance();
+    bool ok;
     {
-        if (s->first != answers[i])
-            return false;
-        i++;
+        AtomicMap<int, std::string> map;
+        for (int key = 0; key < 1000; key++)
+            map.Insert(key, std::to_string(key));
+        for (int key = 0; key < 1000; key += 2)
+            map.Erase(key);
+
+        // A guard held by another thread keeps everything retired since from being freed.
+        std::atomic<bool> entered{false};
+        std::atomic<bool> leave{false};
+        std::thread reader(
+            [&]()
+            {
+                EpochReclaimer::Guard guard;
+                entered.store(true);
+                while (!leave.load())
+                    std::this_thread::yield();
+            });
+        while (!entered.load())
+            std::this_thread::yield();
+        map.Erase(1);
+        for (int i = 0; i < 4; i++)
+            reclaimer.Collect();
+        ok = reclaimer.Pending() > 0 && map.Find(3) != nullptr && *map.Find(3) == "3";
+        leave.store(true);
+        reader.join();
     }
-    std::cout << "Ending [test_iterators]\n\n";
-    return true;
+    // With no guard held, two advances of the epoch free the rest.
+    for (int i = 0; i < 4; i++)
+        reclaimer.Collect();
+    ok = ok && reclaimer.Pending() == 0;
+    std::cout << "Ending [test_reclamation]\n\n";
+    return ok;
+}
+
+bool test_many_threads()
+{
+    std::cout << "\nStarting [test_many_threads]\n";
+    EpochReclaimer & reclaimer = EpochReclaimer::Instance();
+    std::atomic<bool> leave{false};
+    std::atomic<bool> release{false};
+    std::vector<std::thread> threads;
+
+    // A block of threads that stay registered without holding a guard...
+    std::latch registered(EpochReclaimer::BLOCK_SLOTS);
+    for (size_t t = 0; t < EpochReclaimer::BLOCK_SLOTS; t++)
+        threads.emplace_back(
+            [&]()
+            {
+                {
+                    EpochReclaimer::Guard guard;
+                }
+                registered.count_down();
+                leave.wait(false);
+            });
+    registered.wait();
+
+    // ...so these ones get slots in a chained block, and hold guards there.
+    constexpr size_t HOLDERS = 64;
+    std::latch entered(HOLDERS);
+    for (size_t t = 0; t < HOLDERS; t++)
+        threads.emplace_back(
+            [&]()
+            {
+                {
+                    EpochReclaimer::Guard guard;
+                    entered.count_down();
+                    release.wait(false);
+                }
+                leave.wait(false);
+            });
+    entered.wait();
+
+    static std::atomic<bool> freed{false};
+    reclaimer.Retire(new int(1),
+        [](void * p)
+        {
+            delete static_cast<int *>(p);
+            freed.store(true);
+        });
+    for (int i = 0; i < 4; i++)
+        reclaimer.Collect();
+    bool ok = !freed.load();
+
+    release.store(true);
+    release.notify_all();
+    // The holders drop their guards in their own time.
+    for (int i = 0; i < 10000 && !freed.load(); i++)
+    {
+        reclaimer.Collect();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ok = ok && freed.load() && reclaimer.Pending() == 0;
+    leave.store(true);
+    leave.notify_all();
+    for (auto & thread : threads)
+        thread.join();
+    std::cout << "Ending [test_many_threads]\n\n";
+    return ok;
 }
 
 int main()
@@ -145,8 +287,10 @@ int main()
     assert(test_get_single_thread());
     assert(test_return_reference());
     assert(test_get_multiple_thread());
-    assert(test_sort_atomic_map_no_sorter());
-    assert(test_sort_atomic_map_greater_sort());
-    assert(test_iterators());
+    assert(test_for_each());
+    assert(test_concurrent_insert_find());
+    assert(test_concurrent_erase());
+    assert(test_reclamation());
+    assert(test_many_threads());
     std::cout << "Success\n";
-}
\ No newline at end of file
+}
@@ -0,0 +1,129 @@
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <assert.h>
+#include <unistd.h>
+
+#include "../../src/book_snapshot.hpp"
+#include "../../src/output_journal.hpp"
+
+typedef std::vector<std::tuple<order_id_t, price_t, unsigned int, execution_id_t, Side>> Resting;
+
+static std::string SnapshotPath()
+{
+    return "/tmp/book_snapshot_test_" + std::to_string(getpid());
+}
+
+static Resting RestingOrders(OrderBook & book)
+{
+    Resting resting;
+    book.ForEachResting([&](Order & order) {
+        resting.emplace_back(order.GetOrderId(), order.GetPrice(), order.GetCount(), order.GetExecutionId(), order.GetSide());
+    });
+    return resting;
+}
+
+// Fills a book with several levels on both sides, partial fills and a cancel.
+static void Trade(OrderBook & book, order_id_t first)
+{
+    for (order_id_t i = 0; i < 20; i++)
+        book.HandleExclusive(*Order::from(first + i, book.symbol, 100 + i % 5, 10, Side::SELL));
+    for (order_id_t i = 0; i < 20; i++)
+        book.HandleExclusive(*Order::from(first + 20 + i, book.symbol, 90 + i % 5, 10, Side::BUY));
+    book.HandleExclusive(*Order::from(first + 40, book.symbol, 101, 25, Side::BUY));
+    book.HandleExclusive(*Order::from(first + 41, book.symbol, 93, 4, Side::SELL));
+    book.CancelExclusive(first + 7, Side::SELL);
+}
+
+// Rebuilds books from the mapped file the way the engine does on restart.
+static std::vector<std::unique_ptr<OrderBook>> Restore(const SnapshotReader & reader)
+{
+    std::vector<std::unique_ptr<OrderBook>> books;
+    const SnapshotOrder * order = reader.Orders().data();
+    for (const SnapshotBook & entry : reader.Books())
+    {
+        books.push_back(std::make_unique<OrderBook>(entry.symbol, books.size()));
+        for (uint32_t i = 0; i < entry.bids + entry.asks; i++, order++)
+        {
+            Order * restored = Order::from(
+                order->order_id, entry.symbol, order->price, order->count, i < entry.bids ? Side::BUY : Side::SELL);
+            restored->SetExecutionId(order->execution_id);
+            books.back()->Restore(*restored);
+        }
+    }
+    return books;
+}
+
+bool test_round_trip()
+{
+    std::cout << "\nStarting [test_round_trip]\n";
+    std::string path = SnapshotPath();
+    OrderBook first(PackSymbol("AAA"), 0);
+    OrderBook second(PackSymbol("BBBBBBBB"), 1);
+    OrderBook empty(PackSymbol("EMPTY"), 2);
+    Trade(first, 1);
+    Trade(second, 1000);
+
+    BookSnapshot snapshot;
+    snapshot.journal_sequence = 42;
+    snapshot.Capture(first);
+    snapshot.Capture(second);
+    snapshot.Capture(empty);
+    bool ok = snapshot.Write(path);
+
+    SnapshotReader reader(path);
+    ok = ok && reader.Valid() && reader.JournalSequence() == 42 && reader.Books().size() == 3;
+    if (ok)
+    {
+        auto books = Restore(reader);
+        ok = RestingOrders(*books[0]) == RestingOrders(first) && RestingOrders(*books[1]) == RestingOrders(second)
+            && RestingOrders(*books[2]).empty() && books[1]->symbol == PackSymbol("BBBBBBBB");
+
+        // Restored orders keep their priority: the partially filled ask at 101
+        // trades before the one behind it, carrying on its execution ids.
+        books[0]->HandleExclusive(*Order::from(500, first.symbol, 101, 12, Side::BUY));
+        first.HandleExclusive(*Order::from(500, first.symbol, 101, 12, Side::BUY));
+        ok = ok && RestingOrders(*books[0]) == RestingOrders(first);
+    }
+    unlink(path.c_str());
+    std::cout << "Ending [test_round_trip]\n\n";
+    return ok;
+}
+
+bool test_damaged_snapshot_is_ignored()
+{
+    std::cout << "\nStarting [test_damaged_snapshot_is_ignored]\n";
+    std::string path = SnapshotPath();
+    OrderBook book(PackSymbol("AAA"), 0);
+    Trade(book, 1);
+    BookSnapshot snapshot;
+    snapshot.Capture(book);
+    bool ok = snapshot.Write(path);
+    size_t length = sizeof(SnapshotHeader) + sizeof(SnapshotBook) + snapshot.orders.size() * sizeof(SnapshotOrder);
+
+    int fd = open(path.c_str(), O_WRONLY);
+    char garbage = 0x5a;
+    assert(pwrite(fd, &garbage, 1, length - 3) == 1);
+    close(fd);
+    ok = ok && !SnapshotReader(path).Valid();
+
+    assert(truncate(path.c_str(), length - sizeof(SnapshotOrder)) == 0);
+    ok = ok && !SnapshotReader(path).Valid();
+
+    unlink(path.c_str());
+    ok = ok && !SnapshotReader(path).Valid();
+    std::cout << "Ending [test_damaged_snapshot_is_ignored]\n\n";
+    return ok;
+}
+
+int main()
+{
+    std::cout << "Starting unit test\n";
+    // Only the books are checked, not the events they print.
+    OutputJournal::Instance().Mute(true);
+    assert(test_round_trip());
+    assert(test_damaged_snapshot_is_ignored());
+    std::cout << "Success\n";
+}
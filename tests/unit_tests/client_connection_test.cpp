@@ -0,0 +1,109 @@
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <assert.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../../src/io.hpp"
+
+static ClientCommand Command(uint32_t order_id)
+{
+    ClientCommand command{};
+    command.type = input_buy;
+    command.order_id = order_id;
+    command.price = order_id * 2;
+    command.count = 1;
+    strcpy(command.instrument, "SPLIT");
+    return command;
+}
+
+/**
+ * Writes the commands in pieces of the given size and reads them back.
+*/
+bool round_trip(size_t commands, size_t piece)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        return false;
+
+    std::vector<char> bytes;
+    for (size_t i = 0; i < commands; i++)
+    {
+        ClientCommand command = Command(i);
+        const char * raw = reinterpret_cast<const char *>(&command);
+        bytes.insert(bytes.end(), raw, raw + sizeof(command));
+    }
+
+    ClientConnection connection(fds[0]);
+    std::vector<uint32_t> received;
+    auto collect = [&](std::span<const ClientCommand> batch)
+    {
+        for (const ClientCommand & command : batch)
+        {
+            if (command.price != command.order_id * 2 || strcmp(command.instrument, "SPLIT") != 0)
+                return false;
+            received.push_back(command.order_id);
+        }
+        return true;
+    };
+
+    std::span<const ClientCommand> batch;
+    for (size_t offset = 0; offset < bytes.size(); offset += piece)
+    {
+        size_t n = std::min(piece, bytes.size() - offset);
+        if (write(fds[1], bytes.data() + offset, n) != ssize_t(n))
+            return false;
+        if (connection.readBatch(batch) != ReadResult::Success || !collect(batch))
+            return false;
+    }
+    close(fds[1]);
+
+    // Pieces larger than the free buffer space are left for later reads.
+    ReadResult result;
+    while ((result = connection.readBatch(batch)) == ReadResult::Success)
+        if (!collect(batch))
+            return false;
+    if (result != ReadResult::EndOfFile)
+        return false;
+    for (size_t i = 0; i < commands; i++)
+        if (i >= received.size() || received[i] != i)
+            return false;
+    return received.size() == commands;
+}
+
+bool test_reassembles_split_commands()
+{
+    std::cout << "\nStarting [test_reassembles_split_commands]\n";
+    bool ok = round_trip(50, 1) && round_trip(200, 13) && round_trip(200, sizeof(ClientCommand) + 1)
+        && round_trip(2000, ClientConnection::READ_BUFFER_SIZE - 5);
+    std::cout << "Ending [test_reassembles_split_commands]\n\n";
+    return ok;
+}
+
+bool test_truncated_command_is_an_error()
+{
+    std::cout << "\nStarting [test_truncated_command_is_an_error]\n";
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        return false;
+    ClientConnection connection(fds[0]);
+    ClientCommand command = Command(1);
+    if (write(fds[1], &command, sizeof(command) - 3) != sizeof(command) - 3)
+        return false;
+    close(fds[1]);
+
+    std::span<const ClientCommand> batch;
+    bool ok = connection.readBatch(batch) == ReadResult::Success && batch.empty()
+        && connection.readBatch(batch) == ReadResult::Error;
+    std::cout << "Ending [test_truncated_command_is_an_error]\n\n";
+    return ok;
+}
+
+int main()
+{
+    std::cout << "Starting unit test\n";
+    assert(test_reassembles_split_commands());
+    assert(test_truncated_command_is_an_error());
+    std::cout << "Success\n";
+}
@@ -0,0 +1,220 @@
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <assert.h>
+#include <unistd.h>
+
+#include "../../src/command_journal.hpp"
+
+static std::string JournalPath()
+{
+    return "/tmp/command_journal_test_" + std::to_string(getpid());
+}
+
+// Appends count commands, every third a cancel of the order before it.
+static void AppendCommands(CommandJournal & journal, order_id_t first, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        order_id_t id = first + i;
+        if (i % 3 == 2)
+        {
+            journal.AppendCancel(PackSymbol("CXL"), id - 1, Side::SELL);
+            continue;
+        }
+        Order * order = Order::from(id, PackSymbol("ORDER"), 100 + i % 7, 1 + i % 11, i % 2 ? Side::SELL : Side::BUY);
+        journal.AppendOrder(order->GetSymbol(), *order);
+        Order::Destroy(order);
+    }
+}
+
+static bool MatchesCommand(const JournalRecord & record, order_id_t first, int i)
+{
+    if (record.order_id != first + i - (i % 3 == 2 ? 1 : 0))
+        return false;
+    if (i % 3 == 2)
+        return record.type == 'C' && record.symbol == PackSymbol("CXL") && record.GetSide() == Side::SELL;
+    return record.type == (i % 2 ? 'S' : 'B') && record.symbol == PackSymbol("ORDER") &&
+        record.price == price_t(100 + i % 7) && record.count == unsigned(1 + i % 11);
+}
+
+bool test_round_trip_and_reopen()
+{
+    std::cout << "\nStarting [test_round_trip_and_reopen]\n";
+    std::string path = JournalPath();
+    unlink(path.c_str());
+    {
+        CommandJournal journal(path, 0, 64);
+        AppendCommands(journal, 1, 1000);
+        assert(journal.Appended() == 1000);
+    }
+    {
+        // Reopening at the end carries the numbering on.
+        CommandJournal journal(path, 1000, 64);
+        AppendCommands(journal, 1001, 500);
+    }
+
+    bool ok = true;
+    JournalReader reader(path);
+    int i = 0;
+    while (const JournalRecord * record = reader.Next())
+    {
+        ok = ok && MatchesCommand(*record, i < 1000 ? 1 : 1001, i < 1000 ? i : i - 1000);
+        i++;
+    }
+    ok = ok && i == 1500 && reader.Sequence() == 1500;
+    unlink(path.c_str());
+    std::cout << "Ending [test_round_trip_and_reopen]\n\n";
+    return ok;
+}
+
+bool test_concurrent_appends()
+{
+    std::cout << "\nStarting [test_concurrent_appends]\n";
+    std::string path = JournalPath();
+    unlink(path.c_str());
+    const int THREADS = 4;
+    const int PER_THREAD = 5000;
+    {
+        CommandJournal journal(path, 0, 128);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREADS; t++)
+            threads.emplace_back(AppendCommands, std::ref(journal), t * PER_THREAD + 1, PER_THREAD);
+        for (auto & thread : threads)
+            thread.join();
+        // Durable trails Appended until the writer syncs the last group.
+        while (journal.Durable() != THREADS * PER_THREAD)
+            std::this_thread::yield();
+    }
+
+    // Every thread's commands come back complete and in the order it appended them.
+    bool ok = true;
+    std::vector<int> seen(THREADS, 0);
+    JournalReader reader(path);
+    while (const JournalRecord * record = reader.Next())
+    {
+        // Cancels name an earlier order of the same thread.
+        int t = (record->order_id - 1) / PER_THREAD;
+        ok = ok && t < THREADS && MatchesCommand(*record, t * PER_THREAD + 1, seen[t]);
+        seen[t]++;
+    }
+    for (int t = 0; t < THREADS; t++)
+        ok = ok && seen[t] == PER_THREAD;
+    unlink(path.c_str());
+    std::cout << "Ending [test_concurrent_appends]\n\n";
+    return ok;
+}
+
+bool test_durable_mark_of_each_record()
+{
+    std::cout << "\nStarting [test_durable_mark_of_each_record]\n";
+    std::string path = JournalPath();
+    unlink(path.c_str());
+    const int THREADS = 4;
+    const int PER_THREAD = 5000;
+    const uint64_t START = 100;
+    {
+        CommandJournal journal(path, 0, 64);
+        AppendCommands(journal, 1, START);
+    }
+
+    // What each append returned, by order id.
+    std::vector<uint64_t> marks(THREADS * PER_THREAD + 1);
+    {
+        CommandJournal journal(path, START, 128);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREADS; t++)
+            threads.emplace_back(
+                [&, t]()
+                {
+                    for (int i = 1; i <= PER_THREAD; i++)
+                    {
+                        order_id_t id = t * PER_THREAD + i;
+                        Order * order = Order::from(id, PackSymbol("MARK"), 100, 1, Side::BUY);
+                        marks[id] = journal.AppendOrder(order->GetSymbol(), *order);
+                        Order::Destroy(order);
+                    }
+                });
+        for (auto & thread : threads)
+            thread.join();
+        journal.Sync();
+        assert(journal.Durable() == START + THREADS * PER_THREAD);
+    }
+
+    // Each record is the one before the mark its append returned.
+    bool ok = true;
+    JournalReader reader(path);
+    ok = ok && reader.Seek(START);
+    while (const JournalRecord * record = reader.Next())
+        ok = ok && record->order_id < marks.size() && marks[record->order_id] == reader.Sequence();
+    ok = ok && reader.Sequence() == START + THREADS * PER_THREAD;
+    unlink(path.c_str());
+    std::cout << "Ending [test_durable_mark_of_each_record]\n\n";
+    return ok;
+}
+
+bool test_torn_tail_is_dropped()
+{
+    std::cout << "\nStarting [test_torn_tail_is_dropped]\n";
+    std::string path = JournalPath();
+    unlink(path.c_str());
+    {
+        CommandJournal journal(path, 0, 64);
+        AppendCommands(journal, 1, 100);
+    }
+
+    // A crash in the middle of writing the last record.
+    assert(truncate(path.c_str(), 99 * sizeof(JournalRecord) + 10) == 0);
+    uint64_t valid;
+    {
+        JournalReader reader(path);
+        while (reader.Next() != nullptr)
+            ;
+        valid = reader.Sequence();
+    }
+    bool ok = valid == 99;
+
+    // A record that made it to the file with garbage in it ends the journal too.
+    int fd = open(path.c_str(), O_WRONLY);
+    char garbage = 0x5a;
+    assert(pwrite(fd, &garbage, 1, 50 * sizeof(JournalRecord) + 20) == 1);
+    close(fd);
+    {
+        JournalReader reader(path);
+        while (reader.Next() != nullptr)
+            ;
+        valid = reader.Sequence();
+    }
+    ok = ok && valid == 50;
+
+    // Recovery resumes after the valid prefix, overwriting what follows it.
+    {
+        CommandJournal journal(path, valid, 64);
+        AppendCommands(journal, 1, 100);
+    }
+    {
+        JournalReader reader(path);
+        int i = 0;
+        while (const JournalRecord * record = reader.Next())
+        {
+            ok = ok && MatchesCommand(*record, 1, i < 50 ? i : i - 50);
+            i++;
+        }
+        ok = ok && i == 150;
+    }
+    unlink(path.c_str());
+    std::cout << "Ending [test_torn_tail_is_dropped]\n\n";
+    return ok;
+}
+
+int main()
+{
+    std::cout << "Starting unit test\n";
+    assert(test_round_trip_and_reopen());
+    assert(test_concurrent_appends());
+    assert(test_durable_mark_of_each_record());
+    assert(test_torn_tail_is_dropped());
+    std::cout << "Success\n";
+}
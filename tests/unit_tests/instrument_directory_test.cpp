@@ -0,0 +1,91 @@
+#include <cstdio>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <assert.h>
+
+#include "../../src/instrument_directory.hpp"
+
+bool test_symbol_round_trip()
+{
+    std::cout << "\nStarting [test_symbol_round_trip]\n";
+    // The wire field holds up to 8 characters and is not always terminated after them.
+    char full[9] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'X'};
+    bool ok = std::string(SymbolText(PackSymbol(full)).c_str()) == "ABCDEFGH"
+        && std::string(SymbolText(PackSymbol("GOOG")).c_str()) == "GOOG" && PackSymbol("GOOG") != PackSymbol("GOOGL")
+        && PackSymbol("") == 0;
+    std::cout << "Ending [test_symbol_round_trip]\n\n";
+    return ok;
+}
+
+bool test_concurrent_growth()
+{
+    std::cout << "\nStarting [test_concurrent_growth]\n";
+    constexpr size_t SYMBOLS = 5000;
+    constexpr size_t THREADS = 4;
+    // Coprime with SYMBOLS, so every stride still visits each symbol once.
+    constexpr size_t STRIDES[THREADS] = {1, 3, 7, 9};
+    InstrumentDirectory directory;
+    std::vector<std::vector<OrderBook *>> seen(THREADS, std::vector<OrderBook *>(SYMBOLS));
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < THREADS; t++)
+        threads.emplace_back(
+            [&, t]()
+            {
+                // Every thread walks the symbols in its own order so creation and growth interleave.
+                for (size_t n = 0; n < SYMBOLS; n++)
+                {
+                    size_t i = n * STRIDES[t] % SYMBOLS;
+                    char name[9];
+                    snprintf(name, sizeof(name), "S%zu", i);
+                    seen[t][i] = &directory.Get(PackSymbol(name), 3);
+                }
+            });
+    for (auto & thread : threads)
+        thread.join();
+
+    bool ok = directory.Size() == SYMBOLS;
+    std::set<size_t> ids;
+    for (size_t i = 0; i < SYMBOLS; i++)
+    {
+        char name[9];
+        snprintf(name, sizeof(name), "S%zu", i);
+        OrderBook * book = directory.Find(PackSymbol(name));
+        for (size_t t = 0; t < THREADS; t++)
+            ok = ok && seen[t][i] == book;
+        ok = ok && book->symbol == PackSymbol(name) && book->shard == book->id % 3;
+        ids.insert(book->id);
+    }
+    ok = ok && ids.size() == SYMBOLS && *ids.rbegin() == SYMBOLS - 1;
+    std::cout << "Ending [test_concurrent_growth]\n\n";
+    return ok;
+}
+
+bool test_placed_books()
+{
+    std::cout << "\nStarting [test_placed_books]\n";
+    InstrumentDirectory directory;
+    // Shard 0 on node 0, shard 1 left where it is first touched.
+    directory.Place({0, ThreadPlacement::NO_NODE});
+    OrderBook & placed = directory.Get(PackSymbol("NODE0"), 2);
+    OrderBook & unplaced = directory.Get(PackSymbol("ANY"), 2);
+    bool ok = placed.shard == 0 && placed.node == 0 && unplaced.shard == 1 && unplaced.node == ThreadPlacement::NO_NODE;
+    ok = ok && reinterpret_cast<uintptr_t>(&placed) % alignof(OrderBook) == 0;
+
+    // Orders of a placed book come from its node.
+    placed.HandleExclusive(*Order::from(1, placed.symbol, 100, 10, Side::SELL, TimeInForce::GTC, placed.node));
+    ok = ok && placed.Totals(Side::SELL).orders == 1;
+    std::cout << "Ending [test_placed_books]\n\n";
+    return ok;
+}
+
+int main()
+{
+    std::cout << "Starting unit test\n";
+    assert(test_symbol_round_trip());
+    assert(test_concurrent_growth());
+    assert(test_placed_books());
+    std::cout << "Success\n";
+}
@@ -0,0 +1,147 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <assert.h>
+
+#include "../../src/latency_stats.hpp"
+
+bool test_buckets()
+{
+    std::cout << "\nStarting [test_buckets]\n";
+    bool ok = true;
+    // Every value lands in a bucket whose bound is at most 1/8 above it.
+    for (uint64_t ns = 0; ns < (uint64_t(1) << 32) && ok; ns = ns * 5 / 4 + 1)
+    {
+        size_t bucket = LatencyHistogram::Bucket(ns);
+        uint64_t bound = LatencyHistogram::UpperBound(bucket);
+        ok = bound >= ns && bound - ns <= ns / 8 && (bucket == 0 || LatencyHistogram::UpperBound(bucket - 1) < ns);
+    }
+    ok = ok && LatencyHistogram::Bucket(uint64_t(1) << 40) == LatencyHistogram::BUCKETS - 1;
+    std::cout << "Ending [test_buckets]\n\n";
+    return ok;
+}
+
+bool test_percentiles()
+{
+    std::cout << "\nStarting [test_percentiles]\n";
+    LatencyHistogram histogram;
+    bool ok = histogram.Percentile(0.5) == 0 && histogram.Count() == 0;
+    for (uint64_t ns = 1; ns <= 10000; ns++)
+        histogram.Record(ns);
+    uint64_t p50 = histogram.Percentile(0.5);
+    uint64_t p99 = histogram.Percentile(0.99);
+    ok = ok && histogram.Count() == 10000 && histogram.Max() == 10000 && p50 >= 5000 && p50 <= 5000 * 9 / 8 && p99 >= 9900
+        && p99 <= 10000 && histogram.Percentile(1.0) == 10000;
+    std::cout << "Ending [test_percentiles]\n\n";
+    return ok;
+}
+
+bool test_merge_threads()
+{
+    std::cout << "\nStarting [test_merge_threads]\n";
+    LatencyStats & stats = LatencyStats::Instance();
+    stats.Enable();
+
+    // Each thread charges its own connection and shares instrument 1, so
+    // the instrument merges what every thread recorded.
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; t++)
+        stats.OpenConnection(t);
+    for (size_t t = 0; t < 4; t++)
+        threads.emplace_back(
+            [t]()
+            {
+                LatencyStats::Scope scope(1, t);
+                for (int i = 0; i < 1000; i++)
+                    LatencyStats::Record(Stage::Match, LatencyStats::Now() - 1000 * (t + 1));
+                LatencyStats::Scope inner(LatencyStats::NONE, t);
+                LatencyStats::Record(Stage::Output, LatencyStats::Start());
+            });
+    for (auto & thread : threads)
+        thread.join();
+    // Outside of any scope nothing is recorded.
+    LatencyStats::Record(Stage::Match, LatencyStats::Start());
+
+    std::vector<std::unique_ptr<LatencyStats::Summary>> instruments;
+    std::map<size_t, std::unique_ptr<LatencyStats::Summary>> connections;
+    LatencyStats::Summary closed;
+    stats.Collect(instruments, connections, closed);
+    bool ok = instruments.size() == 2 && !instruments[0] && instruments[1] && connections.size() == 4;
+    ok = ok && instruments[1]->stages[size_t(Stage::Match)].Count() == 4000
+        && instruments[1]->stages[size_t(Stage::Output)].Count() == 0 && instruments[1]->stages[size_t(Stage::Match)].Max() >= 4000;
+    for (size_t t = 0; t < connections.size() && ok; t++)
+        ok = connections[t]->stages[size_t(Stage::Match)].Count() == 1000 && connections[t]->stages[size_t(Stage::Output)].Count() == 1
+            && connections[t]->stages[size_t(Stage::Match)].Percentile(0.5) >= 1000 * (t + 1);
+
+    // The dump names the instrument and reports the total of all connections.
+    char * text = nullptr;
+    size_t length = 0;
+    FILE * out = open_memstream(&text, &length);
+    stats.Dump(out, {"ZERO", "ONE"});
+    fclose(out);
+    std::string dump(text, length);
+    free(text);
+    ok = ok && dump.find("instrument ONE") != std::string::npos && dump.find("ZERO") == std::string::npos
+        && dump.find("connection 3") != std::string::npos && dump.find("4000") != std::string::npos;
+    std::cout << "Ending [test_merge_threads]\n\n";
+    return ok;
+}
+
+bool test_closed_connections()
+{
+    std::cout << "\nStarting [test_closed_connections]\n";
+    LatencyStats & stats = LatencyStats::Instance();
+    stats.Enable();
+
+    // Enough connections come and go for the thread to sweep several times.
+    constexpr size_t CONNECTIONS = 1000;
+    for (size_t id = 100; id < 100 + CONNECTIONS; id++)
+    {
+        stats.OpenConnection(id);
+        LatencyStats::Scope scope(LatencyStats::NONE, id);
+        LatencyStats::Record(Stage::Match, LatencyStats::Start());
+        stats.CloseConnection(id);
+        // Late records of a closed connection are not kept apart either.
+        LatencyStats::Record(Stage::Output, LatencyStats::Start());
+    }
+    stats.OpenConnection(50);
+    {
+        LatencyStats::Scope scope(LatencyStats::NONE, 50);
+        LatencyStats::Record(Stage::Match, LatencyStats::Start());
+    }
+
+    std::vector<std::unique_ptr<LatencyStats::Summary>> instruments;
+    std::map<size_t, std::unique_ptr<LatencyStats::Summary>> connections;
+    LatencyStats::Summary closed;
+    stats.Collect(instruments, connections, closed);
+    bool ok = closed.stages[size_t(Stage::Match)].Count() == CONNECTIONS && closed.stages[size_t(Stage::Output)].Count() == CONNECTIONS;
+    ok = ok && connections.count(50) == 1 && connections.lower_bound(100) == connections.end();
+
+    char * text = nullptr;
+    size_t length = 0;
+    FILE * out = open_memstream(&text, &length);
+    stats.Dump(out, {});
+    fclose(out);
+    std::string dump(text, length);
+    free(text);
+    ok = ok && dump.find("connection closed") != std::string::npos && dump.find("connection 50 ") != std::string::npos
+        && dump.find("connection 100 ") == std::string::npos;
+    stats.CloseConnection(50);
+    std::cout << "Ending [test_closed_connections]\n\n";
+    return ok;
+}
+
+int main()
+{
+    std::cout << "Starting unit test\n";
+    assert(test_buckets());
+    assert(test_percentiles());
+    assert(test_merge_threads());
+    assert(test_closed_connections());
+    std::cout << "Success\n";
+}
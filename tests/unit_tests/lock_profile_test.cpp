@@ -0,0 +1,82 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <assert.h>
+
+#include "../../src/lock_profile.hpp"
+
+static const ProfiledMutex::Site * FindSite(const ProfiledMutex & mutex, uint32_t line)
+{
+    for (const ProfiledMutex::Site & site : mutex.Sites())
+        if (site.function.load() != nullptr && site.line.load() == line)
+            return &site;
+    return nullptr;
+}
+
+bool test_sites()
+{
+    std::cout << "\nStarting [test_sites]\n";
+    ProfiledMutex mutex("test");
+    uint32_t first = __LINE__ + 2;
+    for (int i = 0; i < 3; i++)
+        std::unique_lock<ProfiledMutex> l = ProfiledLock(mutex);
+    uint32_t second = __LINE__ + 1;
+    std::unique_lock<ProfiledMutex> l = ProfiledLock(mutex);
+    l.unlock();
+    // Naming no site charges the last one.
+    l.lock();
+    l.unlock();
+
+    const ProfiledMutex::Site * a = FindSite(mutex, first);
+    const ProfiledMutex::Site * b = FindSite(mutex, second);
+    bool ok = a != nullptr && b != nullptr && a->acquisitions.load() == 3 && b->acquisitions.load() == 2
+        && a->contended.load() == 0 && b->contended.load() == 0;
+    std::cout << "Ending [test_sites]\n\n";
+    return ok;
+}
+
+bool test_contention()
+{
+    std::cout << "\nStarting [test_contention]\n";
+    ProfiledMutex mutex("contended");
+    mutex.Label("bids", PackSymbol("LOCKED"));
+
+    uint32_t line = __LINE__ + 1;
+    std::unique_lock<ProfiledMutex> l = ProfiledLock(mutex);
+    std::thread waiter([&]() { std::unique_lock<ProfiledMutex> w = ProfiledLock(mutex); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    l.unlock();
+    waiter.join();
+
+    uint32_t waiterLine = line + 1;
+    const ProfiledMutex::Site * holder = FindSite(mutex, line);
+    const ProfiledMutex::Site * waited = FindSite(mutex, waiterLine);
+    bool ok = holder != nullptr && waited != nullptr && holder->contended.load() == 0 && waited->contended.load() == 1
+        && waited->wait_ns.load() >= 10000000 && holder->hold_ns.load() >= 10000000;
+
+    // The report names the lock with its instrument and points at the waiting site.
+    char * text = nullptr;
+    size_t length = 0;
+    FILE * out = open_memstream(&text, &length);
+    ProfiledMutex::Report(out);
+    fclose(out);
+    std::string report(text, length);
+    free(text);
+    ok = ok && report.find("LOCKED bids") != std::string::npos && report.find("LOCKED ") != std::string::npos
+        && report.find("lock_profile_test.cpp:" + std::to_string(waiterLine)) != std::string::npos;
+    std::cout << "Ending [test_contention]\n\n";
+    return ok;
+}
+
+int main()
+{
+    std::cout << "Starting unit test\n";
+    // Not the report the first lock registers for the exit.
+    setenv("ENGINE_LOCK_PROFILE", "/dev/null", 1);
+    assert(test_sites());
+    assert(test_contention());
+    std::cout << "Success\n";
+}
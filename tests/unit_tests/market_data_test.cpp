@@ -0,0 +1,222 @@
+#include <iostream>
+#include <map>
+#include <random>
+#include <tuple>
+#include <assert.h>
+#include <unistd.h>
+
+#include "../../src/market_data.hpp"
+
+typedef std::map<std::tuple<symbol_t, uint8_t, uint32_t>, std::pair<uint64_t, uint32_t>> Levels;
+
+/**
+ * Rebuilds the books from the feed the way a consumer would: wait for a
+ * snapshot, then apply the updates following it.
+*/
+struct Consumer
+{
+    explicit Consumer(const std::string & path) : reader(path) { }
+
+    void Poll()
+    {
+        L2Message message;
+        while (true)
+        {
+            bool got = reader.Next(message);
+            if (reader.Overrun())
+            {
+                // Lost messages, start over from the next snapshot.
+                reader.ClearOverrun();
+                synced = false;
+                in_snapshot = false;
+            }
+            if (!got)
+                return;
+
+            switch (message.type)
+            {
+                case L2Message::SnapshotStart:
+                    if (!synced)
+                    {
+                        in_snapshot = true;
+                        levels.clear();
+                    }
+                    break;
+                case L2Message::SnapshotLevel:
+                    if (in_snapshot)
+                        levels[{message.symbol, message.side, message.price}] = {message.quantity, message.orders};
+                    break;
+                case L2Message::SnapshotEnd:
+                    if (in_snapshot)
+                    {
+                        in_snapshot = false;
+                        synced = true;
+                        sequence = message.sequence;
+                    }
+                    break;
+                case L2Message::Update:
+                    if (!synced)
+                        break;
+                    if (message.sequence != sequence + 1)
+                        gaps++;
+                    sequence = message.sequence;
+                    if (message.orders == 0)
+                        levels.erase({message.symbol, message.side, message.price});
+                    else
+                        levels[{message.symbol, message.side, message.price}] = {message.quantity, message.orders};
+                    break;
+            }
+        }
+    }
+
+    MarketDataReader reader;
+    Levels levels;
+    uint64_t sequence = 0;
+    bool synced = false;
+    bool in_snapshot = false;
+    int gaps = 0;
+};
+
+static void RandomUpdate(std::mt19937 & rng, MarketDataFeed & feed, Levels & truth)
+{
+    symbol_t symbol = PackSymbol(rng() % 2 ? "AAA" : "BBBBBBBB");
+    uint8_t side = rng() % 2;
+    uint32_t price = 100 + rng() % 20;
+    uint32_t orders = rng() % 3 == 0 ? 0 : 1 + rng() % 5;
+    uint64_t quantity = orders * (1 + rng() % 100);
+    feed.LevelChanged(symbol, side, price, quantity, orders);
+    if (orders == 0)
+        truth.erase({symbol, side, price});
+    else
+        truth[{symbol, side, price}] = {quantity, orders};
+}
+
+bool test_follow_from_start()
+{
+    std::cout << "\nStarting [test_follow_from_start]\n";
+    std::string path = "/tmp/market_data_test_" + std::to_string(getpid());
+    std::mt19937 rng(3);
+    MarketDataFeed feed(path, 4096, 100);
+    Consumer consumer(path);
+    Levels truth;
+    bool ok = true;
+    for (int i = 0; i < 2000; i++)
+    {
+        RandomUpdate(rng, feed, truth);
+        if (i % 7 == 0)
+        {
+            consumer.Poll();
+            ok = ok && consumer.synced && consumer.levels == truth;
+        }
+    }
+    consumer.Poll();
+    ok = ok && consumer.levels == truth && consumer.gaps == 0;
+    unlink(path.c_str());
+    std::cout << "Ending [test_follow_from_start]\n\n";
+    return ok;
+}
+
+bool test_late_and_slow_readers_resync()
+{
+    std::cout << "\nStarting [test_late_and_slow_readers_resync]\n";
+    std::string path = "/tmp/market_data_test_" + std::to_string(getpid());
+    std::mt19937 rng(5);
+    // A ring small enough to be lapped between polls, snapshots often enough to resync soon.
+    MarketDataFeed feed(path, 256, 64);
+    Levels truth;
+    for (int i = 0; i < 5000; i++)
+        RandomUpdate(rng, feed, truth);
+
+    Consumer late(path);
+    bool ok = true;
+    for (int round = 0; round < 50; round++)
+    {
+        // Falls behind by more than the ring now and then.
+        int burst = round % 10 == 0 ? 1000 : 20;
+        for (int i = 0; i < burst; i++)
+            RandomUpdate(rng, feed, truth);
+        late.Poll();
+    }
+    // Enough updates for one more snapshot to complete in the ring.
+    for (int i = 0; i < 100; i++)
+    {
+        RandomUpdate(rng, feed, truth);
+        late.Poll();
+    }
+    ok = ok && late.synced && late.levels == truth && late.gaps == 0;
+    unlink(path.c_str());
+    std::cout << "Ending [test_late_and_slow_readers_resync]\n\n";
+    return ok;
+}
+
+bool test_snapshots_bounded_by_ring()
+{
+    std::cout << "\nStarting [test_snapshots_bounded_by_ring]\n";
+    std::string path = "/tmp/market_data_test_" + std::to_string(getpid());
+    bool ok = true;
+    {
+        // Asked for a snapshot after every update, the feed still spaces
+        // them by their length.
+        MarketDataFeed feed(path, 1 << 16, 1);
+        Levels truth;
+        for (uint32_t price = 1; price <= 200; price++)
+        {
+            feed.LevelChanged(PackSymbol("WIDE"), 0, price, 10, 1);
+            truth[{PackSymbol("WIDE"), 0, price}] = {10, 1};
+        }
+        for (uint32_t i = 0; i < 1000; i++)
+        {
+            uint32_t price = 1 + i % 200;
+            feed.LevelChanged(PackSymbol("WIDE"), 0, price, 20 + i, 2);
+            truth[{PackSymbol("WIDE"), 0, price}] = {20 + i, 2};
+        }
+
+        MarketDataReader reader(path);
+        L2Message message;
+        size_t updates = 0;
+        size_t snapshot_levels = 0;
+        while (reader.Next(message))
+        {
+            updates += message.type == L2Message::Update;
+            snapshot_levels += message.type == L2Message::SnapshotLevel;
+        }
+        ok = ok && updates == 1200 && snapshot_levels > 0 && snapshot_levels <= updates;
+
+        Consumer late(path);
+        late.Poll();
+        ok = ok && late.synced && late.levels == truth;
+    }
+    {
+        // More levels than half the ring: snapshots are skipped rather than
+        // overwrite the updates with one no reader could use.
+        MarketDataFeed feed(path, 64, 1);
+        for (uint32_t price = 1; price <= 100; price++)
+            feed.LevelChanged(PackSymbol("WIDE"), 1, price, 10, 1);
+        for (uint32_t i = 0; i < 500; i++)
+            feed.LevelChanged(PackSymbol("WIDE"), 1, 1 + i % 100, 20, 2);
+
+        MarketDataReader reader(path);
+        L2Message message;
+        // Falls a whole ring behind at once and skips to its middle.
+        ok = ok && !reader.Next(message) && reader.Overrun();
+        size_t read = 0;
+        while (reader.Next(message))
+        {
+            ok = ok && message.type == L2Message::Update;
+            read++;
+        }
+        ok = ok && read == 32;
+    }
+    unlink(path.c_str());
+    std::cout << "Ending [test_snapshots_bounded_by_ring]\n\n";
+    return ok;
+}
+
+int main()
+{
+    std::cout << "Starting unit test\n";
+    assert(test_follow_from_start());
+    assert(test_late_and_slow_readers_resync());
+    assert(test_snapshots_bounded_by_ring());
+    std::cout << "Success\n";
+}
@@ -0,0 +1,94 @@
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <assert.h>
+
+#include "../../src/mpsc_queue.hpp"
+
+bool test_fifo_single_thread()
+{
+    std::cout << "\nStarting [test_fifo_single_thread]\n";
+    MpscQueue<int> queue(4);
+    for (int i = 0; i < 4; i++)
+        if (!queue.TryPush(i))
+            return false;
+
+    // Queue is full
+    int extra = 99;
+    if (queue.TryPush(extra))
+        return false;
+
+    int out;
+    for (int i = 0; i < 4; i++)
+        if (!queue.TryPop(out) || out != i)
+            return false;
+    if (queue.TryPop(out))
+        return false;
+    std::cout << "Ending [test_fifo_single_thread]\n\n";
+    return true;
+}
+
+bool test_wraps_around()
+{
+    std::cout << "\nStarting [test_wraps_around]\n";
+    MpscQueue<int> queue(3);
+    int out;
+    for (int i = 0; i < 100; i++)
+    {
+        int v = i;
+        if (!queue.TryPush(v) || !queue.TryPop(out) || out != i)
+            return false;
+    }
+    std::cout << "Ending [test_wraps_around]\n\n";
+    return true;
+}
+
+bool test_producers_keep_their_order()
+{
+    std::cout << "\nStarting [test_producers_keep_their_order]\n";
+    constexpr int producers = 8;
+    constexpr int per_producer = 100000;
+    MpscQueue<std::pair<int, int>> queue(64);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++)
+        threads.emplace_back(
+            [&, p]()
+            {
+                for (int i = 0; i < per_producer; i++)
+                {
+                    std::pair<int, int> v{p, i};
+                    while (!queue.TryPush(v))
+                        std::this_thread::yield();
+                }
+            });
+
+    std::vector<int> next(producers, 0);
+    std::pair<int, int> out;
+    for (int received = 0; received < producers * per_producer;)
+    {
+        if (!queue.TryPop(out))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        if (out.second != next[out.first])
+            return false;
+        next[out.first]++;
+        received++;
+    }
+    for (auto & t : threads)
+        t.join();
+    std::cout << "Ending [test_producers_keep_their_order]\n\n";
+    return true;
+}
+
+int main()
+{
+    std::cout << "Starting unit test\n";
+    assert(test_fifo_single_thread());
+    assert(test_wraps_around());
+    assert(test_producers_keep_their_order());
+    std::cout << "Success\n";
+}
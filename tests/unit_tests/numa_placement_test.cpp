@@ -0,0 +1,82 @@
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <assert.h>
+
+#include "../../src/numa_placement.hpp"
+#include "../../src/slab_pool.hpp"
+
+bool test_cpu_list()
+{
+    std::cout << "\nStarting [test_cpu_list]\n";
+    std::vector<int> cpus;
+    bool ok = ParseCpuList("0-3,8,10-11\n", cpus) && cpus == std::vector<int>{0, 1, 2, 3, 8, 10, 11};
+    // A node without CPUs.
+    ok = ok && ParseCpuList("\n", cpus) && cpus.empty();
+    ok = ok && !ParseCpuList("0-", cpus) && !ParseCpuList("3-1", cpus) && !ParseCpuList("1,,2", cpus) && !ParseCpuList("x", cpus);
+    std::cout << "Ending [test_cpu_list]\n\n";
+    return ok;
+}
+
+bool test_place()
+{
+    std::cout << "\nStarting [test_place]\n";
+    // Two sockets of two cores and a memory only node.
+    NumaTopology topology({{0, {0, 1}}, {1, {2, 3}}, {2, {}}});
+
+    std::vector<ThreadPlacement> none = topology.Place(3, Pinning::None);
+    bool ok = none.size() == 3 && none[2].node == ThreadPlacement::NO_NODE && none[2].cpus.empty();
+
+    std::vector<ThreadPlacement> nodes = topology.Place(3, Pinning::Node);
+    ok = ok && nodes[0].node == 0 && nodes[1].node == 1 && nodes[2].node == 0;
+    ok = ok && nodes[1].cpus == std::vector<int>{2, 3};
+
+    // Cores of a node go in turn, and are shared once they run out.
+    std::vector<ThreadPlacement> cores = topology.Place(6, Pinning::Core);
+    ok = ok && cores[0].cpus == std::vector<int>{0} && cores[1].cpus == std::vector<int>{2};
+    ok = ok && cores[2].cpus == std::vector<int>{1} && cores[3].cpus == std::vector<int>{3};
+    ok = ok && cores[4].cpus == std::vector<int>{0} && cores[4].node == 0;
+
+    std::vector<ThreadPlacement> chosen = topology.Place(2, Pinning::Core, {1});
+    ok = ok && chosen[0].node == 1 && chosen[1].node == 1 && chosen[1].cpus == std::vector<int>{3};
+    std::cout << "Ending [test_place]\n\n";
+    return ok;
+}
+
+bool test_node_slabs()
+{
+    std::cout << "\nStarting [test_node_slabs]\n";
+    void * aligned = NodeArena::Allocate(24, 64, 0);
+    bool ok = reinterpret_cast<uintptr_t>(aligned) % 64 == 0;
+    // Large blocks are mapped on their own.
+    char * large = static_cast<char *>(NodeArena::Allocate(4 << 20, 8, 0));
+    large[(4 << 20) - 1] = 1;
+
+    typedef SlabPool<32, 8> Pool;
+    void * slot = nullptr;
+    int node = ThreadPlacement::NO_NODE;
+    std::thread owner(
+        [&]()
+        {
+            ThreadPlacement{0, {}}.Apply();
+            node = ThreadPlacement::CurrentNode();
+            slot = Pool::Allocate();
+            Pool::Free(slot);
+        });
+    owner.join();
+    // The owner's exit spilled the slot to the depot of node 0, where other threads find it.
+    ok = ok && node == 0 && ThreadPlacement::CurrentNode() == ThreadPlacement::NO_NODE;
+    ok = ok && Pool::Allocate() != slot && Pool::Allocate(0) == slot;
+    std::cout << "Ending [test_node_slabs]\n\n";
+    return ok;
+}
+
+int main()
+{
+    std::cout << "Starting unit test\n";
+    assert(test_cpu_list());
+    assert(test_place());
+    assert(test_node_slabs());
+    std::cout << "Success\n";
+}
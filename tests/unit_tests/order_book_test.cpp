@@ -0,0 +1,342 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <assert.h>
+
+#include "../../src/order_book.hpp"
+
+typedef std::vector<std::tuple<order_id_t, price_t, unsigned int>> Resting;
+
+static Resting RestingOrders(OrderBook & book)
+{
+    Resting resting;
+    book.ForEachResting([&](Order & order) { resting.emplace_back(order.GetOrderId(), order.GetPrice(), order.GetCount()); });
+    return resting;
+}
+
+// Runs every scenario on the single writer path and on the locking one.
+static void Handle(OrderBook & book, bool exclusive, Order * order)
+{
+    if (exclusive)
+        book.HandleExclusive(*order);
+    else
+        book.Handle(*order);
+}
+
+static void RestAsks(OrderBook & book, bool exclusive)
+{
+    Handle(book, exclusive, Order::from(1, book.symbol, 100, 10, Side::SELL));
+    Handle(book, exclusive, Order::from(2, book.symbol, 101, 10, Side::SELL));
+    Handle(book, exclusive, Order::from(3, book.symbol, 102, 10, Side::SELL));
+}
+
+bool test_ioc(bool exclusive)
+{
+    std::cout << "\nStarting [test_ioc]\n";
+    OrderBook book(PackSymbol("IOC"), 0);
+    RestAsks(book, exclusive);
+    // Fills the level it crosses and drops the rest instead of resting it.
+    Handle(book, exclusive, Order::from(10, book.symbol, 100, 15, Side::BUY, TimeInForce::IOC));
+    bool ok = RestingOrders(book) == Resting{{2, 101, 10}, {3, 102, 10}};
+    // Not crossing at all, it is simply dropped.
+    Handle(book, exclusive, Order::from(11, book.symbol, 99, 5, Side::BUY, TimeInForce::IOC));
+    ok = ok && RestingOrders(book) == Resting{{2, 101, 10}, {3, 102, 10}};
+    std::cout << "Ending [test_ioc]\n\n";
+    return ok;
+}
+
+bool test_fok(bool exclusive)
+{
+    std::cout << "\nStarting [test_fok]\n";
+    OrderBook book(PackSymbol("FOK"), 0);
+    RestAsks(book, exclusive);
+    // 20 are available up to 101, so 25 do not trade at all.
+    Handle(book, exclusive, Order::from(10, book.symbol, 101, 25, Side::BUY, TimeInForce::FOK));
+    bool ok = RestingOrders(book) == Resting{{1, 100, 10}, {2, 101, 10}, {3, 102, 10}};
+    Handle(book, exclusive, Order::from(11, book.symbol, 101, 15, Side::BUY, TimeInForce::FOK));
+    ok = ok && RestingOrders(book) == Resting{{2, 101, 5}, {3, 102, 10}};
+    // Exactly what is left.
+    Handle(book, exclusive, Order::from(12, book.symbol, 102, 15, Side::BUY, TimeInForce::FOK));
+    ok = ok && RestingOrders(book).empty();
+    std::cout << "Ending [test_fok]\n\n";
+    return ok;
+}
+
+bool test_market(bool exclusive)
+{
+    std::cout << "\nStarting [test_market]\n";
+    OrderBook book(PackSymbol("MARKET"), 0);
+    RestAsks(book, exclusive);
+    Handle(book, exclusive, Order::from(20, book.symbol, 90, 10, Side::BUY));
+    // A market order is an IOC order at the most aggressive price.
+    Handle(book, exclusive, Order::from(10, book.symbol, std::numeric_limits<price_t>::max(), 25, Side::BUY, TimeInForce::IOC));
+    bool ok = RestingOrders(book) == Resting{{20, 90, 10}, {3, 102, 5}};
+    Handle(book, exclusive, Order::from(11, book.symbol, 0, 40, Side::SELL, TimeInForce::IOC));
+    ok = ok && RestingOrders(book) == Resting{{3, 102, 5}};
+    std::cout << "Ending [test_market]\n\n";
+    return ok;
+}
+
+static void Amend(OrderBook & book, bool exclusive, order_id_t order_id, Side side, price_t price, unsigned int count)
+{
+    if (exclusive)
+        book.AmendExclusive(order_id, side, price, count);
+    else
+        book.Amend(order_id, side, price, count);
+}
+
+bool test_amend(bool exclusive)
+{
+    std::cout << "\nStarting [test_amend]\n";
+    OrderBook book(PackSymbol("AMEND"), 0);
+    RestAsks(book, exclusive);
+    Handle(book, exclusive, Order::from(4, book.symbol, 100, 10, Side::SELL));
+    // Smaller at the same price, the order keeps its place.
+    Amend(book, exclusive, 1, Side::SELL, 100, 4);
+    bool ok = RestingOrders(book) == Resting{{1, 100, 4}, {4, 100, 10}, {2, 101, 10}, {3, 102, 10}};
+    // Larger, it goes to the back of the level.
+    Amend(book, exclusive, 1, Side::SELL, 100, 12);
+    ok = ok && RestingOrders(book) == Resting{{4, 100, 10}, {1, 100, 12}, {2, 101, 10}, {3, 102, 10}};
+    // To a new price, it leaves its old level.
+    Amend(book, exclusive, 3, Side::SELL, 99, 10);
+    ok = ok && RestingOrders(book) == Resting{{3, 99, 10}, {4, 100, 10}, {1, 100, 12}, {2, 101, 10}};
+    // Unknown orders, or amends to nothing, are rejected.
+    Amend(book, exclusive, 50, Side::SELL, 99, 10);
+    Amend(book, exclusive, 2, Side::SELL, 101, 0);
+    ok = ok && RestingOrders(book) == Resting{{3, 99, 10}, {4, 100, 10}, {1, 100, 12}, {2, 101, 10}};
+
+    // Across the spread, it is matched like a new order and rests the remainder.
+    Handle(book, exclusive, Order::from(20, book.symbol, 98, 15, Side::BUY));
+    Amend(book, exclusive, 4, Side::SELL, 97, 20);
+    ok = ok && RestingOrders(book) == Resting{{4, 97, 5}, {3, 99, 10}, {1, 100, 12}, {2, 101, 10}};
+    // And leaves nothing when it trades entirely.
+    Handle(book, exclusive, Order::from(21, book.symbol, 96, 8, Side::BUY));
+    ok = ok && RestingOrders(book) == Resting{{21, 96, 8}, {4, 97, 5}, {3, 99, 10}, {1, 100, 12}, {2, 101, 10}};
+    Amend(book, exclusive, 21, Side::BUY, 97, 5);
+    ok = ok && RestingOrders(book) == Resting{{3, 99, 10}, {1, 100, 12}, {2, 101, 10}};
+    std::cout << "Ending [test_amend]\n\n";
+    return ok;
+}
+
+bool test_depth(bool exclusive)
+{
+    std::cout << "\nStarting [test_depth]\n";
+    OrderBook book(PackSymbol("DEPTH"), 0);
+    DepthLevel best;
+    bool ok = !book.BestBid(best) && !book.BestAsk(best) && book.Totals(Side::SELL).quantity == 0;
+
+    RestAsks(book, exclusive);
+    Handle(book, exclusive, Order::from(4, book.symbol, 101, 5, Side::SELL));
+    Handle(book, exclusive, Order::from(5, book.symbol, 98, 7, Side::BUY));
+    Handle(book, exclusive, Order::from(6, book.symbol, 97, 3, Side::BUY));
+    // Trades 4 at 100 and cancels one of the two orders at 101.
+    Handle(book, exclusive, Order::from(7, book.symbol, 100, 4, Side::BUY));
+    book.Cancel(2, Side::SELL);
+
+    DepthLevel asks[4];
+    ok = ok && book.BestAsk(best) && best.price == 100 && best.quantity == 6 && best.orders == 1;
+    ok = ok && book.BestBid(best) && best.price == 98 && best.quantity == 7 && book.Best(Side::BUY, best) && best.price == 98;
+    ok = ok && book.Depth(Side::SELL, asks, 4) == 3 && asks[1].price == 101 && asks[1].quantity == 5 && asks[1].orders == 1
+        && asks[2].price == 102 && asks[2].quantity == 10;
+    ok = ok && book.Depth(Side::SELL, asks, 2) == 2 && asks[1].price == 101;
+    ok = ok && book.QuantityUpTo(Side::SELL, 99) == 0 && book.QuantityUpTo(Side::SELL, 101) == 11
+        && book.QuantityUpTo(Side::SELL, 1000) == 21 && book.QuantityUpTo(Side::BUY, 97) == 10
+        && book.QuantityUpTo(Side::BUY, 98) == 7;
+    BookTotals asksTotal = book.Totals(Side::SELL);
+    BookTotals bidsTotal = book.Totals(Side::BUY);
+    ok = ok && asksTotal.quantity == 21 && asksTotal.orders == 3 && bidsTotal.quantity == 10 && bidsTotal.orders == 2;
+    std::cout << "Ending [test_depth]\n\n";
+    return ok;
+}
+
+static Order * ClientOrder(OrderBook & book, order_id_t id, price_t price, unsigned int count, Side side, client_id_t client,
+    SelfTrade self_trade = SelfTrade::Allow, TimeInForce time_in_force = TimeInForce::GTC)
+{
+    Order * order = Order::from(id, book.symbol, price, count, side, time_in_force);
+    order->SetClient(client, self_trade);
+    return order;
+}
+
+// Client 1 rests on both sides of client 2 in the queue.
+static void RestClientAsks(OrderBook & book, bool exclusive)
+{
+    Handle(book, exclusive, ClientOrder(book, 1, 100, 10, Side::SELL, 1));
+    Handle(book, exclusive, ClientOrder(book, 2, 100, 10, Side::SELL, 2));
+    Handle(book, exclusive, ClientOrder(book, 3, 101, 10, Side::SELL, 1));
+}
+
+static Resting AfterSelfTrade(bool exclusive, SelfTrade mode, TimeInForce time_in_force, unsigned int count)
+{
+    OrderBook book(PackSymbol("STP"), 0);
+    RestClientAsks(book, exclusive);
+    Handle(book, exclusive, ClientOrder(book, 10, 101, count, Side::BUY, 1, mode, time_in_force));
+    return RestingOrders(book);
+}
+
+bool test_self_trade(bool exclusive)
+{
+    std::cout << "\nStarting [test_self_trade]\n";
+    bool ok = AfterSelfTrade(exclusive, SelfTrade::Allow, TimeInForce::GTC, 25) == Resting{{3, 101, 5}};
+    // Stops at the first order of its own client.
+    ok = ok && AfterSelfTrade(exclusive, SelfTrade::CancelNewest, TimeInForce::GTC, 25) == Resting{{1, 100, 10}, {2, 100, 10}, {3, 101, 10}};
+    // Trades with client 2 only and rests the rest.
+    ok = ok && AfterSelfTrade(exclusive, SelfTrade::CancelOldest, TimeInForce::GTC, 25) == Resting{{10, 101, 15}};
+    ok = ok && AfterSelfTrade(exclusive, SelfTrade::CancelBoth, TimeInForce::GTC, 25) == Resting{{2, 100, 10}, {3, 101, 10}};
+    // 10 off order 1, 10 traded with order 2 and the last 5 off order 3, which keeps its place.
+    ok = ok && AfterSelfTrade(exclusive, SelfTrade::Decrement, TimeInForce::GTC, 25) == Resting{{3, 101, 5}};
+    ok = ok && AfterSelfTrade(exclusive, SelfTrade::Decrement, TimeInForce::GTC, 5) == Resting{{1, 100, 5}, {2, 100, 10}, {3, 101, 10}};
+
+    // A FOK order only counts what it could trade.
+    ok = ok && AfterSelfTrade(exclusive, SelfTrade::CancelOldest, TimeInForce::FOK, 15) == Resting{{1, 100, 10}, {2, 100, 10}, {3, 101, 10}};
+    ok = ok && AfterSelfTrade(exclusive, SelfTrade::CancelOldest, TimeInForce::FOK, 10) == Resting{{3, 101, 10}};
+    ok = ok && AfterSelfTrade(exclusive, SelfTrade::CancelNewest, TimeInForce::FOK, 5) == Resting{{1, 100, 10}, {2, 100, 10}, {3, 101, 10}};
+    ok = ok && AfterSelfTrade(exclusive, SelfTrade::Decrement, TimeInForce::FOK, 15) == Resting{{2, 100, 5}, {3, 101, 10}};
+
+    // Other clients, and orders without one, trade as usual.
+    OrderBook book(PackSymbol("STP"), 0);
+    RestClientAsks(book, exclusive);
+    Handle(book, exclusive, ClientOrder(book, 11, 100, 5, Side::BUY, 3, SelfTrade::CancelBoth));
+    Handle(book, exclusive, ClientOrder(book, 12, 100, 5, Side::BUY, Order::NO_CLIENT, SelfTrade::CancelBoth));
+    ok = ok && RestingOrders(book) == Resting{{2, 100, 10}, {3, 101, 10}};
+    std::cout << "Ending [test_self_trade]\n\n";
+    return ok;
+}
+
+bool test_try_rest()
+{
+    std::cout << "\nStarting [test_try_rest]\n";
+    OrderBook book(PackSymbol("PASSIVE"), 0);
+    // Nothing to cross yet.
+    bool ok = book.TryRest(*Order::from(1, book.symbol, 100, 10, Side::SELL));
+    ok = ok && book.TryRest(*Order::from(2, book.symbol, 98, 10, Side::BUY));
+    // Up to the best ask, or past the best bid, it may cross.
+    Order * crossing = Order::from(3, book.symbol, 100, 5, Side::BUY);
+    ok = ok && !book.TryRest(*crossing) && !crossing->GetActivated();
+    book.Handle(*crossing);
+    Order * selling = Order::from(4, book.symbol, 98, 5, Side::SELL);
+    ok = ok && !book.TryRest(*selling);
+    book.Handle(*selling);
+    // Orders that never rest always match.
+    Order * ioc = Order::from(5, book.symbol, 90, 5, Side::BUY, TimeInForce::IOC);
+    ok = ok && !book.TryRest(*ioc);
+    book.Handle(*ioc);
+    ok = ok && book.TryRest(*Order::from(6, book.symbol, 99, 10, Side::BUY));
+    ok = ok && RestingOrders(book) == Resting{{6, 99, 10}, {2, 98, 5}, {1, 100, 5}};
+    DepthLevel best;
+    ok = ok && book.BestBid(best) && best.price == 99 && best.quantity == 10;
+    std::cout << "Ending [test_try_rest]\n\n";
+    return ok;
+}
+
+bool test_try_rest_race()
+{
+    std::cout << "\nStarting [test_try_rest_race]\n";
+    constexpr order_id_t ORDERS = 20000;
+    OrderBook book(PackSymbol("RACE"), 0);
+    book.Handle(*Order::from(1, book.symbol, 100, 10, Side::SELL));
+
+    // Bids rest at 99 unless asks at 99 got there first, in which case
+    // TryRest turns them down and they match. Asks always cross at 99.
+    uint64_t bought = 0;
+    uint64_t sold = 0;
+    std::thread resting(
+        [&]()
+        {
+            for (order_id_t i = 0; i < ORDERS; i++)
+            {
+                Order * order = Order::from(10 + 2 * i, book.symbol, 99, 1 + i % 3, Side::BUY);
+                bought += order->GetCount();
+                if (!book.TryRest(*order))
+                    book.Handle(*order);
+            }
+        });
+    for (order_id_t i = 0; i < ORDERS; i++)
+    {
+        Order * order = Order::from(11 + 2 * i, book.symbol, 99, 1 + i % 5, Side::SELL);
+        sold += order->GetCount();
+        book.Handle(*order);
+    }
+    resting.join();
+
+    uint64_t bids = 0;
+    uint64_t asks = 0;
+    book.ForEachResting([&](Order & order) { (order.GetSide() == Side::BUY ? bids : asks) += order.GetCount(); });
+    // Whatever traded left both sides alike, and 99 is never left crossed.
+    uint64_t bidsAt99 = book.QuantityUpTo(Side::BUY, 99);
+    uint64_t asksAt99 = book.QuantityUpTo(Side::SELL, 99);
+    bool ok = bids == bidsAt99 && asks == asksAt99 + 10 && (bidsAt99 == 0 || asksAt99 == 0);
+    ok = ok && bought - bidsAt99 == sold - asksAt99;
+    ok = ok && book.Totals(Side::BUY).quantity == bids && book.Totals(Side::SELL).quantity == asks;
+    DepthLevel bid;
+    DepthLevel ask;
+    ok = ok && book.BestAsk(ask) && (!book.BestBid(bid) || bid.price < ask.price);
+    std::cout << "Ending [test_try_rest_race]\n\n";
+    return ok;
+}
+
+bool test_activation_wait()
+{
+    std::cout << "\nStarting [test_activation_wait]\n";
+    symbol_t symbol = PackSymbol("WAIT");
+    Book<std::less<price_t>> asks;
+    // What Prepare leaves behind: a dummy node, timestamped but not activated.
+    Order * resting = Order::from(1, symbol, 100, 10, Side::SELL);
+    resting->SetTimestamp(getCurrentTimestamp());
+    asks.Add(*resting);
+    DepthLevel best;
+    bool ok = !asks.Best(best);
+
+    std::atomic<bool> activated{false};
+    std::promise<bool> crossed;
+    std::future<bool> done = crossed.get_future();
+    Order * buy = Order::from(2, symbol, 100, 4, Side::BUY);
+    buy->SetTimestamp(getCurrentTimestamp());
+    std::thread aggressor(
+        [&]()
+        {
+            bool filled = asks.CrossSpread(*buy);
+            crossed.set_value(filled && activated.load());
+        });
+
+    // The crossing order has to wait for the dummy node ahead of it.
+    ok = ok && done.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout;
+    activated.store(true);
+    asks.AfterExecute(*resting, false);
+
+    // A lost wakeup fails the test rather than hang it.
+    if (done.wait_for(std::chrono::seconds(10)) != std::future_status::ready)
+    {
+        aggressor.detach();
+        std::cout << "Crossing order never woke up\n";
+        return false;
+    }
+    aggressor.join();
+    ok = ok && done.get() && buy->GetCount() == 0;
+    Order::Destroy(buy);
+    ok = ok && asks.Best(best) && best.price == 100 && best.quantity == 6 && best.orders == 1;
+    std::cout << "Ending [test_activation_wait]\n\n";
+    return ok;
+}
+
+int main()
+{
+    std::cout << "Starting unit test\n";
+    for (bool exclusive : {true, false})
+    {
+        assert(test_ioc(exclusive));
+        assert(test_fok(exclusive));
+        assert(test_market(exclusive));
+        assert(test_amend(exclusive));
+        assert(test_depth(exclusive));
+        assert(test_self_trade(exclusive));
+    }
+    assert(test_try_rest());
+    assert(test_try_rest_race());
+    assert(test_activation_wait());
+    std::cout << "Success\n";
+}
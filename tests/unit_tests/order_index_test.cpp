@@ -0,0 +1,81 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <assert.h>
+
+#include "../../src/order_index.hpp"
+
+/**
+ * The index only stores pointers, so distinct fake addresses stand in for orders.
+*/
+static Order * fake_order(order_id_t order_id)
+{
+    return reinterpret_cast<Order *>(uintptr_t(order_id + 1) * alignof(Order));
+}
+
+bool random_operations(order_id_t id_range)
+{
+    std::mt19937 rng(11);
+    OrderIndex index;
+    std::unordered_map<order_id_t, Order *> reference;
+    for (int i = 0; i < 200000; i++)
+    {
+        order_id_t order_id = rng() % id_range;
+        if (rng() % 2)
+        {
+            index.Insert(order_id, fake_order(order_id));
+            reference[order_id] = fake_order(order_id);
+        }
+        else
+        {
+            index.Erase(order_id);
+            reference.erase(order_id);
+        }
+
+        if (index.Size() != reference.size())
+            return false;
+        order_id_t probe = rng() % id_range;
+        auto it = reference.find(probe);
+        if (index.Find(probe) != (it == reference.end() ? nullptr : it->second))
+            return false;
+    }
+
+    for (const auto & [order_id, order] : reference)
+        if (index.Find(order_id) != order)
+            return false;
+    return true;
+}
+
+bool test_matches_unordered_map()
+{
+    std::cout << "\nStarting [test_matches_unordered_map]\n";
+    bool ok = random_operations(100) && random_operations(5000) && random_operations(1u << 30);
+    std::cout << "Ending [test_matches_unordered_map]\n\n";
+    return ok;
+}
+
+bool test_erase_keeps_collisions_reachable()
+{
+    std::cout << "\nStarting [test_erase_keeps_collisions_reachable]\n";
+    OrderIndex index;
+    // Sequential ids fill long runs; erasing from the middle must shift the rest back.
+    for (order_id_t order_id = 0; order_id < 30; order_id++)
+        index.Insert(order_id, fake_order(order_id));
+    bool ok = true;
+    for (order_id_t order_id = 0; order_id < 30; order_id += 3)
+        index.Erase(order_id);
+    for (order_id_t order_id = 0; order_id < 30; order_id++)
+        ok = ok && index.Find(order_id) == (order_id % 3 == 0 ? nullptr : fake_order(order_id));
+    ok = ok && index.Size() == 20;
+    std::cout << "Ending [test_erase_keeps_collisions_reachable]\n\n";
+    return ok;
+}
+
+int main()
+{
+    std::cout << "Starting unit test\n";
+    assert(test_matches_unordered_map());
+    assert(test_erase_keeps_collisions_reachable());
+    std::cout << "Success\n";
+}
@@ -0,0 +1,198 @@
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <latch>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <assert.h>
+#include <unistd.h>
+
+#include "../../src/output_journal.hpp"
+
+/**
+ * Everything written by a journal into a temporary file.
+*/
+struct Capture
+{
+    Capture() : file(tmpfile()) { }
+    ~Capture() { fclose(file); }
+
+    std::string Read()
+    {
+        std::string text;
+        char chunk[4096];
+        size_t n;
+        rewind(file);
+        while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+            text.append(chunk, n);
+        return text;
+    }
+
+    FILE * file;
+};
+
+static OutputJournal::Record Executed(uint32_t resting_id, uint32_t new_id, int64_t timestamp)
+{
+    OutputJournal::Record record{};
+    record.kind = OutputJournal::Kind::Executed;
+    record.id = resting_id;
+    record.other_id = new_id;
+    record.execution_id = 1;
+    record.price = 10;
+    record.count = 1;
+    record.timestamp = timestamp;
+    return record;
+}
+
+bool test_text_format()
+{
+    std::cout << "\nStarting [test_text_format]\n";
+    Capture capture;
+    std::string text;
+    {
+        OutputJournal journal(fileno(capture.file));
+        // Appends from a thread of its own, whose ring lease ends before the journal.
+        std::thread(
+            [&]()
+            {
+                OutputJournal::Record added{};
+                added.kind = OutputJournal::Kind::Added;
+                added.id = 4294967295u;
+                added.symbol = PackSymbol("ABCDEFGH");
+                added.price = 0;
+                added.count = 7;
+                added.flag = true;
+                added.timestamp = 9223372036854775807;
+                journal.Append(added);
+
+                OutputJournal::Record executed = Executed(1, 2, 123);
+                journal.Append(executed);
+
+                OutputJournal::Record deleted{};
+                deleted.kind = OutputJournal::Kind::Deleted;
+                deleted.id = 12;
+                deleted.flag = false;
+                deleted.timestamp = -5;
+                journal.Append(deleted);
+            })
+            .join();
+        journal.Flush();
+        text = capture.Read();
+    }
+    bool ok = text == "S 4294967295 ABCDEFGH 0 7 9223372036854775807\nE 1 2 1 10 1 123\nX 12 R -5\n";
+    std::cout << "Ending [test_text_format]\n\n";
+    return ok;
+}
+
+bool test_causal_order_across_threads()
+{
+    std::cout << "\nStarting [test_causal_order_across_threads]\n";
+    constexpr int THREADS = 4;
+    constexpr int EVENTS = 20000;
+    Capture capture;
+    std::string text;
+    {
+        OutputJournal journal(fileno(capture.file));
+        // Events appended under a shared lock must come out in lock order,
+        // whichever thread reported them.
+        std::mutex lock;
+        uint32_t next = 0;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREADS; t++)
+            threads.emplace_back(
+                [&, t]()
+                {
+                    for (int i = 0; i < EVENTS; i++)
+                    {
+                        std::unique_lock<std::mutex> l(lock);
+                        OutputJournal::Record record = Executed(next++, t, i);
+                        journal.Append(record);
+                    }
+                });
+        for (auto & thread : threads)
+            thread.join();
+        journal.Flush();
+        text = capture.Read();
+    }
+
+    std::istringstream lines(text);
+    std::string tag;
+    uint32_t resting, incoming, execution, price, count;
+    int64_t timestamp;
+    uint32_t expected = 0;
+    while (lines >> tag >> resting >> incoming >> execution >> price >> count >> timestamp)
+        if (tag != "E" || resting != expected++)
+            return false;
+    bool ok = expected == THREADS * EVENTS;
+    std::cout << "Ending [test_causal_order_across_threads]\n\n";
+    return ok;
+}
+
+bool test_many_threads()
+{
+    std::cout << "\nStarting [test_many_threads]\n";
+    // Far more threads alive at once than the rings first made.
+    constexpr int THREADS = 1100;
+    Capture capture;
+    std::string text;
+    {
+        OutputJournal journal(fileno(capture.file));
+        std::latch attached(THREADS);
+        std::atomic<bool> leave{false};
+        std::mutex lock;
+        uint32_t next = 0;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREADS; t++)
+            threads.emplace_back(
+                [&, t]()
+                {
+                    journal.Attach();
+                    attached.arrive_and_wait();
+                    {
+                        std::unique_lock<std::mutex> l(lock);
+                        OutputJournal::Record record = Executed(next++, t, 0);
+                        journal.Append(record);
+                    }
+                    // Keeps the ring leased until every thread appended.
+                    leave.wait(false);
+                });
+        while (true)
+        {
+            std::unique_lock<std::mutex> l(lock);
+            if (next == THREADS)
+                break;
+            l.unlock();
+            std::this_thread::yield();
+        }
+        journal.Flush();
+        text = capture.Read();
+        leave.store(true);
+        leave.notify_all();
+        for (auto & thread : threads)
+            thread.join();
+    }
+
+    std::istringstream lines(text);
+    std::string tag;
+    uint32_t resting, incoming, execution, price, count;
+    int64_t timestamp;
+    uint32_t expected = 0;
+    while (lines >> tag >> resting >> incoming >> execution >> price >> count >> timestamp)
+        if (tag != "E" || resting != expected++)
+            return false;
+    bool ok = expected == THREADS;
+    std::cout << "Ending [test_many_threads]\n\n";
+    return ok;
+}
+
+int main()
+{
+    std::cout << "Starting unit test\n";
+    assert(test_text_format());
+    assert(test_causal_order_across_threads());
+    assert(test_many_threads());
+    std::cout << "Success\n";
+}
@@ -0,0 +1,141 @@
+#include <functional>
+#include <iostream>
+#include <random>
+#include <set>
+#include <vector>
+#include <assert.h>
+
+#include "../../src/price_ladder.hpp"
+
+/**
+ * Walks the ladder from best to worst and compares it with the reference.
+*/
+template <typename Ladder, typename Comparator>
+bool same_levels(Ladder & ladder, const std::set<price_t, Comparator> & reference)
+{
+    std::vector<price_t> walked;
+    price_t price;
+    for (Price * level = ladder.First(price); level != nullptr; level = ladder.Next(price))
+        walked.push_back(price);
+    return walked == std::vector<price_t>(reference.begin(), reference.end()) && ladder.Empty() == reference.empty();
+}
+
+/**
+ * @param far When not zero, half the prices are moved up by it.
+*/
+template <typename Ladder, typename Comparator>
+bool random_operations(price_t low, price_t high, price_t far = 0)
+{
+    std::mt19937 rng(7);
+    Ladder ladder;
+    std::set<price_t, Comparator> reference;
+    for (int i = 0; i < 20000; i++)
+    {
+        price_t price = low + rng() % (high - low + 1);
+        if (far != 0 && rng() % 2)
+            price += far;
+        if (rng() % 3)
+        {
+            ladder.GetOrAssign(price);
+            reference.insert(price);
+        }
+        else
+        {
+            ladder.Erase(price);
+            reference.erase(price);
+        }
+
+        if ((ladder.Find(price) != nullptr) != reference.contains(price))
+            return false;
+        if (i % 97 == 0 && !same_levels(ladder, reference))
+            return false;
+    }
+    return same_levels(ladder, reference);
+}
+
+bool test_array_ladder_matches_map_bids()
+{
+    std::cout << "\nStarting [test_array_ladder_matches_map_bids]\n";
+    bool ok = random_operations<ArrayLadder<std::greater<price_t>>, std::greater<price_t>>(1, 300)
+        && random_operations<ArrayLadder<std::greater<price_t>>, std::greater<price_t>>(0, 100000);
+    std::cout << "Ending [test_array_ladder_matches_map_bids]\n\n";
+    return ok;
+}
+
+bool test_array_ladder_matches_map_asks()
+{
+    std::cout << "\nStarting [test_array_ladder_matches_map_asks]\n";
+    bool ok = random_operations<ArrayLadder<std::less<price_t>>, std::less<price_t>>(1, 300)
+        && random_operations<ArrayLadder<std::less<price_t>>, std::less<price_t>>(4000000000u, 4000100000u);
+    std::cout << "Ending [test_array_ladder_matches_map_asks]\n\n";
+    return ok;
+}
+
+bool test_map_ladder()
+{
+    std::cout << "\nStarting [test_map_ladder]\n";
+    bool ok = random_operations<MapLadder<std::greater<price_t>>, std::greater<price_t>>(1, 300)
+        && random_operations<MapLadder<std::less<price_t>>, std::less<price_t>>(1, 300);
+    std::cout << "Ending [test_map_ladder]\n\n";
+    return ok;
+}
+
+bool test_array_ladder_overflow()
+{
+    std::cout << "\nStarting [test_array_ladder_overflow]\n";
+    // Two clusters further apart than the window may span.
+    bool ok = random_operations<ArrayLadder<std::greater<price_t>>, std::greater<price_t>>(1, 300, 30000000)
+        && random_operations<ArrayLadder<std::less<price_t>>, std::less<price_t>>(1, 300, 30000000);
+
+    ArrayLadder<std::less<price_t>> asks;
+    asks.GetOrAssign(1);
+    asks.GetOrAssign(30000000);
+    price_t price = 0;
+    ok = ok && asks.First(price) != nullptr && price == 1;
+    ok = ok && asks.Next(price) != nullptr && price == 30000000;
+    // Once the near level is gone, the window moves to take new prices
+    // around the far one while it stays in the overflow.
+    asks.Erase(1);
+    asks.GetOrAssign(29999999);
+    ok = ok && asks.First(price) != nullptr && price == 29999999;
+    ok = ok && asks.Next(price) != nullptr && price == 30000000;
+    ok = ok && asks.Next(price) == nullptr;
+    asks.Erase(30000000);
+    asks.Erase(29999999);
+    ok = ok && asks.Empty();
+    std::cout << "Ending [test_array_ladder_overflow]\n\n";
+    return ok;
+}
+
+bool test_next_after_reclaimed_level()
+{
+    std::cout << "\nStarting [test_next_after_reclaimed_level]\n";
+    ArrayLadder<std::greater<price_t>> bids;
+    bids.GetOrAssign(5000);
+    bids.GetOrAssign(4000);
+    price_t price = 0;
+    bids.First(price);
+    if (price != 5000)
+        return false;
+
+    // Reclaim the level being visited and force the window to move away from it.
+    bids.Erase(5000);
+    bids.GetOrAssign(1);
+    if (bids.Next(price) == nullptr || price != 4000)
+        return false;
+    if (bids.Next(price) == nullptr || price != 1)
+        return false;
+    std::cout << "Ending [test_next_after_reclaimed_level]\n\n";
+    return bids.Next(price) == nullptr;
+}
+
+int main()
+{
+    std::cout << "Starting unit test\n";
+    assert(test_array_ladder_matches_map_bids());
+    assert(test_array_ladder_matches_map_asks());
+    assert(test_map_ladder());
+    assert(test_array_ladder_overflow());
+    assert(test_next_after_reclaimed_level());
+    std::cout << "Success\n";
+}
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <assert.h>
+
+#include "../../src/order_book.hpp"
+#include "../../src/risk_check.hpp"
+
+static RiskLimits Limits()
+{
+    RiskLimits limits;
+    limits.max_order_size = 100;
+    limits.max_notional = 5000;
+    limits.max_position = 150;
+    limits.max_open_orders = 3;
+    limits.price_collar_bps = 1000;
+    return limits;
+}
+
+// Checks an order like the engine does, placing it on the book when accepted.
+static RejectReason Place(OrderBook & book, RiskAccount & account, order_id_t id, price_t price, uint32_t count, Side side)
+{
+    RejectReason reason = account.Check(book.id, book.LastTradePrice(), side, price, count, false, true);
+    if (reason != RejectReason::None)
+        return reason;
+    Order * order = Order::from(id, book.symbol, price, count, side);
+    account.Accepted(*order, account.Exposure(book.id));
+    book.Handle(*order);
+    return reason;
+}
+
+bool test_limits()
+{
+    std::cout << "\nStarting [test_limits]\n";
+    RiskAccount account(Limits());
+    bool ok = account.Check(0, 0, Side::BUY, 10, 101, false, true) == RejectReason::OrderSize;
+    ok = ok && account.Check(0, 0, Side::BUY, 51, 100, false, true) == RejectReason::Notional;
+    ok = ok && account.Check(0, 0, Side::BUY, 50, 100, false, true) == RejectReason::None;
+    // No trade yet, so no collar.
+    ok = ok && account.Check(0, 0, Side::SELL, 1, 100, false, true) == RejectReason::None;
+    // 10% either side of the last trade.
+    ok = ok && account.Check(0, 40, Side::BUY, 45, 10, false, true) == RejectReason::PriceCollar;
+    ok = ok && account.Check(0, 40, Side::SELL, 35, 10, false, true) == RejectReason::PriceCollar;
+    ok = ok && account.Check(0, 40, Side::BUY, 44, 10, false, true) == RejectReason::None;
+    // A market order is valued at the last trade and is not collared.
+    ok = ok && account.Check(0, 40, Side::BUY, 1000, 100, true, true) == RejectReason::None;
+    ok = ok && account.Check(0, 60, Side::BUY, 1000, 100, true, true) == RejectReason::Notional;
+    std::cout << "Ending [test_limits]\n\n";
+    return ok;
+}
+
+bool test_exposure()
+{
+    std::cout << "\nStarting [test_exposure]\n";
+    // Declared before the book, whose resting orders charge them until it is gone.
+    RiskAccount buyer(Limits());
+    RiskAccount seller(Limits());
+    OrderBook book(PackSymbol("RISK"), 0);
+
+    bool ok = Place(book, buyer, 1, 40, 60, Side::BUY) == RejectReason::None;
+    ok = ok && Place(book, buyer, 2, 40, 60, Side::BUY) == RejectReason::None;
+    // 150 at most if everything fills.
+    ok = ok && Place(book, buyer, 3, 40, 40, Side::BUY) == RejectReason::Position;
+    ok = ok && Place(book, buyer, 3, 40, 30, Side::BUY) == RejectReason::None;
+    ok = ok && Place(book, buyer, 4, 40, 1, Side::SELL) == RejectReason::OpenOrders;
+    ok = ok && buyer.OpenOrders() == 3;
+
+    // Fills move open quantity into the position of both sides.
+    ok = ok && Place(book, seller, 10, 40, 90, Side::SELL) == RejectReason::None;
+    ok = ok && book.LastTradePrice() == 40;
+    RiskExposure & bought = buyer.Exposure(book.id);
+    RiskExposure & sold = seller.Exposure(book.id);
+    ok = ok && bought.position == 90 && bought.open_buy == 60 && buyer.OpenOrders() == 2;
+    ok = ok && sold.position == -90 && sold.open_sell == 0 && seller.OpenOrders() == 0;
+    // Long 90 with 60 more to come, so it may only sell.
+    ok = ok && buyer.Check(book.id, 40, Side::BUY, 40, 1, false, true) == RejectReason::Position;
+    ok = ok && buyer.Check(book.id, 40, Side::SELL, 40, 100, false, true) == RejectReason::None;
+
+    // Cancelling releases the open quantity and the order count.
+    book.Cancel(3, Side::BUY);
+    ok = ok && bought.open_buy == 30 && buyer.OpenOrders() == 1;
+    std::cout << "Ending [test_exposure]\n\n";
+    return ok;
+}
+
+int main()
+{
+    std::cout << "Starting unit test\n";
+    assert(test_limits());
+    assert(test_exposure());
+    std::cout << "Success\n";
+}
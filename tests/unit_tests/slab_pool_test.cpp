@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+#include <assert.h>
+
+#include "../../src/order.hpp"
+#include "../../src/slab_pool.hpp"
+
+// Each test uses a slot size of its own, so they do not share a depot.
+typedef SlabPool<40, 8> ReusePool;
+typedef SlabPool<64, 64> RefillPool;
+typedef SlabPool<72, 8> CrossThreadPool;
+
+bool test_reuse_after_destroy()
+{
+    std::cout << "\nStarting [test_reuse_after_destroy]\n";
+    // A freed slot is the next one handed out by the same thread.
+    void * slot = ReusePool::Allocate();
+    ReusePool::Free(slot);
+    bool ok = ReusePool::Allocate() == slot;
+    ReusePool::Free(slot);
+
+    Order * order = Order::from(1, PackSymbol("GOOG"), 100, 5, Side::BUY);
+    Order::Destroy(order);
+    Order * again = Order::from(2, PackSymbol("GOOG"), 101, 6, Side::SELL);
+    ok = ok && again == order && again->GetOrderId() == 2u && again->GetSide() == Side::SELL && again->GetCount() == 6u;
+    Order::Destroy(again);
+    std::cout << "Ending [test_reuse_after_destroy]\n\n";
+    return ok;
+}
+
+bool test_depot_refill()
+{
+    std::cout << "\nStarting [test_depot_refill]\n";
+    // The thread carves a slab but only uses one slot; the rest of it goes
+    // to the depot when the thread exits.
+    std::thread([]() { RefillPool::Free(RefillPool::Allocate()); }).join();
+
+    // A whole slab's worth then comes from that slab rather than a new one.
+    constexpr size_t SLOTS = 1024;
+    std::vector<uintptr_t> slots;
+    std::thread(
+        [&]()
+        {
+            for (size_t i = 0; i < SLOTS; i++)
+                slots.push_back(reinterpret_cast<uintptr_t>(RefillPool::Allocate()));
+            for (uintptr_t slot : slots)
+                RefillPool::Free(reinterpret_cast<void *>(slot));
+        })
+        .join();
+
+    bool ok = std::set<uintptr_t>(slots.begin(), slots.end()).size() == SLOTS;
+    auto [low, high] = std::minmax_element(slots.begin(), slots.end());
+    ok = ok && *high - *low == (SLOTS - 1) * 64;
+    std::cout << "Ending [test_depot_refill]\n\n";
+    return ok;
+}
+
+bool test_cross_thread_free()
+{
+    std::cout << "\nStarting [test_cross_thread_free]\n";
+    constexpr size_t SLOTS = 10000;
+    std::vector<void *> allocated;
+    for (size_t i = 0; i < SLOTS; i++)
+    {
+        void * slot = CrossThreadPool::Allocate();
+        // Slots are writable over their whole size.
+        std::fill_n(static_cast<unsigned char *>(slot), 72, uint8_t(i));
+        allocated.push_back(slot);
+    }
+
+    // Freed by another thread, like a resting order filled by another
+    // connection, the slots flow back through the depot.
+    std::thread(
+        [&]()
+        {
+            for (void * slot : allocated)
+                CrossThreadPool::Free(slot);
+        })
+        .join();
+
+    std::set<void *> freed(allocated.begin(), allocated.end());
+    bool ok = freed.size() == SLOTS;
+    std::thread(
+        [&]()
+        {
+            std::vector<void *> reused;
+            for (size_t i = 0; i < SLOTS; i++)
+            {
+                void * slot = CrossThreadPool::Allocate();
+                ok = ok && freed.erase(slot) == 1;
+                reused.push_back(slot);
+            }
+            for (void * slot : reused)
+                CrossThreadPool::Free(slot);
+        })
+        .join();
+    std::cout << "Ending [test_cross_thread_free]\n\n";
+    return ok && freed.empty();
+}
+
+int main()
+{
+    std::cout << "Starting unit test\n";
+    assert(test_reuse_after_destroy());
+    assert(test_depot_refill());
+    assert(test_cross_thread_free());
+    std::cout << "Success\n";
+}